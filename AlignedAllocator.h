@@ -0,0 +1,65 @@
+#ifndef __ALIGNED_ALLOCATOR_H__
+#define __ALIGNED_ALLOCATOR_H__
+
+#include <cstddef>
+#include <cstdlib>
+#include <new>
+
+namespace std {
+    
+    using namespace std;
+    
+    //Allocator for buffers read with aligned SIMD loads, every allocation starts on an Alignment byte boundary.
+    template<typename T, size_t Alignment = 64>
+    class AlignedAllocator {
+        
+    public:
+        
+        typedef T value_type;
+        
+        template<typename U>
+        struct rebind {
+            typedef AlignedAllocator<U, Alignment> other;
+        };
+        
+        AlignedAllocator() {
+        
+        }
+        
+        template<typename U>
+        AlignedAllocator(const AlignedAllocator<U, Alignment>& rhs) {
+        
+        }
+        
+        T* allocate(size_t size) {
+            
+            if (size == 0) {
+                return NULL;
+            }
+            
+            void* memory = NULL;
+            
+            if (posix_memalign(&memory, Alignment, size * sizeof(T)) != 0) {
+                throw bad_alloc();
+            }
+            
+            return static_cast<T*>(memory);
+        }
+        
+        void deallocate(T* memory, size_t) {
+            free(memory);
+        }
+        
+        template<typename U>
+        bool operator==(const AlignedAllocator<U, Alignment>&) const {
+            return true;
+        }
+        
+        template<typename U>
+        bool operator!=(const AlignedAllocator<U, Alignment>&) const {
+            return false;
+        }
+    };
+}
+
+#endif
\ No newline at end of file
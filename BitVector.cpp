@@ -0,0 +1,202 @@
+#include "BitVector.h"
+
+#if defined(__AVX2__) || defined(__AVX512F__)
+#include <immintrin.h>
+#endif
+
+namespace std {
+    
+    BitVector::BitVector():bitsNumber(0) {
+    
+    }
+    
+    BitVector::BitVector(size_t bitsNumber):words((bitsNumber + WordBitsNumber - 1) / WordBitsNumber, 0), bitsNumber(bitsNumber) {
+    
+    }
+    
+    BitVector::BitVector(const vector<double>& features):words((features.size() + WordBitsNumber - 1) / WordBitsNumber, 0), bitsNumber(features.size()) {
+        
+        for (size_t index = 0; index < features.size(); ++index) {
+            
+            if (features[index] != 0) {
+                this->words[index / WordBitsNumber] |= (BitWordType)1 << (index % WordBitsNumber);
+            }
+        }
+    }
+    
+    BitVector::BitVector(const BitVector& rhs):words(rhs.words), bitsNumber(rhs.bitsNumber) {
+    
+    }
+    
+    BitVector& BitVector::operator=(const BitVector& rhs) {
+        BitVector temp(rhs);
+        this->swap(temp);
+        return *this;
+    }
+    
+    BitVector::~BitVector() {
+    
+    }
+    
+    void BitVector::swap(BitVector& other) {
+        using std::swap;
+        swap(this->words, other.words);
+        swap(this->bitsNumber, other.bitsNumber);
+    }
+    
+    size_t BitVector::count() const {
+        return popcount(this->words.data(), this->words.size());
+    }
+    
+    static inline size_t popcountWord(BitWordType word) {
+        
+#if defined(__GNUC__) || defined(__clang__)
+        return (size_t)__builtin_popcountll(word);
+#else
+        word = word - ((word >> 1) & 0x5555555555555555ULL);
+        word = (word & 0x3333333333333333ULL) + ((word >> 2) & 0x3333333333333333ULL);
+        word = (word + (word >> 4)) & 0x0f0f0f0f0f0f0f0fULL;
+        
+        return (size_t)((word * 0x0101010101010101ULL) >> 56);
+#endif
+    }
+    
+#if defined(__AVX512F__) && defined(__AVX512VPOPCNTDQ__)
+    static inline size_t horizontalSum(__m512i counts) {
+        return (size_t)_mm512_reduce_add_epi64(counts);
+    }
+#elif defined(__AVX2__)
+    //Per byte popcounts from two 16 entry lookups of the nibbles, summed into the four 64 bit lanes.
+    static inline __m256i popcount256(__m256i value) {
+        
+        const __m256i lookup = _mm256_setr_epi8(0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4, 0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4);
+        const __m256i lowMask = _mm256_set1_epi8(0x0f);
+        
+        __m256i low = _mm256_and_si256(value, lowMask);
+        __m256i high = _mm256_and_si256(_mm256_srli_epi16(value, 4), lowMask);
+        __m256i counts = _mm256_add_epi8(_mm256_shuffle_epi8(lookup, low), _mm256_shuffle_epi8(lookup, high));
+        
+        return _mm256_sad_epu8(counts, _mm256_setzero_si256());
+    }
+    
+    static inline size_t horizontalSum(__m256i counts) {
+        return (size_t)(_mm256_extract_epi64(counts, 0) + _mm256_extract_epi64(counts, 1) + _mm256_extract_epi64(counts, 2) + _mm256_extract_epi64(counts, 3));
+    }
+#endif
+    
+    size_t popcount(const BitWordType* words, size_t wordsNumber) {
+        
+        size_t index = 0;
+        size_t result = 0;
+        
+#if defined(__AVX512F__) && defined(__AVX512VPOPCNTDQ__)
+        __m512i counts = _mm512_setzero_si512();
+        
+        for (; index + 8 <= wordsNumber; index += 8) {
+            counts = _mm512_add_epi64(counts, _mm512_popcnt_epi64(_mm512_loadu_si512((const void*)(words + index))));
+        }
+        
+        result += horizontalSum(counts);
+#elif defined(__AVX2__)
+        __m256i counts = _mm256_setzero_si256();
+        
+        for (; index + 4 <= wordsNumber; index += 4) {
+            counts = _mm256_add_epi64(counts, popcount256(_mm256_loadu_si256((const __m256i*)(words + index))));
+        }
+        
+        result += horizontalSum(counts);
+#endif
+        
+        for (; index < wordsNumber; ++index) {
+            result += popcountWord(words[index]);
+        }
+        
+        return result;
+    }
+    
+    size_t xorPopcount(const BitWordType* words0, const BitWordType* words1, size_t wordsNumber) {
+        
+        size_t index = 0;
+        size_t result = 0;
+        
+#if defined(__AVX512F__) && defined(__AVX512VPOPCNTDQ__)
+        __m512i counts = _mm512_setzero_si512();
+        
+        for (; index + 8 <= wordsNumber; index += 8) {
+            
+            __m512i value = _mm512_xor_si512(_mm512_loadu_si512((const void*)(words0 + index)), _mm512_loadu_si512((const void*)(words1 + index)));
+            counts = _mm512_add_epi64(counts, _mm512_popcnt_epi64(value));
+        }
+        
+        result += horizontalSum(counts);
+#elif defined(__AVX2__)
+        __m256i counts = _mm256_setzero_si256();
+        
+        for (; index + 4 <= wordsNumber; index += 4) {
+            
+            __m256i value = _mm256_xor_si256(_mm256_loadu_si256((const __m256i*)(words0 + index)), _mm256_loadu_si256((const __m256i*)(words1 + index)));
+            counts = _mm256_add_epi64(counts, popcount256(value));
+        }
+        
+        result += horizontalSum(counts);
+#endif
+        
+        for (; index < wordsNumber; ++index) {
+            result += popcountWord(words0[index] ^ words1[index]);
+        }
+        
+        return result;
+    }
+    
+    void andOrPopcount(const BitWordType* words0, const BitWordType* words1, size_t wordsNumber, size_t& andCount, size_t& orCount) {
+        
+        size_t index = 0;
+        
+        andCount = 0;
+        orCount = 0;
+        
+#if defined(__AVX512F__) && defined(__AVX512VPOPCNTDQ__)
+        __m512i andCounts = _mm512_setzero_si512();
+        __m512i orCounts = _mm512_setzero_si512();
+        
+        for (; index + 8 <= wordsNumber; index += 8) {
+            
+            __m512i value0 = _mm512_loadu_si512((const void*)(words0 + index));
+            __m512i value1 = _mm512_loadu_si512((const void*)(words1 + index));
+            
+            andCounts = _mm512_add_epi64(andCounts, _mm512_popcnt_epi64(_mm512_and_si512(value0, value1)));
+            orCounts = _mm512_add_epi64(orCounts, _mm512_popcnt_epi64(_mm512_or_si512(value0, value1)));
+        }
+        
+        andCount += horizontalSum(andCounts);
+        orCount += horizontalSum(orCounts);
+#elif defined(__AVX2__)
+        __m256i andCounts = _mm256_setzero_si256();
+        __m256i orCounts = _mm256_setzero_si256();
+        
+        for (; index + 4 <= wordsNumber; index += 4) {
+            
+            __m256i value0 = _mm256_loadu_si256((const __m256i*)(words0 + index));
+            __m256i value1 = _mm256_loadu_si256((const __m256i*)(words1 + index));
+            
+            andCounts = _mm256_add_epi64(andCounts, popcount256(_mm256_and_si256(value0, value1)));
+            orCounts = _mm256_add_epi64(orCounts, popcount256(_mm256_or_si256(value0, value1)));
+        }
+        
+        andCount += horizontalSum(andCounts);
+        orCount += horizontalSum(orCounts);
+#endif
+        
+        for (; index < wordsNumber; ++index) {
+            andCount += popcountWord(words0[index] & words1[index]);
+            orCount += popcountWord(words0[index] | words1[index]);
+        }
+    }
+}
+
+namespace std {
+    template<>
+    void swap<std::BitVector>(std::BitVector& a, std::BitVector& b) {
+        a.swap(b);
+    }
+}
\ No newline at end of file
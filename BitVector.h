@@ -0,0 +1,87 @@
+#ifndef __BIT_VECTOR_H__
+#define __BIT_VECTOR_H__
+
+#include <vector>
+#include "assert.h"
+
+namespace std {
+    
+    using namespace std;
+    
+    typedef unsigned long long BitWordType;
+    
+    //Binary features packed 64 to a word, bits past getBitsNumber() in the last word are always zero so whole words can be compared.
+    class BitVector {
+    
+    public:
+        
+        static const size_t WordBitsNumber = 64;
+        
+        BitVector();
+        BitVector(size_t bitsNumber);
+        
+        //Every non-zero feature becomes a set bit.
+        BitVector(const vector<double>& features);
+        
+        BitVector(const BitVector& rhs);
+        BitVector& operator=(const BitVector& rhs);
+        
+        ~BitVector();
+        
+        void swap(BitVector& other);
+        
+        inline size_t getBitsNumber() const {
+            return this->bitsNumber;
+        }
+        
+        inline size_t getWordsNumber() const {
+            return this->words.size();
+        }
+        
+        inline const BitWordType* getWords() const {
+            return this->words.data();
+        }
+        
+        inline bool getBit(size_t bitIndex) const {
+            
+            assert(bitIndex < this->bitsNumber);
+            
+            return ((this->words[bitIndex / WordBitsNumber] >> (bitIndex % WordBitsNumber)) & 1) != 0;
+        }
+        
+        inline void setBit(size_t bitIndex, bool value) {
+            
+            assert(bitIndex < this->bitsNumber);
+            
+            BitWordType mask = (BitWordType)1 << (bitIndex % WordBitsNumber);
+            
+            if (value == true) {
+                this->words[bitIndex / WordBitsNumber] |= mask;
+            } else {
+                this->words[bitIndex / WordBitsNumber] &= ~mask;
+            }
+        }
+        
+        //Number of set bits.
+        size_t count() const;
+        
+    private:
+        
+        vector<BitWordType> words;
+        size_t bitsNumber;
+    };
+    
+    //Set bits of the words, with AVX-512 VPOPCNTDQ or AVX2 nibble lookups when the build targets them.
+    size_t popcount(const BitWordType* words, size_t wordsNumber);
+    size_t xorPopcount(const BitWordType* words0, const BitWordType* words1, size_t wordsNumber);
+    
+    //Counts the set bits of words0 & words1 and of words0 | words1 in one pass.
+    void andOrPopcount(const BitWordType* words0, const BitWordType* words1, size_t wordsNumber, size_t& andCount, size_t& orCount);
+}
+
+namespace std {
+    template<>
+    void swap<std::BitVector>(std::BitVector& a, std::BitVector& b);
+}
+
+#endif
\ No newline at end of file
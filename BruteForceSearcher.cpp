@@ -0,0 +1,307 @@
+#include "BruteForceSearcher.h"
+#include <algorithm>
+#include <thread>
+#include <functional>
+#include <cmath>
+
+namespace std {
+    
+    //Multiply-adds below which a search stays on the calling thread, starting threads costs more than it saves.
+    static const double ParallelScanThreshold = 4.0 * 1024 * 1024;
+    
+    BruteForceSearcher::BruteForceSearcher():searchMode(EuclideanSearch), builtSearchMode(EuclideanSearch), threadsNumber(0), pointNumber(0), dimensionNumber(0) {
+    
+    }
+    
+    BruteForceSearcher::BruteForceSearcher(const BruteForceSearcher& rhs):searchMode(rhs.searchMode), builtSearchMode(rhs.builtSearchMode), threadsNumber(rhs.threadsNumber), pointNumber(rhs.pointNumber), dimensionNumber(rhs.dimensionNumber), blockedPoints(rhs.blockedPoints), pointNorms(rhs.pointNorms), categories(rhs.categories) {
+    
+    }
+    
+    BruteForceSearcher& BruteForceSearcher::operator=(const BruteForceSearcher& rhs) {
+        BruteForceSearcher temp(rhs);
+        this->swap(temp);
+        return *this;
+    }
+    
+    BruteForceSearcher::~BruteForceSearcher() {
+    
+    }
+    
+    void BruteForceSearcher::swap(BruteForceSearcher& other) {
+        using std::swap;
+        swap(this->searchMode, other.searchMode);
+        swap(this->builtSearchMode, other.builtSearchMode);
+        swap(this->threadsNumber, other.threadsNumber);
+        swap(this->pointNumber, other.pointNumber);
+        swap(this->dimensionNumber, other.dimensionNumber);
+        swap(this->blockedPoints, other.blockedPoints);
+        swap(this->pointNorms, other.pointNorms);
+        swap(this->categories, other.categories);
+    }
+    
+    void BruteForceSearcher::build(const vector< vector<FeatureType> >& featuresVector, const vector<NodeCategory>& categoriesVector) {
+        
+        assert(featuresVector.size() == categoriesVector.size());
+        
+        this->builtSearchMode = this->searchMode;
+        
+        this->pointNumber = featuresVector.size();
+        this->dimensionNumber = featuresVector.empty() == true ? 0 : featuresVector.front().size();
+        
+        size_t blocksNumber = this->getBlocksNumber();
+        
+        this->blockedPoints.assign(blocksNumber * this->dimensionNumber * BlockPointsNumber, 0);
+        this->pointNorms.assign(blocksNumber * BlockPointsNumber, 0);
+        
+        for (PointIndexType pointIndex = 0; pointIndex < this->pointNumber; ++pointIndex) {
+            
+            const vector<FeatureType>& features = featuresVector[pointIndex];
+            
+            assert(features.size() == this->dimensionNumber);
+            
+            FeatureType* block = &(this->blockedPoints[pointIndex / BlockPointsNumber * this->dimensionNumber * BlockPointsNumber]);
+            size_t blockOffset = pointIndex % BlockPointsNumber;
+            
+            NodeDistanceType squaredNorm = 0;
+            
+            for (DimensionNumber dimensionIndex = 0; dimensionIndex < this->dimensionNumber; ++dimensionIndex) {
+                block[dimensionIndex * BlockPointsNumber + blockOffset] = features[dimensionIndex];
+                squaredNorm += features[dimensionIndex] * features[dimensionIndex];
+            }
+            
+            this->pointNorms[pointIndex] = sqrt(squaredNorm);
+        }
+        
+        this->categories = categoriesVector;
+    }
+    
+    void BruteForceSearcher::setSearchMode(KdTreeSearchMode searchMode) {
+        this->searchMode = searchMode;
+    }
+    
+    KdTreeSearchMode BruteForceSearcher::getSearchMode() const {
+        return this->searchMode;
+    }
+    
+    void BruteForceSearcher::setThreadsNumber(size_t threadsNumber) {
+        this->threadsNumber = threadsNumber;
+    }
+    
+    size_t BruteForceSearcher::getThreadsNumber() const {
+        return this->threadsNumber;
+    }
+    
+    const vector<KdTreeNode> BruteForceSearcher::nearestKNode(const vector<FeatureType>& features, size_t k) const {
+        
+        vector< vector<FeatureType> > featuresVector(1, features);
+        
+        return this->nearestKNodes(featuresVector, k).front();
+    }
+    
+    const vector< vector<KdTreeNode> > BruteForceSearcher::nearestKNodes(const vector< vector<FeatureType> >& featuresVector, size_t k) const {
+        
+        size_t queriesNumber = featuresVector.size();
+        
+        vector< vector<KdTreeNode> > results(queriesNumber);
+        
+        if (this->pointNumber == 0 || k == 0 || queriesNumber == 0) {
+            return results;
+        }
+        
+        size_t blocksNumber = this->getBlocksNumber();
+        size_t threadsNumber = this->threadsNumber == 0 ? max(thread::hardware_concurrency(), 1U) : this->threadsNumber;
+        
+        if ((double)queriesNumber * this->pointNumber * this->dimensionNumber < ParallelScanThreshold) {
+            threadsNumber = 1;
+        }
+        
+        //Splitting the points costs one heap per query and thread and a merge, only worth it when the queries cannot keep every thread busy.
+        bool isQuerySplit = queriesNumber >= threadsNumber;
+        
+        threadsNumber = min(threadsNumber, isQuerySplit == true ? queriesNumber : blocksNumber);
+        
+        vector< vector<BruteForceCandidateMaxHeap> > threadHeaps(isQuerySplit == true ? 1 : threadsNumber, vector<BruteForceCandidateMaxHeap>(queriesNumber, BruteForceCandidateMaxHeap(k)));
+        
+        vector<thread> threads;
+        
+        for (size_t threadIndex = 1; threadIndex < threadsNumber; ++threadIndex) {
+            
+            if (isQuerySplit == true) {
+                threads.push_back(thread(&BruteForceSearcher::searchBlocks, this, cref(featuresVector), queriesNumber * threadIndex / threadsNumber, queriesNumber * (threadIndex + 1) / threadsNumber, 0, blocksNumber, &threadHeaps[0]));
+            } else {
+                threads.push_back(thread(&BruteForceSearcher::searchBlocks, this, cref(featuresVector), 0, queriesNumber, blocksNumber * threadIndex / threadsNumber, blocksNumber * (threadIndex + 1) / threadsNumber, &threadHeaps[threadIndex]));
+            }
+        }
+        
+        if (isQuerySplit == true) {
+            this->searchBlocks(featuresVector, 0, queriesNumber / threadsNumber, 0, blocksNumber, &threadHeaps[0]);
+        } else {
+            this->searchBlocks(featuresVector, 0, queriesNumber, 0, blocksNumber / threadsNumber, &threadHeaps[0]);
+        }
+        
+        vector<thread>::iterator threadIterator;
+        
+        for (threadIterator = threads.begin(); threadIterator != threads.end(); ++threadIterator) {
+            (*threadIterator).join();
+        }
+        
+        vector<BruteForceCandidate> candidates;
+        
+        for (size_t queryIndex = 0; queryIndex < queriesNumber; ++queryIndex) {
+            
+            candidates.clear();
+            
+            for (size_t heapsIndex = 0; heapsIndex < threadHeaps.size(); ++heapsIndex) {
+                
+                const vector<BruteForceCandidate>& heapCandidates = threadHeaps[heapsIndex][queryIndex].getData();
+                
+                candidates.insert(candidates.end(), heapCandidates.begin(), heapCandidates.end());
+            }
+            
+            results[queryIndex] = this->getResult(candidates, k);
+        }
+        
+        return results;
+    }
+    
+    void BruteForceSearcher::searchBlocks(const vector< vector<FeatureType> >& featuresVector, size_t queryLow, size_t queryUp, size_t blockLow, size_t blockUp, vector<BruteForceCandidateMaxHeap>* heaps) const {
+        
+        NodeDistanceType featuresNorms[BlockQueriesNumber];
+        NodeDistanceType distances[BlockPointsNumber];
+        
+        for (size_t queryBlockLow = queryLow; queryBlockLow < queryUp; queryBlockLow += BlockQueriesNumber) {
+            
+            size_t queryBlockUp = min(queryBlockLow + BlockQueriesNumber, queryUp);
+            
+            for (size_t queryIndex = queryBlockLow; queryIndex < queryBlockUp; ++queryIndex) {
+                
+                const vector<FeatureType>& features = featuresVector[queryIndex];
+                
+                assert(features.size() == this->dimensionNumber);
+                
+                NodeDistanceType squaredNorm = 0;
+                
+                for (DimensionNumber dimensionIndex = 0; dimensionIndex < this->dimensionNumber; ++dimensionIndex) {
+                    squaredNorm += features[dimensionIndex] * features[dimensionIndex];
+                }
+                
+                featuresNorms[queryIndex - queryBlockLow] = sqrt(squaredNorm);
+            }
+            
+            for (size_t blockIndex = blockLow; blockIndex < blockUp; ++blockIndex) {
+                
+                PointIndexType firstPointIndex = blockIndex * BlockPointsNumber;
+                size_t blockPointsNumber = min((size_t)BlockPointsNumber, this->pointNumber - firstPointIndex);
+                
+                for (size_t queryIndex = queryBlockLow; queryIndex < queryBlockUp; ++queryIndex) {
+                    
+                    this->scanBlock(featuresVector[queryIndex].data(), featuresNorms[queryIndex - queryBlockLow], blockIndex, distances);
+                    
+                    BruteForceCandidateMaxHeap& heap = (*heaps)[queryIndex];
+                    
+                    for (size_t blockOffset = 0; blockOffset < blockPointsNumber; ++blockOffset) {
+                        
+                        if (heap.isReachMaxNodeNumber() == false || distances[blockOffset] < heap.maxData().distance) {
+                            
+                            BruteForceCandidate candidate;
+                            candidate.distance = distances[blockOffset];
+                            candidate.pointIndex = firstPointIndex + blockOffset;
+                            
+                            heap.addData(candidate);
+                        }
+                    }
+                }
+            }
+        }
+    }
+    
+    //The inner loops run over the points of the block, every point keeps its own sum so the compiler vectorizes them without reassociating additions.
+    void BruteForceSearcher::scanBlock(const FeatureType* features, NodeDistanceType featuresNorm, size_t blockIndex, NodeDistanceType* distances) const {
+        
+        const FeatureType* block = &(this->blockedPoints[blockIndex * this->dimensionNumber * BlockPointsNumber]);
+        
+        for (size_t blockOffset = 0; blockOffset < BlockPointsNumber; ++blockOffset) {
+            distances[blockOffset] = 0;
+        }
+        
+        if (this->builtSearchMode == EuclideanSearch) {
+            
+            for (DimensionNumber dimensionIndex = 0; dimensionIndex < this->dimensionNumber; ++dimensionIndex) {
+                
+                FeatureType feature = features[dimensionIndex];
+                const FeatureType* blockRow = block + dimensionIndex * BlockPointsNumber;
+                
+                for (size_t blockOffset = 0; blockOffset < BlockPointsNumber; ++blockOffset) {
+                    
+                    NodeDistanceType difference = feature - blockRow[blockOffset];
+                    
+                    distances[blockOffset] += difference * difference;
+                }
+            }
+            
+            return;
+        }
+        
+        for (DimensionNumber dimensionIndex = 0; dimensionIndex < this->dimensionNumber; ++dimensionIndex) {
+            
+            FeatureType feature = features[dimensionIndex];
+            const FeatureType* blockRow = block + dimensionIndex * BlockPointsNumber;
+            
+            for (size_t blockOffset = 0; blockOffset < BlockPointsNumber; ++blockOffset) {
+                distances[blockOffset] += feature * blockRow[blockOffset];
+            }
+        }
+        
+        const FeatureType* blockNorms = &(this->pointNorms[blockIndex * BlockPointsNumber]);
+        
+        for (size_t blockOffset = 0; blockOffset < BlockPointsNumber; ++blockOffset) {
+            
+            if (this->builtSearchMode == CosineSearch) {
+                
+                //Zero vectors have no direction, they rank as orthogonal to everything.
+                NodeDistanceType norms = featuresNorm * blockNorms[blockOffset];
+                
+                distances[blockOffset] = norms > 0 ? -distances[blockOffset] / norms : 0;
+            } else {
+                distances[blockOffset] = -distances[blockOffset];
+            }
+        }
+    }
+    
+    const vector<KdTreeNode> BruteForceSearcher::getResult(vector<BruteForceCandidate>& candidates, size_t k) const {
+        
+        size_t resultSize = min(k, candidates.size());
+        
+        partial_sort(candidates.begin(), candidates.begin() + resultSize, candidates.end(), BruteForceCandidateLess());
+        
+        vector<KdTreeNode> result;
+        result.reserve(resultSize);
+        
+        vector<FeatureType> features(this->dimensionNumber);
+        
+        for (size_t candidateIndex = 0; candidateIndex < resultSize; ++candidateIndex) {
+            
+            const BruteForceCandidate& candidate = candidates[candidateIndex];
+            
+            const FeatureType* block = &(this->blockedPoints[candidate.pointIndex / BlockPointsNumber * this->dimensionNumber * BlockPointsNumber]);
+            size_t blockOffset = candidate.pointIndex % BlockPointsNumber;
+            
+            for (DimensionNumber dimensionIndex = 0; dimensionIndex < this->dimensionNumber; ++dimensionIndex) {
+                features[dimensionIndex] = block[dimensionIndex * BlockPointsNumber + blockOffset];
+            }
+            
+            result.push_back(KdTreeNode(features, this->categories[candidate.pointIndex]));
+            //0 - distance keeps a zero similarity +0 like the one of KdTree.
+            result.back().setScore(this->builtSearchMode == EuclideanSearch ? sqrt(candidate.distance) : 0 - candidate.distance);
+        }
+        
+        return result;
+    }
+}
+
+namespace std {
+    template<>
+    void swap<std::BruteForceSearcher>(std::BruteForceSearcher& a, std::BruteForceSearcher& b) {
+        a.swap(b);
+    }
+}
\ No newline at end of file
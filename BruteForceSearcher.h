@@ -0,0 +1,122 @@
+#ifndef __BRUTE_FORCE_SEARCHER_H__
+#define __BRUTE_FORCE_SEARCHER_H__
+
+#include <vector>
+#include "MaxHeap.h"
+#include "AlignedAllocator.h"
+#include "KdTree.h"
+
+namespace std {
+    
+    using namespace std;
+    
+    //Exact k-NN by comparing the query with every point, the reference to validate KdTree results against and the better choice for small or very high dimensional collections.
+    //Scores are those of an exact KdTree search: Euclidean distance ascending, cosine similarity or inner product descending, a zero vector having cosine similarity 0 to everything.
+    //Equal scores come lowest point index first, KdTree may order them otherwise. Quantized or truncated KdTree searches are approximate and can differ.
+    class BruteForceSearcher {
+        
+    public:
+        
+        //Points are stored in blocks of this many, each block dimension by dimension so that the distance loop over the points of a block vectorizes.
+        static const size_t BlockPointsNumber = 64;
+        
+        //Queries scanned together, a block of points stays in cache while all of them pass over it.
+        static const size_t BlockQueriesNumber = 16;
+        
+        BruteForceSearcher();
+        
+        BruteForceSearcher(const BruteForceSearcher& rhs);
+        BruteForceSearcher& operator=(const BruteForceSearcher& rhs);
+        
+        ~BruteForceSearcher();
+        
+        void swap(BruteForceSearcher& other);
+        
+        void build(const vector< vector<FeatureType> >& featuresVector, const vector<NodeCategory>& categoriesVector);
+        
+        //Takes effect on the next build.
+        void setSearchMode(KdTreeSearchMode searchMode);
+        KdTreeSearchMode getSearchMode() const;
+        
+        //Threads of one search, 0 uses one per hardware thread. Small searches run on the calling thread only.
+        void setThreadsNumber(size_t threadsNumber);
+        size_t getThreadsNumber() const;
+        
+        inline size_t getPointNumber() const {
+            return this->pointNumber;
+        }
+        
+        inline DimensionNumber getDimensionNumber() const {
+            return this->dimensionNumber;
+        }
+        
+        const vector<KdTreeNode> nearestKNode(const vector<FeatureType>& features, size_t k) const;
+        
+        //Threads take ranges of the queries, or ranges of the point blocks when there are fewer queries than threads.
+        const vector< vector<KdTreeNode> > nearestKNodes(const vector< vector<FeatureType> >& featuresVector, size_t k) const;
+        
+    private:
+        
+        //Squared distance, or the negated similarity so that the best candidate is also the smallest.
+        struct BruteForceCandidate {
+            NodeDistanceType distance;
+            PointIndexType pointIndex;
+        };
+        
+        class BruteForceCandidateMaxHeap: public MaxHeap<BruteForceCandidate> {
+            
+        public:
+            
+            BruteForceCandidateMaxHeap(size_t limitedNodesNumber):MaxHeap<BruteForceCandidate>(limitedNodesNumber) {
+            
+            }
+            
+            //Of equally distant candidates the one with the highest index goes first, so every split of the work keeps the same ones.
+            bool isNodeGreaterThanAnother(const BruteForceCandidate& node0, const BruteForceCandidate& node1) {
+                return node0.distance > node1.distance || (node0.distance == node1.distance && node0.pointIndex > node1.pointIndex);
+            }
+        };
+        
+        //Ties are broken by point index, the lowest first.
+        class BruteForceCandidateLess {
+            
+        public:
+            
+            inline bool operator()(const BruteForceCandidate& lhs, const BruteForceCandidate& rhs) const {
+                return lhs.distance < rhs.distance || (lhs.distance == rhs.distance && lhs.pointIndex < rhs.pointIndex);
+            }
+        };
+        
+        typedef vector<FeatureType, AlignedAllocator<FeatureType> > BlockedPointData;
+        
+        KdTreeSearchMode searchMode;
+        KdTreeSearchMode builtSearchMode;
+        size_t threadsNumber;
+        
+        size_t pointNumber;
+        DimensionNumber dimensionNumber;
+        
+        //Feature d of point j of block b at (b * dimensionNumber + d) * BlockPointsNumber + j, the last block is padded with zeros.
+        BlockedPointData blockedPoints;
+        vector<FeatureType> pointNorms;
+        vector<NodeCategory> categories;
+        
+        inline size_t getBlocksNumber() const {
+            return (this->pointNumber + BlockPointsNumber - 1) / BlockPointsNumber;
+        }
+        
+        //Candidates of queries [queryLow, queryUp) among the points of blocks [blockLow, blockUp), one heap per query.
+        void searchBlocks(const vector< vector<FeatureType> >& featuresVector, size_t queryLow, size_t queryUp, size_t blockLow, size_t blockUp, vector<BruteForceCandidateMaxHeap>* heaps) const;
+        
+        void scanBlock(const FeatureType* features, NodeDistanceType featuresNorm, size_t blockIndex, NodeDistanceType* distances) const;
+        
+        const vector<KdTreeNode> getResult(vector<BruteForceCandidate>& candidates, size_t k) const;
+    };
+}
+
+namespace std {
+    template<>
+    void swap<std::BruteForceSearcher>(std::BruteForceSearcher& a, std::BruteForceSearcher& b);
+}
+
+#endif
\ No newline at end of file
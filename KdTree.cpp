@@ -4,18 +4,21 @@
 #include <cmath>
 #include "assert.h"
 #include "MaxHeap.h"
+#include <algorithm>
+#include <functional>
+#include <limits>
 
 namespace std {
     
-    KdTreeNode::KdTreeNode() {
+    KdTreeNode::KdTreeNode():score(0) {
         this->initRelatedTreeNode();
     }
     
-    KdTreeNode::KdTreeNode(const vector<FeatureType>& features):features(features) {
+    KdTreeNode::KdTreeNode(const vector<FeatureType>& features):features(features), score(0) {
         this->initRelatedTreeNode();
     }
     
-    KdTreeNode::KdTreeNode(const vector<FeatureType>& features, NodeCategory category):features(features), category(category) {
+    KdTreeNode::KdTreeNode(const vector<FeatureType>& features, NodeCategory category):features(features), category(category), score(0) {
         this->initRelatedTreeNode();
     }
     
@@ -23,7 +26,7 @@ namespace std {
         
     }
     
-    KdTreeNode::KdTreeNode(const KdTreeNode& rhs):splitFeatureIndex(rhs.splitFeatureIndex), features(rhs.features), category(rhs.category), parent(rhs.parent), leftChild(rhs.leftChild), rightChild(rhs.rightChild) {
+    KdTreeNode::KdTreeNode(const KdTreeNode& rhs):splitFeatureIndex(rhs.splitFeatureIndex), features(rhs.features), category(rhs.category), score(rhs.score), parent(rhs.parent), leftChild(rhs.leftChild), rightChild(rhs.rightChild) {
         
     }
     
@@ -38,6 +41,7 @@ namespace std {
         swap(this->splitFeatureIndex, other.splitFeatureIndex);
         swap(this->features, other.features);
         swap(this->category, other.category);
+        swap(this->score, other.score);
         swap(this->parent, other.parent);
         swap(this->leftChild, other.leftChild);
         swap(this->rightChild, other.rightChild);
@@ -65,6 +69,14 @@ namespace std {
         return this->category;
     }
     
+    void KdTreeNode::setScore(NodeDistanceType score) {
+        this->score = score;
+    }
+    
+    NodeDistanceType KdTreeNode::getScore() const {
+        return this->score;
+    }
+    
     FeatureType KdTreeNode::getSplitFeature() const {
         
         assert(this->features.size() > this->splitFeatureIndex);
@@ -107,170 +119,969 @@ namespace std {
         return result;
     }
     
-    KdTree::KdTree() {
+    const NodeIndexType KdTree::NullNodeIndex = (NodeIndexType)(-1);
+    
+    const NodeDistanceType KdTree::ZeroNormCosineDistance = 2;
+    
+    static bool isZeroVector(const vector<FeatureType>& features) {
+        
+        vector<FeatureType>::const_iterator featureIterator;
+        
+        for (featureIterator = features.begin(); featureIterator != features.end(); ++featureIterator) {
+            
+            if (*featureIterator != 0) {
+                return false;
+            }
+        }
+        
+        return true;
+    }
+    
+    //Full precision points only move to their own resource when quantized codes serve the traversal.
+    static MemoryResource* getPointsResource(QuantizationType quantizationType, const shared_ptr<MemoryResource>& exactPointsResource, const shared_ptr<MemoryResource>& memoryResource) {
+        
+        if (quantizationType != NoQuantization && exactPointsResource) {
+            return exactPointsResource.get();
+        }
+        
+        return memoryResource.get();
+    }
+    
+    KdTree::KdTree():searchMode(EuclideanSearch), builtSearchMode(EuclideanSearch), maxSquaredNorm(0), normalizationType(NoNormalization), isRotated(false), principalComponentsNumber(0), quantizationType(NoQuantization), rerankFactor(4), splitRule(MaxVarianceMedianSplit), layout(DepthFirstLayout), interleavedQueriesNumber(8), rootNode(NullNodeIndex), buildContext(NULL) {
+    
+    }
+    
+    KdTree::KdTree(const KdTree& rhs, const shared_ptr<MemoryResource>& memoryResource):memoryResource(memoryResource), exactPointsResource(rhs.exactPointsResource), points(rhs.points, getPointsResource(rhs.quantizedPoints.getQuantizationType(), rhs.exactPointsResource, memoryResource)), sourcePoints(rhs.sourcePoints, getPointsResource(rhs.quantizedPoints.getQuantizationType(), rhs.exactPointsResource, memoryResource)), categories(rhs.categories.begin(), rhs.categories.end(), ResourceAllocator<NodeCategory>(memoryResource.get())), searchMode(rhs.searchMode), builtSearchMode(rhs.builtSearchMode), maxSquaredNorm(rhs.maxSquaredNorm), zeroNormPoints(rhs.zeroNormPoints), normalizationType(rhs.normalizationType), fittedNormalizer(rhs.fittedNormalizer), normalizer(rhs.normalizer), metric(rhs.metric), whiteningMetric(rhs.whiteningMetric), isRotated(rhs.isRotated), principalComponentsNumber(rhs.principalComponentsNumber), principalMeans(rhs.principalMeans), principalAxes(rhs.principalAxes), quantizationType(rhs.quantizationType), rerankFactor(rhs.rerankFactor), splitRule(rhs.splitRule), layout(rhs.layout), interleavedQueriesNumber(rhs.interleavedQueriesNumber), quantizedPoints(rhs.quantizedPoints, memoryResource.get()), treeNodes(rhs.treeNodes.begin(), rhs.treeNodes.end(), ResourceAllocator<TreeNode>(memoryResource.get())), rootNode(rhs.rootNode), buildContext(NULL) {
     
     }
     
     KdTree::~KdTree() {
-        this->deleteTree(this->rootNode);
+        
     }
     
-    void KdTree::deleteTree(KdTreeNode *treeRoot) {
+    void KdTree::build(const vector< vector<FeatureType> >& featuresVector, const vector<NodeCategory>& categoriesVector) {
+        
+        BuildContext context;
+        
+        this->build(featuresVector, categoriesVector, context);
+    }
+    
+    void KdTree::build(const vector< vector<FeatureType> >& featuresVector, const vector<NodeCategory>& categoriesVector, BuildContext& context) {
+        
+        assert(featuresVector.size() == categoriesVector.size());
+        
+        assert(this->metric.isFitted() == false || this->isRotated == false);
+        assert(this->metric.isFitted() == false || this->normalizationType == NoNormalization);
+        assert(this->metric.isFitted() == false || this->searchMode == EuclideanSearch);
+        assert(this->searchMode != CosineSearch || this->normalizationType == NoNormalization || this->normalizationType == L2Normalization);
+        assert(this->searchMode != InnerProductSearch || this->normalizationType == NoNormalization);
+        
+        this->whiteningMetric = this->metric;
+        this->builtSearchMode = this->searchMode;
+        this->maxSquaredNorm = 0;
+        this->zeroNormPoints.clear();
+        
+        NormalizationType normalizationType = this->normalizationType;
+        
+        if (this->searchMode == CosineSearch) {
+            normalizationType = L2Normalization;
+        }
+        
+        this->normalizer.clear();
+        this->principalMeans.clear();
+        this->principalAxes = Matrix::emptyMatrix();
+        
+        //Buffers of a previous build go back to the resource they came from before the new one takes over.
+        this->points.clear();
+        this->sourcePoints.clear();
+        this->categories.clear();
+        this->quantizedPoints.clear();
+        this->treeNodes.clear();
+        
+        MemoryResource* pointsResource = getPointsResource(this->quantizationType, this->exactPointsResource, this->memoryResource);
+        
+        this->points.setMemoryResource(pointsResource);
+        this->sourcePoints.setMemoryResource(pointsResource);
+        CategoryVector(ResourceAllocator<NodeCategory>(this->memoryResource.get())).swap(this->categories);
+        this->quantizedPoints.setMemoryResource(this->memoryResource.get());
+        TreeNodeVector(ResourceAllocator<TreeNode>(this->memoryResource.get())).swap(this->treeNodes);
+        
+        this->points.assign(featuresVector);
+        
+        if (this->searchMode == CosineSearch) {
+            
+            //L2 normalization leaves them at the origin, at distance 1 from every unit vector, so they are recorded before it.
+            for (PointIndexType pointIndex = 0; pointIndex < featuresVector.size(); ++pointIndex) {
+                
+                if (isZeroVector(featuresVector[pointIndex]) == true) {
+                    this->zeroNormPoints.push_back(pointIndex);
+                }
+            }
+        }
+        
+        bool isRotationNeeded = this->isRotated == true && featuresVector.size() > 1;
+        
+        if (normalizationType != NoNormalization || this->searchMode != EuclideanSearch || this->whiteningMetric.isFitted() == true || isRotationNeeded == true) {
+            this->sourcePoints = this->points;
+        }
+        
+        if (normalizationType != NoNormalization) {
+            
+            if (this->fittedNormalizer.getNormalizationType() == normalizationType) {
+                this->normalizer = this->fittedNormalizer;
+            } else {
+                this->normalizer.fit(this->points, normalizationType);
+            }
+            
+            this->normalizer.apply(this->points);
+        }
+        
+        if (this->searchMode == InnerProductSearch) {
+            this->augmentForInnerProduct();
+        }
+        
+        if (this->whiteningMetric.isFitted() == true) {
+            
+            assert(this->points.isEmpty() == true || this->points.getDimensionNumber() == this->whiteningMetric.getDimensionNumber());
+            
+            for (PointIndexType pointIndex = 0; pointIndex < this->points.getPointNumber(); ++pointIndex) {
+                
+                FeatureType* point = this->points.getPoint(pointIndex);
+                
+                this->whiteningMetric.whiten(point, point);
+            }
+            
+        } else if (isRotationNeeded == true) {
+            this->buildPrincipalComponents();
+        }
         
-        if (treeRoot != NULL) {
-            this->deleteTree(treeRoot->getLeftChild());
-            this->deleteTree(treeRoot->getRightChild());
-            delete treeRoot;
+        this->categories.assign(categoriesVector.begin(), categoriesVector.end());
+        
+        this->quantizedPoints.build(this->points, this->quantizationType);
+        
+        size_t pointNumber = this->points.getPointNumber();
+        
+        this->treeNodes.reserve(pointNumber);
+        
+        context.pointIndices.resize(pointNumber);
+        
+        for (PointIndexType index = 0; index < pointNumber; ++index) {
+            context.pointIndices[index] = index;
         }
+        
+        context.splitStatistics.reset(this->points.getDimensionNumber());
+        
+        this->buildContext = &context;
+        this->rootNode = this->buildTree(0, pointNumber, NullNodeIndex);
+        this->buildContext = NULL;
+        
+        this->applyLayout(context);
     }
     
-    void KdTree::build(const vector< vector<FeatureType> >& featuresVector, const vector<NodeCategory>& categoriesVector) {
+    void KdTree::setQuantizationType(QuantizationType quantizationType) {
+        this->quantizationType = quantizationType;
+    }
+    
+    QuantizationType KdTree::getQuantizationType() const {
+        return this->quantizationType;
+    }
+    
+    void KdTree::setRerankFactor(size_t rerankFactor) {
+        
+        assert(rerankFactor > 0);
+        
+        this->rerankFactor = rerankFactor;
+    }
+    
+    size_t KdTree::getRerankFactor() const {
+        return this->rerankFactor;
+    }
+    
+    void KdTree::setSplitRule(KdTreeSplitRule splitRule) {
+        this->splitRule = splitRule;
+    }
+    
+    KdTreeSplitRule KdTree::getSplitRule() const {
+        return this->splitRule;
+    }
+    
+    void KdTree::setLayout(KdTreeLayout layout) {
+        
+        this->layout = layout;
+        
+        BuildContext context;
+        
+        this->applyLayout(context);
+    }
+    
+    void KdTree::setMemoryResource(const shared_ptr<MemoryResource>& memoryResource) {
+        this->memoryResource = memoryResource;
+    }
+    
+    const shared_ptr<MemoryResource>& KdTree::getMemoryResource() const {
+        return this->memoryResource;
+    }
+    
+    void KdTree::setExactPointsResource(const shared_ptr<MemoryResource>& exactPointsResource) {
+        this->exactPointsResource = exactPointsResource;
+    }
+    
+    const shared_ptr<MemoryResource>& KdTree::getExactPointsResource() const {
+        return this->exactPointsResource;
+    }
+    
+    KdTreeLayout KdTree::getLayout() const {
+        return this->layout;
+    }
+    
+    void KdTree::setSearchMode(KdTreeSearchMode searchMode) {
+        this->searchMode = searchMode;
+    }
+    
+    KdTreeSearchMode KdTree::getSearchMode() const {
+        return this->searchMode;
+    }
+    
+    void KdTree::setNormalizationType(NormalizationType normalizationType) {
+        
+        if (normalizationType != this->normalizationType) {
+            this->fittedNormalizer.clear();
+        }
+        
+        this->normalizationType = normalizationType;
+    }
+    
+    NormalizationType KdTree::getNormalizationType() const {
+        return this->normalizationType;
+    }
+    
+    const FeatureNormalizer& KdTree::getNormalizer() const {
+        return this->normalizer;
+    }
+    
+    void KdTree::setFittedNormalizer(const FeatureNormalizer& normalizer) {
         
-        vector<KdTreeNode> nodes;
+        assert(normalizer.getNormalizationType() != NoNormalization);
         
-        vector< vector<FeatureType> >::const_iterator featuresIterator;
-        vector<NodeCategory>::const_iterator categoryIterator;
+        this->fittedNormalizer = normalizer;
+        this->normalizationType = normalizer.getNormalizationType();
+    }
+    
+    void KdTree::clearFittedNormalizer() {
+        this->fittedNormalizer.clear();
+    }
+    
+    void KdTree::setMahalanobisMetric(const Measurement::MahalanobisMetric& metric) {
         
-        for (featuresIterator = featuresVector.begin(), categoryIterator = categoriesVector.begin(); featuresIterator != featuresVector.end() && categoryIterator != categoriesVector.end(); ++featuresIterator, ++categoryIterator) {
+        assert(metric.isFitted() == true);
+        
+        this->metric = metric;
+    }
+    
+    void KdTree::clearMahalanobisMetric() {
+        this->metric.clear();
+    }
+    
+    const Measurement::MahalanobisMetric& KdTree::getMahalanobisMetric() const {
+        return this->metric;
+    }
+    
+    void KdTree::setPrincipalComponentsRotation(bool isRotated, size_t componentsNumber) {
+        this->isRotated = isRotated;
+        this->principalComponentsNumber = componentsNumber;
+    }
+    
+    bool KdTree::isPrincipalComponentsRotated() const {
+        return this->isRotated;
+    }
+    
+    size_t KdTree::getPrincipalComponentsNumber() const {
+        return this->principalComponentsNumber;
+    }
+    
+    void KdTree::setInterleavedQueriesNumber(size_t interleavedQueriesNumber) {
+        
+        assert(interleavedQueriesNumber > 0);
+        
+        this->interleavedQueriesNumber = interleavedQueriesNumber;
+    }
+    
+    size_t KdTree::getInterleavedQueriesNumber() const {
+        return this->interleavedQueriesNumber;
+    }
+    
+    const vector< vector<KdTreeNode> > KdTree::nearestKNodes(const vector< vector<FeatureType> >& featuresVector, size_t k) const {
+        
+        vector< vector<KdTreeNode> > result(featuresVector.size());
+        
+        if (this->rootNode == NullNodeIndex || k == 0) {
+            return result;
+        }
+        
+        size_t candidatesNumber = this->getCandidatesNumber(k);
+        
+        vector< vector<FeatureType> > transformedFeaturesVector(featuresVector.size());
+        vector<const vector<FeatureType>*> searchFeaturesVector(featuresVector.size());
+        vector<FeatureType> projectedFeatures;
+        
+        for (size_t index = 0; index < featuresVector.size(); ++index) {
+            searchFeaturesVector[index] = &(this->getSearchFeatures(featuresVector[index], transformedFeaturesVector[index], projectedFeatures));
+        }
+        
+        vector<KdTreeQuery> queries;
+        queries.reserve(this->interleavedQueriesNumber);
+        
+        for (size_t groupBegin = 0; groupBegin < featuresVector.size(); groupBegin += this->interleavedQueriesNumber) {
+            
+            size_t groupEnd = min(groupBegin + this->interleavedQueriesNumber, featuresVector.size());
+            
+            queries.clear();
+            
+            for (size_t index = groupBegin; index < groupEnd; ++index) {
+                
+                KdTreeQuery query(*(searchFeaturesVector[index]), featuresVector[index], candidatesNumber);
+                query.descentNode = this->rootNode;
+                
+                queries.push_back(query);
+            }
             
-            KdTreeNode node(*featuresIterator, *categoryIterator);
-            nodes.push_back(node);
+            this->prefetchTreeNode(this->rootNode);
+            
+            //Every round moves each query one level down, the node it needs in the next round is prefetched meanwhile.
+            bool isDescending = true;
+            
+            while (isDescending == true) {
+                
+                isDescending = false;
+                
+                vector<KdTreeQuery>::iterator queryIterator;
+                
+                for (queryIterator = queries.begin(); queryIterator != queries.end(); ++queryIterator) {
+                    
+                    KdTreeQuery& query = *queryIterator;
+                    
+                    if (query.descentNode == NullNodeIndex) {
+                        continue;
+                    }
+                    
+                    NodeIndexType nextNode = this->nextDescentNode(*(query.features), query.descentNode);
+                    
+                    //Points of the path are all visited again while backtracking.
+                    this->prefetchPoint(this->treeNodes[query.descentNode].pointIndex);
+                    
+                    if (nextNode == NullNodeIndex) {
+                        
+                        this->startBacktracking(query, query.descentNode, true);
+                        query.descentNode = NullNodeIndex;
+                        
+                    } else {
+                        
+                        this->prefetchTreeNode(nextNode);
+                        
+                        query.descentNode = nextNode;
+                        isDescending = true;
+                    }
+                }
+            }
+            
+            bool isBacktracking = true;
+            
+            while (isBacktracking == true) {
+                
+                isBacktracking = false;
+                
+                vector<KdTreeQuery>::iterator queryIterator;
+                
+                for (queryIterator = queries.begin(); queryIterator != queries.end(); ++queryIterator) {
+                    
+                    if ((*queryIterator).searchPathNode != NullNodeIndex) {
+                        
+                        this->backtrackingStep(*queryIterator, true);
+                        isBacktracking = true;
+                    }
+                }
+            }
+            
+            for (size_t index = groupBegin; index < groupEnd; ++index) {
+                
+                this->finishQuery(queries[index - groupBegin], k);
+                
+                result[index] = this->getQueryResult(queries[index - groupBegin]);
+            }
         }
         
-        this->rootNode = this->buildTree(nodes);
+        return result;
     }
     
-    KdTreeNode* KdTree::buildTree(vector<KdTreeNode>& nodes) {
+    void KdTree::nearestKNode(const vector<FeatureType>& features, size_t k, QueryContext& context) const {
+        
+        context.results.clear();
         
-        if (nodes.size() == 0) {
-            return NULL;
+        if (this->rootNode == NullNodeIndex || k == 0) {
+            return;
         }
         
-        DimensionNumber splitDimensionIndex = this->getMaxVarianceDimensionIndex(nodes);
+        this->searchNearest(features, k, context);
         
-        this->qSort(nodes, splitDimensionIndex);
+        const vector<KdTreeCandidate>& candidates = context.query.candidates;
         
-        KdTreeNode *node = new KdTreeNode(this->getSplitNode(nodes, splitDimensionIndex));
+        vector<KdTreeCandidate>::const_iterator candidateIterator;
+        
+        for (candidateIterator = candidates.begin(); candidateIterator != candidates.end(); ++candidateIterator) {
+            
+            KdTreeSearchResult result;
+            result.pointIndex = this->treeNodes[(*candidateIterator).node].pointIndex;
+            result.category = this->categories[result.pointIndex];
+            result.score = this->getScore(context.query, *candidateIterator);
+            
+            context.results.push_back(result);
+        }
+    }
+    
+    void KdTree::searchNearest(const vector<FeatureType>& features, size_t k, QueryContext& context) const {
         
-        vector<KdTreeNode> leftTree = this->getLeftTree(nodes, *node, splitDimensionIndex);
-        vector<KdTreeNode> rightTree = this->getRightTree(nodes, *node, splitDimensionIndex);
+        const vector<FeatureType>& searchFeatures = this->getSearchFeatures(features, context.transformedFeatures, context.projectedFeatures);
         
-        node->setSplitFeatureIndex(splitDimensionIndex);
+        KdTreeQuery& query = context.query;
+        query.reset(searchFeatures, features, this->getCandidatesNumber(k));
         
-        KdTreeNode *leftTreeRootNode = (this->buildTree(leftTree));
-        node->setLeftChild(leftTreeRootNode);
-        if (leftTreeRootNode != NULL) {
-            leftTreeRootNode->setParent(node);
+        NodeIndexType node = this->nearestLeafNode(searchFeatures);
+        
+        this->startBacktracking(query, node, false);
+        
+        //Do search until root.
+        while (query.searchPathNode != NullNodeIndex) {
+            this->backtrackingStep(query, false);
         }
         
+        this->finishQuery(query, k);
+    }
+    
+    void KdTree::finishQuery(KdTreeQuery& query, size_t k) const {
         
-        KdTreeNode *rightTreeRootNode = (this->buildTree(rightTree));
-        node->setRightChild(rightTreeRootNode);
-        if (rightTreeRootNode != NULL) {
-            rightTreeRootNode->setParent(node);
+        const vector<KdTreeCandidate>& heapCandidates = query.candidateMaxHeap.getData();
+        
+        query.candidates.assign(heapCandidates.begin(), heapCandidates.end());
+        
+        if (this->isRerankNeeded() == true) {
+            this->rerankCandidates(query, k);
         }
         
-        return node;
+        sort(query.candidates.begin(), query.candidates.end(), KdTreeCandidateDistanceLess());
+    }
+    
+    const vector<KdTreeNode> KdTree::getQueryResult(const KdTreeQuery& query) const {
+        
+        vector<KdTreeNode> result;
+        
+        const vector<KdTreeCandidate>& candidates = query.candidates;
+        
+        vector<KdTreeCandidate>::const_iterator candidateIterator;
+        
+        for (candidateIterator = candidates.begin(); candidateIterator != candidates.end(); ++candidateIterator) {
+            
+            result.push_back(this->getTreeNode((*candidateIterator).node));
+            result.back().setScore(this->getScore(query, *candidateIterator));
+        }
+        
+        return result;
+    }
+    
+    NodeDistanceType KdTree::getScore(const KdTreeQuery& query, const KdTreeCandidate& candidate) const {
+        
+        if (this->builtSearchMode == CosineSearch) {
+            
+            //A zero query has similarity 0 to every point like a zero point, BruteForceSearcher and SparseIndex score them the same.
+            if (isZeroVector(*(query.sourceFeatures)) == true) {
+                return 0;
+            }
+            
+            //|q - p|^2 = 2 - 2 cos for unit vectors.
+            return 1 - candidate.distance / 2;
+        }
+        
+        if (this->builtSearchMode == InnerProductSearch) {
+            
+            const vector<FeatureType>& features = *(query.sourceFeatures);
+            const FeatureType* point = this->sourcePoints.getPoint(this->treeNodes[candidate.node].pointIndex);
+            
+            NodeDistanceType innerProduct = 0;
+            
+            for (size_t index = 0; index < features.size(); ++index) {
+                innerProduct += features[index] * point[index];
+            }
+            
+            return innerProduct;
+        }
+        
+        return sqrt(candidate.distance);
+    }
+    
+    //Appends sqrt(M^2 - |p|^2) to every point, all augmented points then have norm M.
+    void KdTree::augmentForInnerProduct() {
+        
+        size_t pointNumber = this->points.getPointNumber();
+        DimensionNumber dimensionNumber = this->points.getDimensionNumber();
+        
+        vector<FeatureType> squaredNorms(pointNumber);
+        
+        for (PointIndexType pointIndex = 0; pointIndex < pointNumber; ++pointIndex) {
+            
+            const FeatureType* point = this->points.getPoint(pointIndex);
+            
+            FeatureType squaredNorm = 0;
+            
+            for (DimensionNumber index = 0; index < dimensionNumber; ++index) {
+                squaredNorm += point[index] * point[index];
+            }
+            
+            squaredNorms[pointIndex] = squaredNorm;
+            this->maxSquaredNorm = max(this->maxSquaredNorm, squaredNorm);
+        }
+        
+        vector<FeatureType> augmented(pointNumber * (dimensionNumber + 1));
+        
+        for (PointIndexType pointIndex = 0; pointIndex < pointNumber; ++pointIndex) {
+            
+            const FeatureType* point = this->points.getPoint(pointIndex);
+            FeatureType* augmentedPoint = &(augmented[pointIndex * (dimensionNumber + 1)]);
+            
+            copy(point, point + dimensionNumber, augmentedPoint);
+            augmentedPoint[dimensionNumber] = sqrt(max(this->maxSquaredNorm - squaredNorms[pointIndex], 0.0));
+        }
+        
+        this->points.assign(augmented.data(), pointNumber, dimensionNumber + 1);
     }
     
-    DimensionNumber KdTree::getMaxVarianceDimensionIndex(const vector<KdTreeNode>& nodesVector) {
+    //Projects the centered points onto the leading eigenvectors of their covariance, covariance and projection are one blocked multiplication each.
+    void KdTree::buildPrincipalComponents() {
+        
+        SizeType pointNumber = this->points.getPointNumber();
+        SizeType dimensionNumber = this->points.getDimensionNumber();
+        
+        Math::StatisticsAccumulator statistics(dimensionNumber);
+        statistics.addRows(this->points.getPoint(0), pointNumber);
         
-        assert(nodesVector.size() > 0);
+        this->principalMeans = statistics.getMeans();
         
-        vector<double> variancesVector;
+        Matrix centered(pointNumber, dimensionNumber);
+        ElementType* centeredData = centered.getData();
         
-        vector<KdTreeNode>::const_iterator nodeIterator;
+        for (SizeType pointIndex = 0; pointIndex < pointNumber; ++pointIndex) {
+            
+            const FeatureType* point = this->points.getPoint(pointIndex);
+            
+            for (SizeType index = 0; index < dimensionNumber; ++index) {
+                centeredData[pointIndex * dimensionNumber + index] = point[index] - this->principalMeans[index];
+            }
+        }
+        
+        Matrix covariance = centered.transposeMatrix() * centered;
+        covariance *= 1.0 / (pointNumber - 1);
+        
+        SymmetricEigenDecomposition decomposition(covariance);
+        
+        SizeType componentsNumber = dimensionNumber;
+        
+        if (this->principalComponentsNumber > 0) {
+            componentsNumber = min(this->principalComponentsNumber, dimensionNumber);
+        }
+        
+        const ElementType* eigenvectors = decomposition.getEigenvectors().getData();
+        
+        this->principalAxes = Matrix(componentsNumber, dimensionNumber);
+        copy(eigenvectors, eigenvectors + componentsNumber * dimensionNumber, this->principalAxes.getData());
+        
+        Matrix projected = centered * this->principalAxes.transposeMatrix();
+        
+        this->points.assign(projected.getData(), pointNumber, componentsNumber);
+    }
+    
+    //Builds the subtree over pointIndices[low, up), the split rule picks the point that becomes the node.
+    //Points equal to the split feature may fall on either side, so the left subtree holds features <= split feature and the right subtree features >= split feature.
+    NodeIndexType KdTree::buildTree(size_t low, size_t up, NodeIndexType parent) {
+        
+        if (low >= up) {
+            return NullNodeIndex;
+        }
+        
+        DimensionNumber splitDimensionIndex = 0;
+        
+        size_t middle = this->partitionForSplit(low, up, splitDimensionIndex);
+        
+        TreeNode treeNode;
+        treeNode.pointIndex = this->buildContext->pointIndices[middle];
+        treeNode.splitFeatureIndex = splitDimensionIndex;
+        treeNode.splitFeature = this->points.getFeature(treeNode.pointIndex, splitDimensionIndex);
+        treeNode.parent = parent;
+        treeNode.leftChild = NullNodeIndex;
+        treeNode.rightChild = NullNodeIndex;
+        
+        NodeIndexType node = this->treeNodes.size();
+        this->treeNodes.push_back(treeNode);
+        
+        NodeIndexType leftTreeRootNode = this->buildTree(low, middle, node);
+        this->treeNodes[node].leftChild = leftTreeRootNode;
+        
+        NodeIndexType rightTreeRootNode = this->buildTree(middle + 1, up, node);
+        this->treeNodes[node].rightChild = rightTreeRootNode;
+        
+        return node;
+    }
+    
+    size_t KdTree::partitionForSplit(size_t low, size_t up, DimensionNumber& splitDimensionIndex) {
         
-        nodeIterator = nodesVector.begin();
+        this->collectSplitStatistics(low, up);
         
-        DimensionNumber dimensionNumber;
+        bool isMidpointSplit = false;
         
-        dimensionNumber = (*nodeIterator).getFeatures().size();
+        if (this->splitRule == MaxSpreadMedianSplit) {
+            splitDimensionIndex = this->getMaxSpreadDimensionIndex();
+        } else if (this->splitRule == SlidingMidpointSplit) {
+            splitDimensionIndex = this->getMaxSpreadDimensionIndex();
+            isMidpointSplit = true;
+        } else if (this->splitRule == CostModelSplit && up - low >= CostModelMinPointsNumber) {
+            this->chooseCostModelSplit(low, up, splitDimensionIndex, isMidpointSplit);
+        } else {
+            splitDimensionIndex = this->buildContext->splitStatistics.maxVarianceColumnIndex();
+        }
         
-        for (DimensionNumber index = 0; index < dimensionNumber; ++index) {
-            vector<FeatureType> dimensionVector = this->getNodeFeatureInDimension(nodesVector, index);
-            variancesVector.push_back(Math::variance(dimensionVector));
+        //All points equal on the dimension leave no midpoint to slide to.
+        if (isMidpointSplit == true && this->buildContext->splitStatistics.getMinValue(splitDimensionIndex) < this->buildContext->splitStatistics.getMaxValue(splitDimensionIndex)) {
+            return this->partitionAtMidpoint(low, up, splitDimensionIndex);
         }
         
-        return Math::maxValueIndex(variancesVector);
+        return this->partitionAtMedian(low, up, splitDimensionIndex);
+    }
+    
+    size_t KdTree::partitionAtMedian(size_t low, size_t up, DimensionNumber splitDimensionIndex) {
+        
+        size_t middle = low + (up - low) / 2;
+        
+        nth_element(this->buildContext->pointIndices.begin() + low, this->buildContext->pointIndices.begin() + middle, this->buildContext->pointIndices.begin() + up, PointFeatureLess(this->points, splitDimensionIndex));
+        
+        return middle;
+    }
+    
+    //Points below the midpoint go left, the smallest point at or above it becomes the node, which slides the plane onto the data.
+    size_t KdTree::partitionAtMidpoint(size_t low, size_t up, DimensionNumber splitDimensionIndex) {
+        
+        FeatureType midpoint = (this->buildContext->splitStatistics.getMinValue(splitDimensionIndex) + this->buildContext->splitStatistics.getMaxValue(splitDimensionIndex)) / 2;
+        
+        vector<PointIndexType>::iterator upperBegin = partition(this->buildContext->pointIndices.begin() + low, this->buildContext->pointIndices.begin() + up, PointFeatureBelow(this->points, splitDimensionIndex, midpoint));
+        
+        assert(upperBegin != this->buildContext->pointIndices.begin() + up);
+        
+        iter_swap(upperBegin, min_element(upperBegin, this->buildContext->pointIndices.begin() + up, PointFeatureLess(this->points, splitDimensionIndex)));
+        
+        return upperBegin - this->buildContext->pointIndices.begin();
     }
     
-    void KdTree::qSort(vector<KdTreeNode>& nodes, DimensionNumber splitDimensionIndex) {
-        this->quickSort(nodes, 0, nodes.size() - 1, splitDimensionIndex);
+    //One pass over the rows of the subtree updates the statistics of all dimensions together.
+    void KdTree::collectSplitStatistics(size_t low, size_t up) {
+        
+        assert(up > low);
+        
+        this->buildContext->splitStatistics.reset();
+        
+        for (size_t position = low; position < up; ++position) {
+            this->buildContext->splitStatistics.add(this->points.getPoint(this->buildContext->pointIndices[position]));
+        }
     }
     
-    void KdTree::quickSort(vector<KdTreeNode>& nodes, size_t low, size_t up, DimensionNumber splitDimensionIndex) {
-        if (low < up) {
-            size_t middle = this->partition(nodes, low, up, splitDimensionIndex);
+    DimensionNumber KdTree::getMaxSpreadDimensionIndex() const {
+        
+        DimensionNumber maxSpreadDimensionIndex = 0;
+        FeatureType maxSpread = -1;
+        
+        for (DimensionNumber dimensionIndex = 0; dimensionIndex < this->buildContext->splitStatistics.getColumnsNumber(); ++dimensionIndex) {
+            
+            FeatureType spread = this->buildContext->splitStatistics.getMaxValue(dimensionIndex) - this->buildContext->splitStatistics.getMinValue(dimensionIndex);
             
-            if (middle > 0) {
-                this->quickSort(nodes, low, middle - 1, splitDimensionIndex);
-                this->quickSort(nodes, middle + 1, up, splitDimensionIndex);
+            if (spread > maxSpread) {
+                maxSpread = spread;
+                maxSpreadDimensionIndex = dimensionIndex;
             }
         }
+        
+        return maxSpreadDimensionIndex;
     }
     
-    size_t KdTree::partition(vector<KdTreeNode>& nodes, size_t low, size_t up, DimensionNumber splitDimensionIndex) {
+    //Evenly spaced points of the subtree stand in for queries. A query also visits the far side of a split when its neighbourhood reaches the plane,
+    //the neighbourhood radius being its nearest neighbour distance among the samples scaled down to the density of the whole subtree.
+    //The expected cost of a split is the mean number of points in the cells a sampled query visits, the cheapest median or midpoint split of the widest dimensions wins.
+    void KdTree::chooseCostModelSplit(size_t low, size_t up, DimensionNumber& splitDimensionIndex, bool& isMidpointSplit) const {
         
-        using std::swap;
+        size_t pointNumber = up - low;
+        size_t samplesNumber = min(pointNumber, (size_t)CostModelSamplesNumber);
+        DimensionNumber dimensionNumber = this->points.getDimensionNumber();
+        
+        vector<PointIndexType>& samples = this->buildContext->samples;
+        samples.resize(samplesNumber);
         
-        KdTreeNode& pivot = nodes.at(up);
-        size_t index0 = low;
+        for (size_t sampleIndex = 0; sampleIndex < samplesNumber; ++sampleIndex) {
+            samples[sampleIndex] = this->buildContext->pointIndices[low + sampleIndex * pointNumber / samplesNumber];
+        }
         
-        for (size_t index1 = low; index1 < up - 1; ++index1) {
+        FeatureType densityScale = pow((double)samplesNumber / pointNumber, 1.0 / dimensionNumber);
+        
+        vector<FeatureType>& radii = this->buildContext->radii;
+        radii.assign(samplesNumber, numeric_limits<FeatureType>::max());
+        
+        for (size_t sampleIndex = 0; sampleIndex < samplesNumber; ++sampleIndex) {
             
-            if (nodes.at(index1).getFeatures().at(splitDimensionIndex) <= pivot.getFeatures().at(splitDimensionIndex)) {
+            const FeatureType* sample = this->points.getPoint(samples[sampleIndex]);
+            
+            for (size_t otherIndex = sampleIndex + 1; otherIndex < samplesNumber; ++otherIndex) {
+                
+                const FeatureType* other = this->points.getPoint(samples[otherIndex]);
+                
+                FeatureType squaredDistance = 0;
+                
+                for (DimensionNumber index = 0; index < dimensionNumber; ++index) {
+                    FeatureType difference = sample[index] - other[index];
+                    squaredDistance += difference * difference;
+                }
                 
-                swap(nodes.at(index0), nodes.at(index1));
-                ++index0;
+                radii[sampleIndex] = min(radii[sampleIndex], squaredDistance);
+                radii[otherIndex] = min(radii[otherIndex], squaredDistance);
             }
         }
         
-        swap(nodes.at(index0), nodes.at(up));
+        for (size_t sampleIndex = 0; sampleIndex < samplesNumber; ++sampleIndex) {
+            radii[sampleIndex] = sqrt(radii[sampleIndex]) * densityScale;
+        }
+        
+        vector< pair<FeatureType, DimensionNumber> >& spreads = this->buildContext->spreads;
+        spreads.resize(dimensionNumber);
+        
+        for (DimensionNumber dimensionIndex = 0; dimensionIndex < dimensionNumber; ++dimensionIndex) {
+            spreads[dimensionIndex] = make_pair(this->buildContext->splitStatistics.getMaxValue(dimensionIndex) - this->buildContext->splitStatistics.getMinValue(dimensionIndex), dimensionIndex);
+        }
+        
+        size_t candidateDimensionsNumber = min((size_t)dimensionNumber, (size_t)CostModelDimensionsNumber);
+        
+        partial_sort(spreads.begin(), spreads.begin() + candidateDimensionsNumber, spreads.end(), greater< pair<FeatureType, DimensionNumber> >());
         
-        return index0;
+        splitDimensionIndex = spreads.front().second;
+        isMidpointSplit = false;
+        
+        double minCost = numeric_limits<double>::max();
+        
+        vector<FeatureType>& sampleFeatures = this->buildContext->sampleFeatures;
+        sampleFeatures.resize(samplesNumber);
+        
+        for (size_t candidateIndex = 0; candidateIndex < candidateDimensionsNumber; ++candidateIndex) {
+            
+            DimensionNumber dimensionIndex = spreads[candidateIndex].second;
+            
+            for (size_t sampleIndex = 0; sampleIndex < samplesNumber; ++sampleIndex) {
+                sampleFeatures[sampleIndex] = this->points.getFeature(samples[sampleIndex], dimensionIndex);
+            }
+            
+            vector<FeatureType>& sortedFeatures = this->buildContext->sortedFeatures;
+            sortedFeatures.assign(sampleFeatures.begin(), sampleFeatures.end());
+            nth_element(sortedFeatures.begin(), sortedFeatures.begin() + samplesNumber / 2, sortedFeatures.end());
+            
+            FeatureType splitValues[2] = {sortedFeatures[samplesNumber / 2], (this->buildContext->splitStatistics.getMinValue(dimensionIndex) + this->buildContext->splitStatistics.getMaxValue(dimensionIndex)) / 2};
+            
+            for (size_t ruleIndex = 0; ruleIndex < 2; ++ruleIndex) {
+                
+                size_t lowerSamplesNumber = 0;
+                
+                for (size_t sampleIndex = 0; sampleIndex < samplesNumber; ++sampleIndex) {
+                    
+                    if (sampleFeatures[sampleIndex] < splitValues[ruleIndex]) {
+                        ++lowerSamplesNumber;
+                    }
+                }
+                
+                double lowerPointsNumber = (double)pointNumber * lowerSamplesNumber / samplesNumber;
+                double upperPointsNumber = pointNumber - lowerPointsNumber;
+                
+                double cost = 0;
+                
+                for (size_t sampleIndex = 0; sampleIndex < samplesNumber; ++sampleIndex) {
+                    
+                    bool isLower = sampleFeatures[sampleIndex] < splitValues[ruleIndex];
+                    
+                    cost += isLower == true ? lowerPointsNumber : upperPointsNumber;
+                    
+                    if (fabs(sampleFeatures[sampleIndex] - splitValues[ruleIndex]) < radii[sampleIndex]) {
+                        cost += isLower == true ? upperPointsNumber : lowerPointsNumber;
+                    }
+                }
+                
+                if (cost < minCost) {
+                    minCost = cost;
+                    splitDimensionIndex = dimensionIndex;
+                    isMidpointSplit = ruleIndex == 1;
+                }
+            }
+        }
     }
     
-    KdTreeNode* KdTree::nearestLeafNode(const vector<FeatureType>& features) {
+    //Nodes come out of buildTree in depth first order, other layouts permute the node array in place and remap the links.
+    void KdTree::applyLayout(BuildContext& context) {
+        
+        if (this->rootNode == NullNodeIndex) {
+            return;
+        }
         
-        KdTreeNode* node = this->rootNode;
+        vector<NodeIndexType>& order = context.nodeOrder;
+        order.clear();
+        order.reserve(this->treeNodes.size());
         
-        while (node->isLeafNode() == false) {
+        vector<NodeIndexType>& path = context.nodeStack;
+        path.clear();
+        
+        if (this->layout == VanEmdeBoasLayout) {
+            this->vanEmdeBoasOrder(this->rootNode, this->getTreeHeight(this->rootNode), order, path);
+        } else {
             
-            FeatureIndexType splitFeatureIndex = node->getSplitFeatureIndex();
+            path.push_back(this->rootNode);
             
-            if (features.at(splitFeatureIndex) < node->getSplitFeature()) {
+            while (path.empty() == false) {
                 
-                if (node->getLeftChild() == NULL) {
-                    break;
-                }
+                NodeIndexType node = path.back();
+                path.pop_back();
                 
-                node = node->getLeftChild();
-            } else {
+                order.push_back(node);
                 
-                if (node->getRightChild() == NULL) {
-                    break;
+                if (this->treeNodes[node].rightChild != NullNodeIndex) {
+                    path.push_back(this->treeNodes[node].rightChild);
                 }
                 
-                node = node->getRightChild();
+                if (this->treeNodes[node].leftChild != NullNodeIndex) {
+                    path.push_back(this->treeNodes[node].leftChild);
+                }
+            }
+        }
+        
+        assert(order.size() == this->treeNodes.size());
+        
+        vector<NodeIndexType>& newIndices = context.newIndices;
+        newIndices.resize(this->treeNodes.size());
+        
+        for (size_t position = 0; position < order.size(); ++position) {
+            newIndices[order[position]] = position;
+        }
+        
+        TreeNodeVector::iterator treeNodeIterator;
+        
+        for (treeNodeIterator = this->treeNodes.begin(); treeNodeIterator != this->treeNodes.end(); ++treeNodeIterator) {
+            
+            TreeNode& treeNode = *treeNodeIterator;
+            
+            if (treeNode.parent != NullNodeIndex) {
+                treeNode.parent = newIndices[treeNode.parent];
+            }
+            
+            if (treeNode.leftChild != NullNodeIndex) {
+                treeNode.leftChild = newIndices[treeNode.leftChild];
             }
+            
+            if (treeNode.rightChild != NullNodeIndex) {
+                treeNode.rightChild = newIndices[treeNode.rightChild];
+            }
+        }
+        
+        this->rootNode = newIndices[this->rootNode];
+        
+        //Follows every cycle of the permutation, each swap puts one node at its final position.
+        for (size_t position = 0; position < newIndices.size(); ++position) {
+            
+            while (newIndices[position] != position) {
+                
+                NodeIndexType target = newIndices[position];
+                
+                std::swap(this->treeNodes[position], this->treeNodes[target]);
+                std::swap(newIndices[position], newIndices[target]);
+            }
+        }
+    }
+    
+    size_t KdTree::getTreeHeight(NodeIndexType treeRootNode) const {
+        
+        if (treeRootNode == NullNodeIndex) {
+            return 0;
+        }
+        
+        const TreeNode& treeNode = this->treeNodes[treeRootNode];
+        
+        return 1 + max(this->getTreeHeight(treeNode.leftChild), this->getTreeHeight(treeNode.rightChild));
+    }
+    
+    //Lays out the top half of the levels first and then every bottom subtree, each part recursively in the same way.
+    void KdTree::vanEmdeBoasOrder(NodeIndexType treeRootNode, size_t height, vector<NodeIndexType>& order, vector<NodeIndexType>& subTreeRoots) const {
+        
+        if (treeRootNode == NullNodeIndex || height == 0) {
+            return;
+        }
+        
+        if (height == 1) {
+            order.push_back(treeRootNode);
+            return;
+        }
+        
+        size_t topHeight = height / 2;
+        size_t bottomHeight = height - topHeight;
+        
+        this->vanEmdeBoasOrder(treeRootNode, topHeight, order, subTreeRoots);
+        
+        //Indices rather than iterators, the nested calls append to the same vector.
+        size_t rootsBegin = subTreeRoots.size();
+        this->subTreeRootsInDepth(treeRootNode, topHeight, subTreeRoots);
+        size_t rootsEnd = subTreeRoots.size();
+        
+        for (size_t rootIndex = rootsBegin; rootIndex < rootsEnd; ++rootIndex) {
+            this->vanEmdeBoasOrder(subTreeRoots[rootIndex], bottomHeight, order, subTreeRoots);
+        }
+        
+        subTreeRoots.resize(rootsBegin);
+    }
+    
+    void KdTree::subTreeRootsInDepth(NodeIndexType treeRootNode, size_t depth, vector<NodeIndexType>& subTreeRoots) const {
+        
+        if (treeRootNode == NullNodeIndex) {
+            return;
+        }
+        
+        if (depth == 0) {
+            subTreeRoots.push_back(treeRootNode);
+            return;
+        }
+        
+        this->subTreeRootsInDepth(this->treeNodes[treeRootNode].leftChild, depth - 1, subTreeRoots);
+        this->subTreeRootsInDepth(this->treeNodes[treeRootNode].rightChild, depth - 1, subTreeRoots);
+    }
+    
+    //Descends to a real leaf, a missing child on the query side sends the descent into the other child so that no subtree is skipped while backtracking.
+    NodeIndexType KdTree::nearestLeafNode(const vector<FeatureType>& features) const {
+        
+        NodeIndexType node = this->rootNode;
+        NodeIndexType nextNode = this->nextDescentNode(features, node);
+        
+        while (nextNode != NullNodeIndex) {
+            node = nextNode;
+            nextNode = this->nextDescentNode(features, node);
         }
         
         return node;
     }
     
-    const bool KdTree::isSearchNeededInBranch(const KdTreeNodeMaxHeap& nodeMaxHeap, KdTreeNode* parent) const {
+    const bool KdTree::isSearchNeededInBranch(const KdTreeCandidateMaxHeap& candidateMaxHeap, const vector<FeatureType>& features, NodeIndexType parent) const {
         
         bool result = false;
         
-        if (parent != NULL) {
+        if (parent != NullNodeIndex) {
             
-            FeatureIndexType splitFeatureIndex = parent->getSplitFeatureIndex();
+            const TreeNode& treeNode = this->treeNodes[parent];
             
-            NodeDistanceType splitFeatureDistance = fabs(nodeMaxHeap.featuresCompared().at(splitFeatureIndex) - parent->getFeatures().at(splitFeatureIndex));
+            NodeDistanceType splitFeatureDistance = features.at(treeNode.splitFeatureIndex) - treeNode.splitFeature;
             
-            //Ingore the same node distance between parent.
-            if (nodeMaxHeap.maxDistanceCompared() > splitFeatureDistance) {
+            //Ingore the same node distance between parent, distances in the heap are squared.
+            if (candidateMaxHeap.maxDistanceCompared() > splitFeatureDistance * splitFeatureDistance) {
                 result = true;
             }
         }
@@ -278,42 +1089,95 @@ namespace std {
         return result;
     }
     
-    const bool KdTree::isFeatureNodeContained(const vector<FeatureType>& features) const {
+    //Truncated components are re-ranked in the normalized space, rotations keep Euclidean distances. The original points are normalized on the fly.
+    //Inner product search re-ranks by the exact augmented distance, which only needs q.p.
+    void KdTree::rerankCandidates(KdTreeQuery& query, size_t k) const {
         
-        bool result = false;
+        vector<KdTreeCandidate>& candidates = query.candidates;
         
-        KdTreeNode* node = this->rootNode;
+        vector<KdTreeCandidate>::iterator candidateIterator;
         
-        while (node->isLeafNode() == false) {
+        if (this->builtSearchMode == InnerProductSearch) {
             
-            if (node->getFeatures() == features) {
-                result = true;
-                break;
+            const vector<FeatureType>& features = *(query.sourceFeatures);
+            
+            NodeDistanceType squaredNorm = 0;
+            
+            for (size_t index = 0; index < features.size(); ++index) {
+                squaredNorm += features[index] * features[index];
             }
             
-            FeatureIndexType splitFeatureIndex = node->getSplitFeatureIndex();
+            //|q - p|^2 of the augmented vectors.
+            for (candidateIterator = candidates.begin(); candidateIterator != candidates.end(); ++candidateIterator) {
+                (*candidateIterator).distance = squaredNorm + this->maxSquaredNorm - 2 * this->getScore(query, *candidateIterator);
+            }
+            
+        } else if (this->isTruncated() == true) {
+            
+            vector<FeatureType>& normalizedFeatures = query.rerankFeatures;
+            this->normalizer.apply(*(query.sourceFeatures), normalizedFeatures);
             
-            if (node->getSplitFeature() < features.at(splitFeatureIndex)) {
+            for (candidateIterator = candidates.begin(); candidateIterator != candidates.end(); ++candidateIterator) {
                 
-                if (node->getLeftChild() == NULL) {
-                    break;
-                }
+                const FeatureType* point = this->sourcePoints.getPoint(this->treeNodes[(*candidateIterator).node].pointIndex);
                 
-                node = node->getLeftChild();
-            } else {
+                (*candidateIterator).distance = this->normalizer.normalizedSquaredDistance(normalizedFeatures.data(), point, normalizedFeatures.size());
+            }
+            
+        } else {
+            
+            for (candidateIterator = candidates.begin(); candidateIterator != candidates.end(); ++candidateIterator) {
+                (*candidateIterator).distance = this->exactSquaredDistance(*(query.features), this->treeNodes[(*candidateIterator).node].pointIndex);
+            }
+        }
+        
+        if (this->zeroNormPoints.empty() == false) {
+            
+            for (candidateIterator = candidates.begin(); candidateIterator != candidates.end(); ++candidateIterator) {
                 
-                if (node->getRightChild() == NULL) {
-                    break;
+                if (this->isZeroNormPoint(this->treeNodes[(*candidateIterator).node].pointIndex) == true) {
+                    (*candidateIterator).distance = ZeroNormCosineDistance;
                 }
-                
-                node = node->getRightChild();
             }
         }
         
-        if (result != true) {
+        if (candidates.size() > k) {
+            nth_element(candidates.begin(), candidates.begin() + k, candidates.end(), KdTreeCandidateDistanceLess());
+            candidates.resize(k);
+        }
+    }
+    
+    const bool KdTree::isFeatureNodeContained(const vector<FeatureType>& features) const {
+        
+        bool result = false;
+        
+        stack<NodeIndexType> path;
+        
+        if (this->rootNode != NullNodeIndex) {
+            path.push(this->rootNode);
+        }
+        
+        while (path.empty() == false) {
+            
+            const TreeNode& treeNode = this->treeNodes[path.top()];
+            path.pop();
+            
+            const FeatureType* point = this->points.getPoint(treeNode.pointIndex);
             
-            if (node->getFeatures() == features) {
+            if (equal(features.begin(), features.end(), point) == true) {
                 result = true;
+                break;
+            }
+            
+            FeatureType feature = features.at(treeNode.splitFeatureIndex);
+            
+            //Equal split features may sit in both subtrees.
+            if (feature <= treeNode.splitFeature && treeNode.leftChild != NullNodeIndex) {
+                path.push(treeNode.leftChild);
+            }
+            
+            if (feature >= treeNode.splitFeature && treeNode.rightChild != NullNodeIndex) {
+                path.push(treeNode.rightChild);
             }
         }
         
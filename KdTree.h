@@ -5,15 +5,32 @@
 #include "assert.h"
 #include "MaxHeap.h"
 #include "Measurement.h"
+#include "PointBuffer.h"
+#include "Quantization.h"
+#include "Normalization.h"
+#include "Statistics.h"
+#include "MemoryResource.h"
 #include <stack>
+#include <memory>
+#include <algorithm>
+#include <utility>
 #include "iostream"
 
+//Prefetching only hides latency, builds without the builtin behave the same.
+#if defined(__GNUC__) || defined(__clang__)
+#define KD_TREE_PREFETCH(address) __builtin_prefetch((address))
+#else
+#define KD_TREE_PREFETCH(address)
+#endif
+
+#define KD_TREE_CACHE_LINE_SIZE 64
+#define KD_TREE_PREFETCH_DISTANCE 4
+
 namespace std {
     
     using namespace std;
     
     typedef unsigned long FeatureIndexType;
-    typedef double FeatureType;
     typedef unsigned long NodeCategory;
     typedef double NodeDistanceType;
     
@@ -57,6 +74,10 @@ namespace std {
         
         const bool isLeafNode() const;
         
+        //Set on search results: the distance to the query in Euclidean search, the similarity in cosine and inner product search.
+        void setScore(NodeDistanceType score);
+        NodeDistanceType getScore() const;
+        
         friend bool operator>(const KdTreeNode& lhs, const KdTreeNode& rhs) {
             
             bool result = false;
@@ -88,12 +109,45 @@ namespace std {
         vector<FeatureType> features;
         NodeCategory category;
         
+        NodeDistanceType score;
+        
         KdTreeNode *parent;
         KdTreeNode *leftChild;
         KdTreeNode *rightChild;
     };
     
-    typedef size_t DimensionNumber;
+    typedef size_t NodeIndexType;
+    
+    //Search result that refers to its point instead of copying the features, KdTree::getResultFeatures looks them up.
+    struct KdTreeSearchResult {
+        PointIndexType pointIndex;
+        NodeCategory category;
+        NodeDistanceType score;
+    };
+    
+    //What nearest means. Cosine search normalizes points and queries to unit length, where the Euclidean order is the cosine order.
+    //Inner product search appends sqrt(M^2 - |p|^2) to every point p and 0 to queries, M being the largest point norm, so |q - p|^2 = |q|^2 + M^2 - 2 q.p and the Euclidean order is the inner product order.
+    enum KdTreeSearchMode {
+        EuclideanSearch,
+        CosineSearch,
+        InnerProductSearch
+    };
+    
+    //How a node picks its split. The median of the max variance dimension keeps the tree balanced but on clustered data cuts clusters into long thin cells.
+    //Sliding midpoint halves the widest dimension and slides the plane to the nearest point, so cells stay fat at the price of balance.
+    //The cost model samples points of the subtree as queries and picks, among median and midpoint splits of the widest dimensions, the one whose cells the sampled queries' neighbourhoods cross least.
+    enum KdTreeSplitRule {
+        MaxVarianceMedianSplit,
+        MaxSpreadMedianSplit,
+        SlidingMidpointSplit,
+        CostModelSplit
+    };
+    
+    //Order of the tree nodes in memory. The van Emde Boas layout stores every subtree of half the height contiguously, so a root to leaf descent touches O(log_B n) cache lines instead of one per level.
+    enum KdTreeLayout {
+        DepthFirstLayout,
+        VanEmdeBoasLayout
+    };
     
     class KdTree {
         
@@ -101,234 +155,708 @@ namespace std {
         
         KdTree();
         
+        //Copy of a built tree whose points and nodes are allocated from the resource, for instance a replica on another NUMA node.
+        KdTree(const KdTree& rhs, const shared_ptr<MemoryResource>& memoryResource);
+        
         ~KdTree();
         
+        class BuildContext;
+        
+        //Points are copied once into a contiguous buffer, the tree itself only keeps indices into it.
         void build(const vector< vector<FeatureType> >& featuresVector, const vector<NodeCategory>& categoriesVector);
         
+        //Keeps the build temporaries in the context, repeated builds with one context reuse them instead of allocating them again.
+        void build(const vector< vector<FeatureType> >& featuresVector, const vector<NodeCategory>& categoriesVector, BuildContext& context);
+        
+        //Takes effect on the next build. The points and the nodes are allocated from the resource, the tree shares its ownership so the resource lives as long as any tree built into it.
+        //With a MonotonicArena per tree a build is a few large allocations and destroying the tree frees whole blocks. An arena never reuses memory, so rebuilding one tree into it grows it by a tree each time.
+        void setMemoryResource(const shared_ptr<MemoryResource>& memoryResource);
+        const shared_ptr<MemoryResource>& getMemoryResource() const;
+        
+        //Takes effect on the next build. With quantization traversal and scanning read the compressed codes, the final candidates are re-ranked against the full precision points.
+        //Quantization does not shrink the tree on its own: the codes, 1 byte per feature with Int8Quantization and 2 with Float16Quantization, come on top of the full precision points, sizeof(FeatureType) per feature and twice that when the search transforms the points (normalization, cosine or inner product, whitening, rotation) and the source points are kept too.
+        void setQuantizationType(QuantizationType quantizationType);
+        QuantizationType getQuantizationType() const;
+        
+        //Quantized search collects k * rerankFactor candidates before the exact re-rank.
+        void setRerankFactor(size_t rerankFactor);
+        size_t getRerankFactor() const;
+        
+        //Takes effect on the next build. With quantization the full precision points are only read by the re-rank and for the results, they are then allocated from this resource, for instance a PageMemoryResource apart from the codes and nodes the traversal reads.
+        //Without quantization or without a resource they share the resource of the tree.
+        //The points leave memory only with a file backed resource such as MappedFileMemoryResource, the kernel then reads back the pages of the re-ranked candidates and the resident size is about the codes, the nodes and the categories.
+        void setExactPointsResource(const shared_ptr<MemoryResource>& exactPointsResource);
+        const shared_ptr<MemoryResource>& getExactPointsResource() const;
+        
+        //Used by every following build, an already built tree is laid out again at once.
+        void setLayout(KdTreeLayout layout);
+        KdTreeLayout getLayout() const;
+        
+        //Takes effect on the next build.
+        void setSplitRule(KdTreeSplitRule splitRule);
+        KdTreeSplitRule getSplitRule() const;
+        
+        //Takes effect on the next build. Cosine search keeps the results' features but scores them by similarity, it implies L2 normalization.
+        void setSearchMode(KdTreeSearchMode searchMode);
+        KdTreeSearchMode getSearchMode() const;
+        
+        //Takes effect on the next build. The parameters are fitted on the built points and applied to every query, results keep the original features.
+        void setNormalizationType(NormalizationType normalizationType);
+        NormalizationType getNormalizationType() const;
+        
+        //Parameters fitted by the last build.
+        const FeatureNormalizer& getNormalizer() const;
+        
+        //Takes effect on the next build, which applies the fitted parameters instead of fitting its own. Indexes over parts of one collection share one scale this way.
+        //Sets the normalization type to the normalizer's, setting another type drops the normalizer.
+        void setFittedNormalizer(const FeatureNormalizer& normalizer);
+        void clearFittedNormalizer();
+        
+        //Takes effect on the next build. Points are whitened by the fitted metric and searched with Euclidean distance, which ranks them by Mahalanobis distance; results keep the original features.
+        void setMahalanobisMetric(const Measurement::MahalanobisMetric& metric);
+        void clearMahalanobisMetric();
+        const Measurement::MahalanobisMetric& getMahalanobisMetric() const;
+        
+        //Takes effect on the next build. Points and queries are rotated onto the principal components of the data, so splits follow the directions of largest spread instead of the coordinate axes.
+        //A componentsNumber below the dimension number keeps only the leading components for traversal, the candidates are then re-ranked against the full precision points.
+        //Applied after normalization. Not combined with a Mahalanobis metric, whitened data has no preferred direction left.
+        void setPrincipalComponentsRotation(bool isRotated, size_t componentsNumber = 0);
+        bool isPrincipalComponentsRotated() const;
+        size_t getPrincipalComponentsNumber() const;
+        
+        inline size_t getNodesNumber() const {
+            return this->treeNodes.size();
+        }
+        
+        //Number of queries nearestKNodes walks through the tree side by side.
+        void setInterleavedQueriesNumber(size_t interleavedQueriesNumber);
+        size_t getInterleavedQueriesNumber() const;
+        
+        //Number of features of the points as they were built, before any transformation.
+        inline DimensionNumber getDimensionNumber() const {
+            return this->sourcePoints.isEmpty() == true ? this->points.getDimensionNumber() : this->sourcePoints.getDimensionNumber();
+        }
+        
+        class QueryContext;
+        
         //Maybe ignore some same distance nodes which have the greatest compare distance in max heap.
-        inline const vector<KdTreeNode> nearestKNode(const vector<FeatureType>& features, size_t k) {
+        inline const vector<KdTreeNode> nearestKNode(const vector<FeatureType>& features, size_t k) const {
             
             vector<KdTreeNode> result;
             
-            KdTreeNodeMaxHeap nodeMaxHeap(k);
-            KdTreeNode objectNode(features);
-            nodeMaxHeap.assignDistanceComparingNode(objectNode);
-            
-            KdTreeNode* node = this->nearestLeafNode(features);
+            if (this->rootNode == NullNodeIndex || k == 0) {
+                return result;
+            }
             
-            nodeMaxHeap.addData(*node);
+            QueryContext context;
             
-            KdTreeNode* searchPathDirectionNode = node;
-            KdTreeNode* searchPathNode = node->getParent();
+            this->searchNearest(features, k, context);
             
-            //Do search until root.
-            while (searchPathNode != NULL) {
-                
-                bool isNeedToSearchInBranch = false;
-                
-                if (nodeMaxHeap.isReachMaxNodeNumber() == false) {
-                    isNeedToSearchInBranch = true;
-                } else {
-                    
-                    if (this->isSearchNeededInBranch(nodeMaxHeap, searchPathNode) == true) {
-                        isNeedToSearchInBranch = true;
-                    }
-                    
-                }
-                
-                if (isNeedToSearchInBranch == true) {
-                    
-                    nodeMaxHeap.addData(*searchPathNode);
-                    
-                    if (searchPathDirectionNode == searchPathNode->getLeftChild()) {
-                        
-                        if (searchPathNode->getRightChild() != NULL) {
-                            vector<KdTreeNode> rightTreeNodes = this->getTreeNodes(searchPathNode->getRightChild());
-                            
-                            vector<KdTreeNode>::const_iterator treeNodeIterator;
-                            
-                            for (treeNodeIterator = rightTreeNodes.begin(); treeNodeIterator != rightTreeNodes.end(); ++treeNodeIterator) {
-                                nodeMaxHeap.addData(*treeNodeIterator);
-                            }
-                        }
-                        
-                    } else {
-                        
-                        if (searchPathNode->getLeftChild() != NULL) {
-                            vector<KdTreeNode> leftTreeNodes = this->getTreeNodes(searchPathNode->getLeftChild());
-                            
-                            vector<KdTreeNode>::const_iterator treeNodeIterator;
-                            
-                            for (treeNodeIterator = leftTreeNodes.begin(); treeNodeIterator != leftTreeNodes.end(); ++treeNodeIterator) {
-                                nodeMaxHeap.addData(*treeNodeIterator);
-                            }
-                            
-                        }
-                        
-                    }
-                }
-                
-                searchPathDirectionNode = searchPathNode;
-                searchPathNode = searchPathNode->getParent();
-            }
+            return this->getQueryResult(context.query);
+        }
+        
+        //Same search in the buffers of the context, once it has served a query of the same size no memory is allocated.
+        //The results, best first, stay in context.getResults() until its next query.
+        void nearestKNode(const vector<FeatureType>& features, size_t k, QueryContext& context) const;
+        
+        //Original features of a result point, getDimensionNumber() of them.
+        inline const FeatureType* getResultFeatures(const KdTreeSearchResult& result) const {
             
-            result = nodeMaxHeap.getAllData();
+            const PointBuffer& resultPoints = this->sourcePoints.isEmpty() == true ? this->points : this->sourcePoints;
             
-            return vector<KdTreeNode>(result);
+            return resultPoints.getPoint(result.pointIndex);
         }
         
+        //Answers a batch of queries, groups of them descend and backtrack in lockstep and every query prefetches the nodes and points of its next step while the others compute distances.
+        const vector< vector<KdTreeNode> > nearestKNodes(const vector< vector<FeatureType> >& featuresVector, size_t k) const;
+        
     private:
         
-        class KdTreeNodeMaxHeap: public MaxHeap<KdTreeNode> {
+        //A tree node met during search together with its squared distance to the query.
+        struct KdTreeCandidate {
+            NodeDistanceType distance;
+            NodeIndexType node;
+        };
+        
+        class KdTreeCandidateMaxHeap: public MaxHeap<KdTreeCandidate> {
             
         public:
             
-            KdTreeNodeMaxHeap(size_t limitedNodesNumber):MaxHeap<KdTreeNode>(limitedNodesNumber) {
+            KdTreeCandidateMaxHeap(size_t limitedNodesNumber):MaxHeap<KdTreeCandidate>(limitedNodesNumber) {
+            
+            }
+            
+            bool isNodeGreaterThanAnother(const KdTreeCandidate& node0, const KdTreeCandidate& node1) {
+                return node0.distance > node1.distance;
+            }
             
+            inline const NodeDistanceType maxDistanceCompared() const {
+                return this->maxData().distance;
             }
+        };
+        
+        //Search state of one query, the backtracking walks from the reached leaf up to the root.
+        class KdTreeQuery {
+            
+        public:
             
-            bool isNodeGreaterThanAnother(const KdTreeNode& node0, const KdTreeNode& node1) {
+            KdTreeQuery():features(NULL), sourceFeatures(NULL), candidateMaxHeap(0), descentNode(NullNodeIndex), searchPathDirectionNode(NullNodeIndex), searchPathNode(NullNodeIndex) {
                 
-                bool result = false;
+            }
+            
+            KdTreeQuery(const vector<FeatureType>& features, const vector<FeatureType>& sourceFeatures, size_t candidatesNumber):features(&features), sourceFeatures(&sourceFeatures), candidateMaxHeap(candidatesNumber), descentNode(NullNodeIndex), searchPathDirectionNode(NullNodeIndex), searchPathNode(NullNodeIndex) {
                 
-                NodeDistanceType distance0 = Measurement::euclideanDistance(node0.getFeatures(), distanceComparingNode.getFeatures());
+            }
+            
+            //Starts a new query, the heap and the scratch buffers keep their storage.
+            inline void reset(const vector<FeatureType>& features, const vector<FeatureType>& sourceFeatures, size_t candidatesNumber) {
                 
-                NodeDistanceType distance1 = Measurement::euclideanDistance(node1.getFeatures(), distanceComparingNode.getFeatures());
+                this->features = &features;
+                this->sourceFeatures = &sourceFeatures;
+                this->candidateMaxHeap.reset(candidatesNumber);
+                this->descentNode = NullNodeIndex;
+                this->searchPathDirectionNode = NullNodeIndex;
+                this->searchPathNode = NullNodeIndex;
+                this->branchStack.clear();
+                this->candidates.clear();
+            }
+            
+            //The query in the search space of the points and as it was given.
+            const vector<FeatureType>* features;
+            const vector<FeatureType>* sourceFeatures;
+            KdTreeCandidateMaxHeap candidateMaxHeap;
+            
+            NodeIndexType descentNode;
+            NodeIndexType searchPathDirectionNode;
+            NodeIndexType searchPathNode;
+            
+            //Subtrees left to search off the path, each with a lower bound of its squared distance to the query.
+            vector<KdTreeCandidate> branchStack;
+            
+            //Final candidates and the normalized query the re-rank compares them with.
+            vector<KdTreeCandidate> candidates;
+            vector<FeatureType> rerankFeatures;
+        };
+        
+    public:
+        
+        //Temporaries of a build: the index permutation, the split statistics, the cost model samples and the layout order.
+        //Not shared by builds running at the same time.
+        class BuildContext {
+            
+        public:
+            
+            BuildContext() {
                 
-                if (distance0 > distance1) {
-                    result = true;
-                }
+            }
+            
+        private:
+            
+            friend class KdTree;
+            
+            vector<PointIndexType> pointIndices;
+            Math::StatisticsAccumulator splitStatistics;
+            
+            vector<PointIndexType> samples;
+            vector<FeatureType> radii;
+            vector<FeatureType> sampleFeatures;
+            vector<FeatureType> sortedFeatures;
+            vector< pair<FeatureType, DimensionNumber> > spreads;
+            
+            vector<NodeIndexType> nodeOrder;
+            vector<NodeIndexType> newIndices;
+            vector<NodeIndexType> nodeStack;
+        };
+        
+        //Scratch of one query at a time: the transformed query, the candidate heap, the traversal stack and the results.
+        //Keep one per thread and pass it to every query that thread makes.
+        class QueryContext {
+            
+        public:
+            
+            QueryContext() {
                 
-                return result;
             }
             
-            void assignDistanceComparingNode(const KdTreeNode& node) {
-                this->distanceComparingNode = node;
+            inline const vector<KdTreeSearchResult>& getResults() const {
+                return this->results;
             }
             
-            inline const vector<FeatureType> featuresCompared() const {
-                return distanceComparingNode.getFeatures();
+        private:
+            
+            friend class KdTree;
+            
+            KdTreeQuery query;
+            
+            vector<FeatureType> transformedFeatures;
+            vector<FeatureType> projectedFeatures;
+            
+            vector<KdTreeSearchResult> results;
+        };
+        
+    private:
+        
+        class KdTreeCandidateDistanceLess {
+            
+        public:
+            
+            inline bool operator()(const KdTreeCandidate& lhs, const KdTreeCandidate& rhs) const {
+                return lhs.distance < rhs.distance;
             }
+        };
+        
+        //Tree nodes live in one array and refer to each other by index, every node owns exactly one point of the buffer.
+        struct TreeNode {
+            FeatureType splitFeature;
+            DimensionNumber splitFeatureIndex;
+            PointIndexType pointIndex;
+            NodeIndexType parent;
+            NodeIndexType leftChild;
+            NodeIndexType rightChild;
+        };
+        
+        //Selects point indices with one coordinate of the shared point buffer below a value.
+        class PointFeatureBelow {
             
-            inline const NodeDistanceType maxDistanceCompared() const {
-                
-                KdTreeNode topNode = this->maxData();
+        public:
+            
+            PointFeatureBelow(const PointBuffer& points, DimensionNumber dimensionIndex, FeatureType value):points(points), dimensionIndex(dimensionIndex), value(value) {
                 
-                NodeDistanceType distance = Measurement::euclideanDistance(topNode.getFeatures(), distanceComparingNode.getFeatures());
+            }
+            
+            inline bool operator()(PointIndexType pointIndex) const {
+                return this->points.getFeature(pointIndex, this->dimensionIndex) < this->value;
+            }
+            
+        private:
+            
+            const PointBuffer& points;
+            DimensionNumber dimensionIndex;
+            FeatureType value;
+        };
+        
+        //Orders point indices by one coordinate of the shared point buffer.
+        class PointFeatureLess {
+            
+        public:
+            
+            PointFeatureLess(const PointBuffer& points, DimensionNumber dimensionIndex):points(points), dimensionIndex(dimensionIndex) {
                 
-                return distance;
+            }
+            
+            inline bool operator()(PointIndexType lhs, PointIndexType rhs) const {
+                return this->points.getFeature(lhs, this->dimensionIndex) < this->points.getFeature(rhs, this->dimensionIndex);
             }
             
         private:
             
-            KdTreeNode distanceComparingNode;
+            const PointBuffer& points;
+            DimensionNumber dimensionIndex;
         };
         
-        KdTreeNode *rootNode;
+        typedef vector<TreeNode, ResourceAllocator<TreeNode> > TreeNodeVector;
+        typedef vector<NodeCategory, ResourceAllocator<NodeCategory> > CategoryVector;
+        
+        static const NodeIndexType NullNodeIndex;
+        
+        //|q - p|^2 = 2 - 2 cos of unit vectors at similarity 0.
+        static const NodeDistanceType ZeroNormCosineDistance;
+        
+        //Subtrees smaller than this are split at the max variance median by the cost model, estimates from a handful of points are noise.
+        static const size_t CostModelMinPointsNumber = 256;
+        static const size_t CostModelSamplesNumber = 64;
+        static const size_t CostModelDimensionsNumber = 3;
+        
+        //Declared first so that it is destroyed after the buffers allocated from it.
+        shared_ptr<MemoryResource> memoryResource;
+        shared_ptr<MemoryResource> exactPointsResource;
+        
+        //Points are searched after normalization and whitening or principal component rotation, sourcePoints keeps the original features and is empty when the points are not transformed.
+        PointBuffer points;
+        PointBuffer sourcePoints;
+        CategoryVector categories;
+        
+        KdTreeSearchMode searchMode;
+        KdTreeSearchMode builtSearchMode;
+        
+        //Square of the largest point norm, the inner product augmentation reaches up to it.
+        FeatureType maxSquaredNorm;
+        
+        //Cosine search only, ascending. A zero vector has no direction and scores 0 against everything.
+        vector<PointIndexType> zeroNormPoints;
+        
+        NormalizationType normalizationType;
+        FeatureNormalizer fittedNormalizer;
+        FeatureNormalizer normalizer;
+        
+        Measurement::MahalanobisMetric metric;
+        Measurement::MahalanobisMetric whiteningMetric;
+        
+        bool isRotated;
+        size_t principalComponentsNumber;
+        
+        //Rows are the kept principal components, empty when the points are not rotated.
+        vector<FeatureType> principalMeans;
+        Matrix principalAxes;
         
-        void deleteTree(KdTreeNode *treeRoot);
+        QuantizationType quantizationType;
+        size_t rerankFactor;
         
-        KdTreeNode *buildTree(vector<KdTreeNode>& nodes);
-        DimensionNumber getMaxVarianceDimensionIndex(const vector<KdTreeNode>& nodesVector);
+        KdTreeSplitRule splitRule;
         
-        inline const KdTreeNode getSplitNode(const vector<KdTreeNode>& nodesVector, DimensionNumber splitDimensionIndex) {
+        KdTreeLayout layout;
+        size_t interleavedQueriesNumber;
+        QuantizedPointBuffer quantizedPoints;
+        
+        TreeNodeVector treeNodes;
+        NodeIndexType rootNode;
+        
+        //Context of the running build, NULL otherwise.
+        BuildContext* buildContext;
+        
+        void augmentForInnerProduct();
+        void buildPrincipalComponents();
+        
+        NodeIndexType buildTree(size_t low, size_t up, NodeIndexType parent);
+        
+        //Partitions pointIndices[low, up) around the point of the new node and returns its position.
+        size_t partitionForSplit(size_t low, size_t up, DimensionNumber& splitDimensionIndex);
+        size_t partitionAtMedian(size_t low, size_t up, DimensionNumber splitDimensionIndex);
+        size_t partitionAtMidpoint(size_t low, size_t up, DimensionNumber splitDimensionIndex);
+        
+        void collectSplitStatistics(size_t low, size_t up);
+        DimensionNumber getMaxSpreadDimensionIndex() const;
+        void chooseCostModelSplit(size_t low, size_t up, DimensionNumber& splitDimensionIndex, bool& isMidpointSplit) const;
+        
+        void applyLayout(BuildContext& context);
+        size_t getTreeHeight(NodeIndexType treeRootNode) const;
+        
+        //Roots of the bottom subtrees are appended to subTreeRoots and removed again once laid out, one vector serves the whole recursion.
+        void vanEmdeBoasOrder(NodeIndexType treeRootNode, size_t height, vector<NodeIndexType>& order, vector<NodeIndexType>& subTreeRoots) const;
+        void subTreeRootsInDepth(NodeIndexType treeRootNode, size_t depth, vector<NodeIndexType>& subTreeRoots) const;
+        
+        inline const KdTreeNode getTreeNode(NodeIndexType nodeIndex) const {
+            
+            const TreeNode& treeNode = this->treeNodes[nodeIndex];
+            
+            const PointBuffer& resultPoints = this->sourcePoints.isEmpty() == true ? this->points : this->sourcePoints;
+            
+            KdTreeNode result(resultPoints.getFeatures(treeNode.pointIndex), this->categories[treeNode.pointIndex]);
+            result.setSplitFeatureIndex(treeNode.splitFeatureIndex);
             
-            assert(nodesVector.size() > 0);
-            return KdTreeNode(nodesVector.at(nodesVector.size() / 2));
+            return result;
         }
         
-        inline const vector<KdTreeNode> getLeftTree(const vector<KdTreeNode>& nodesVector, const KdTreeNode& splitNode, DimensionNumber splitDimensionIndex) {
+        //Maps a query into the space the points are searched in, transformedFeatures is only written when that space differs and projectedFeatures is scratch of the principal component projection.
+        inline const vector<FeatureType>& getSearchFeatures(const vector<FeatureType>& features, vector<FeatureType>& transformedFeatures, vector<FeatureType>& projectedFeatures) const {
             
-            vector<KdTreeNode> result;
+            const vector<FeatureType>* searchFeatures = &features;
+            
+            if (this->normalizer.getNormalizationType() != NoNormalization) {
+                
+                this->normalizer.apply(features, transformedFeatures);
+                searchFeatures = &transformedFeatures;
+            }
             
-            vector<KdTreeNode>::const_iterator iterator;
+            if (this->builtSearchMode == InnerProductSearch) {
+                
+                if (searchFeatures != &transformedFeatures) {
+                    transformedFeatures = features;
+                    searchFeatures = &transformedFeatures;
+                }
+                
+                transformedFeatures.push_back(0);
+            }
             
-            for (iterator = nodesVector.begin(); iterator != nodesVector.end(); ++iterator) {
+            if (this->whiteningMetric.isFitted() == true) {
+                
+                this->whiteningMetric.whiten(*searchFeatures, transformedFeatures);
+                searchFeatures = &transformedFeatures;
+                
+            } else if (this->principalAxes.isEmpty() == false) {
+                
+                assert(searchFeatures->size() == this->principalMeans.size());
                 
-                vector<FeatureType> features = (*iterator).getFeatures();
+                SizeType componentsNumber = this->principalAxes.getRowNumber();
+                SizeType dimensionNumber = this->principalAxes.getColumNumber();
                 
-                if (features.at(splitDimensionIndex) < splitNode.getFeatures().at(splitDimensionIndex)) {
-                    result.push_back(*iterator);
+                const ElementType* axis = this->principalAxes.getData();
+                
+                projectedFeatures.resize(componentsNumber);
+                
+                for (SizeType componentIndex = 0; componentIndex < componentsNumber; ++componentIndex, axis += dimensionNumber) {
+                    
+                    FeatureType projection = 0;
+                    
+                    for (SizeType index = 0; index < dimensionNumber; ++index) {
+                        projection += axis[index] * ((*searchFeatures)[index] - this->principalMeans[index]);
+                    }
+                    
+                    projectedFeatures[componentIndex] = projection;
                 }
+                
+                //Assigned rather than swapped, so both buffers keep the capacity they grew to.
+                transformedFeatures.assign(projectedFeatures.begin(), projectedFeatures.end());
+                searchFeatures = &transformedFeatures;
             }
             
-            return vector<KdTreeNode>(result);
+            return *searchFeatures;
+        }
+        
+        inline bool isTruncated() const {
+            return this->principalAxes.getRowNumber() < this->principalAxes.getColumNumber();
+        }
+        
+        //Traversal distances are only approximate with quantized codes or truncated principal components.
+        inline bool isRerankNeeded() const {
+            return this->quantizedPoints.getQuantizationType() != NoQuantization || this->isTruncated() == true;
         }
         
-        inline const vector<KdTreeNode> getRightTree(const vector<KdTreeNode>& nodesVector, const KdTreeNode& splitNode, DimensionNumber splitDimensionIndex) {
+        inline NodeDistanceType exactSquaredDistance(const vector<FeatureType>& features, PointIndexType pointIndex) const {
             
-            vector<KdTreeNode> result;
+            const FeatureType* point = this->points.getPoint(pointIndex);
+            size_t dimensionNumber = this->points.getDimensionNumber();
             
-            vector<KdTreeNode>::const_iterator iterator;
+            NodeDistanceType distance = 0;
             
-            for (iterator = nodesVector.begin(); iterator != nodesVector.end(); ++iterator) {
-                
-                vector<FeatureType> features = (*iterator).getFeatures();
-                
-                if (features.at(splitDimensionIndex) > splitNode.getFeatures().at(splitDimensionIndex)) {
-                    result.push_back(*iterator);
-                }
+            for (size_t index = 0; index < dimensionNumber; ++index) {
+                NodeDistanceType difference = features[index] - point[index];
+                distance += difference * difference;
             }
-            return vector<KdTreeNode>(result);
+            
+            return distance;
         }
         
-        inline const vector<FeatureType> getNodeFeatureInDimension(const vector<KdTreeNode>& nodes, DimensionNumber dimensionIndex) {
+        inline const KdTreeCandidate getCandidate(const vector<FeatureType>& features, NodeIndexType node) const {
             
-            vector<FeatureType> dimensionFeature;
+            PointIndexType pointIndex = this->treeNodes[node].pointIndex;
             
-            vector<KdTreeNode>::const_iterator iterator;
+            KdTreeCandidate candidate;
+            candidate.node = node;
             
-            for (iterator = nodes.begin(); iterator != nodes.end(); ++iterator) {
-                assert((*iterator).getFeatures().size() > dimensionIndex);
-                dimensionFeature.push_back((*iterator).getFeatures().at(dimensionIndex));
+            if (this->quantizedPoints.getQuantizationType() != NoQuantization) {
+                candidate.distance = this->quantizedPoints.squaredDistance(features, pointIndex);
+            } else {
+                candidate.distance = this->exactSquaredDistance(features, pointIndex);
+            }
+            
+            if (this->isZeroNormPoint(pointIndex) == true) {
+                candidate.distance = ZeroNormCosineDistance;
             }
             
-            return vector<FeatureType>(dimensionFeature);
+            return candidate;
         }
         
-        void qSort(vector<KdTreeNode>& nodes, DimensionNumber splitDimensionIndex);
-        void quickSort(vector<KdTreeNode>& nodes, size_t low, size_t up, DimensionNumber splitDimensionIndex);
-        size_t partition(vector<KdTreeNode>& nodes, size_t low, size_t up, DimensionNumber splitDimensionIndex);
+        inline bool isZeroNormPoint(PointIndexType pointIndex) const {
+            return this->zeroNormPoints.empty() == false && binary_search(this->zeroNormPoints.begin(), this->zeroNormPoints.end(), pointIndex) == true;
+        }
         
-        //Ignore middle same compare distance node.
-        KdTreeNode* nearestLeafNode(const vector<FeatureType>& features);
+        inline size_t getCandidatesNumber(size_t k) const {
+            
+            if (this->isRerankNeeded() == true) {
+                return k * this->rerankFactor;
+            }
+            
+            return k;
+        }
         
-        const bool isSearchNeededInBranch(const KdTreeNodeMaxHeap& nodeMaxHeap, KdTreeNode* node) const;
+        inline void prefetchTreeNode(NodeIndexType node) const {
+            
+            if (node != NullNodeIndex) {
+                KD_TREE_PREFETCH(&(this->treeNodes[node]));
+            }
+        }
         
-        const bool isFeatureNodeContained(const vector<FeatureType>& features) const;
+        //Prefetches the storage distances are computed from, the quantized codes when there are any.
+        inline void prefetchPoint(PointIndexType pointIndex) const {
+            
+            const char* address = NULL;
+            size_t size = 0;
+            
+            if (this->quantizedPoints.getQuantizationType() != NoQuantization) {
+                address = (const char*)this->quantizedPoints.getPointCodes(pointIndex);
+                size = this->quantizedPoints.getPointCodesSize();
+            } else {
+                address = (const char*)this->points.getPoint(pointIndex);
+                size = this->points.getDimensionNumber() * sizeof(FeatureType);
+            }
+            
+            for (size_t offset = 0; offset < size; offset += KD_TREE_CACHE_LINE_SIZE) {
+                KD_TREE_PREFETCH(address + offset);
+            }
+        }
+        
+        inline NodeIndexType nextDescentNode(const vector<FeatureType>& features, NodeIndexType node) const {
+            
+            const TreeNode& treeNode = this->treeNodes[node];
+            
+            NodeIndexType nearChild = treeNode.rightChild;
+            NodeIndexType farChild = treeNode.leftChild;
+            
+            if (features.at(treeNode.splitFeatureIndex) < treeNode.splitFeature) {
+                nearChild = treeNode.leftChild;
+                farChild = treeNode.rightChild;
+            }
+            
+            if (nearChild != NullNodeIndex) {
+                return nearChild;
+            }
+            
+            return farChild;
+        }
+        
+        inline void startBacktracking(KdTreeQuery& query, NodeIndexType leafNode, bool isPrefetched) const {
+            
+            query.candidateMaxHeap.addData(this->getCandidate(*(query.features), leafNode));
+            
+            query.searchPathDirectionNode = leafNode;
+            query.searchPathNode = this->treeNodes[leafNode].parent;
+            
+            if (isPrefetched == true && query.searchPathNode != NullNodeIndex) {
+                this->prefetchPoint(this->treeNodes[query.searchPathNode].pointIndex);
+            }
+        }
         
-        inline const vector<KdTreeNode> getTreeNodes(KdTreeNode* treeRootNode) const {
+        //Handles one node on the path back to the root: the node itself and, when the split plane is closer than the farthest candidate, its other branch.
+        inline void backtrackingStep(KdTreeQuery& query, bool isPrefetched) const {
+            
+            const vector<FeatureType>& features = *(query.features);
+            KdTreeCandidateMaxHeap& candidateMaxHeap = query.candidateMaxHeap;
             
-            vector<KdTreeNode> treeNodes;
+            NodeIndexType searchPathNode = query.searchPathNode;
+            
+            bool isNeedToSearchInBranch = false;
+            
+            if (candidateMaxHeap.isReachMaxNodeNumber() == false) {
+                isNeedToSearchInBranch = true;
+            } else {
+                
+                if (this->isSearchNeededInBranch(candidateMaxHeap, features, searchPathNode) == true) {
+                    isNeedToSearchInBranch = true;
+                }
+                
+            }
             
-            stack<KdTreeNode*> path;
+            if (isNeedToSearchInBranch == true) {
+                
+                const TreeNode& pathNode = this->treeNodes[searchPathNode];
+                
+                candidateMaxHeap.addData(this->getCandidate(features, searchPathNode));
+                
+                NodeIndexType branchNode = pathNode.leftChild;
+                
+                if (query.searchPathDirectionNode == pathNode.leftChild) {
+                    branchNode = pathNode.rightChild;
+                }
+                
+                if (branchNode != NullNodeIndex) {
+                    this->searchBranch(query, branchNode, isPrefetched);
+                }
+            }
             
-            KdTreeNode* node = treeRootNode;
+            query.searchPathDirectionNode = searchPathNode;
+            query.searchPathNode = this->treeNodes[searchPathNode].parent;
             
-            while (node != NULL) {
-                path.push(node);
-                node = node->getLeftChild();
+            if (isPrefetched == true && query.searchPathNode != NullNodeIndex) {
+                
+                const TreeNode& nextPathNode = this->treeNodes[query.searchPathNode];
+                
+                this->prefetchPoint(nextPathNode.pointIndex);
+                
+                if (nextPathNode.leftChild == searchPathNode) {
+                    this->prefetchTreeNode(nextPathNode.rightChild);
+                } else {
+                    this->prefetchTreeNode(nextPathNode.leftChild);
+                }
             }
+        }
+        
+        //Depth first search of a subtree off the search path. The far child of a node is skipped once its split plane is no closer than the farthest candidate.
+        inline void searchBranch(KdTreeQuery& query, NodeIndexType branchNode, bool isPrefetched) const {
+            
+            const vector<FeatureType>& features = *(query.features);
+            KdTreeCandidateMaxHeap& candidateMaxHeap = query.candidateMaxHeap;
+            vector<KdTreeCandidate>& branchStack = query.branchStack;
             
-            while (path.empty() == false) {
+            KdTreeCandidate branch;
+            branch.node = branchNode;
+            branch.distance = 0;
+            
+            branchStack.push_back(branch);
+            
+            while (branchStack.empty() == false) {
+                
+                branch = branchStack.back();
+                branchStack.pop_back();
+                
+                //The candidates may have come closer since the subtree was pushed.
+                if (candidateMaxHeap.isReachMaxNodeNumber() == true && branch.distance >= candidateMaxHeap.maxDistanceCompared()) {
+                    continue;
+                }
+                
+                const TreeNode& treeNode = this->treeNodes[branch.node];
+                
+                candidateMaxHeap.addData(this->getCandidate(features, branch.node));
+                
+                NodeDistanceType splitFeatureDistance = features[treeNode.splitFeatureIndex] - treeNode.splitFeature;
+                
+                NodeIndexType nearChild = treeNode.rightChild;
+                NodeIndexType farChild = treeNode.leftChild;
+                
+                if (splitFeatureDistance < 0) {
+                    nearChild = treeNode.leftChild;
+                    farChild = treeNode.rightChild;
+                }
+                
+                KdTreeCandidate child;
                 
-                node = path.top();
-                treeNodes.push_back(*node);
-                path.pop();
+                if (farChild != NullNodeIndex) {
+                    
+                    child.node = farChild;
+                    child.distance = max(branch.distance, splitFeatureDistance * splitFeatureDistance);
+                    
+                    if (candidateMaxHeap.isReachMaxNodeNumber() == false || child.distance < candidateMaxHeap.maxDistanceCompared()) {
+                        branchStack.push_back(child);
+                    }
+                }
                 
-                if (node->getRightChild() != NULL) {
+                //Pushed last, so the near child is searched first.
+                if (nearChild != NullNodeIndex) {
                     
-                    node = node->getRightChild();
+                    child.node = nearChild;
+                    child.distance = branch.distance;
                     
-                    while (node != NULL) {
-                        path.push(node);
-                        node = node->getLeftChild();
+                    branchStack.push_back(child);
+                    
+                    if (isPrefetched == true) {
+                        this->prefetchTreeNode(nearChild);
+                        this->prefetchPoint(this->treeNodes[nearChild].pointIndex);
                     }
                 }
             }
-            
-            return vector<KdTreeNode>(treeNodes);
         }
+        
+        //Searches the tree for one query in the buffers of the context, the final candidates end in context.query.candidates.
+        void searchNearest(const vector<FeatureType>& features, size_t k, QueryContext& context) const;
+        
+        //Moves the candidates of a finished query from its heap into query.candidates, re-ranked when needed and ordered best first.
+        void finishQuery(KdTreeQuery& query, size_t k) const;
+        
+        //The finished candidates of a query as result nodes.
+        const vector<KdTreeNode> getQueryResult(const KdTreeQuery& query) const;
+        
+        //Turns the exact squared search distance of a candidate into the score of the search mode.
+        NodeDistanceType getScore(const KdTreeQuery& query, const KdTreeCandidate& candidate) const;
+        
+        //Replaces the approximate distances of query.candidates with exact ones and keeps the k nearest.
+        void rerankCandidates(KdTreeQuery& query, size_t k) const;
+        
+        //Ignore middle same compare distance node.
+        NodeIndexType nearestLeafNode(const vector<FeatureType>& features) const;
+        
+        const bool isSearchNeededInBranch(const KdTreeCandidateMaxHeap& candidateMaxHeap, const vector<FeatureType>& features, NodeIndexType node) const;
+        
+        const bool isFeatureNodeContained(const vector<FeatureType>& features) const;
     };
 
 }
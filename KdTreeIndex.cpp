@@ -0,0 +1,267 @@
+#include "KdTreeIndex.h"
+#include <functional>
+
+namespace std {
+    
+    KdTreeIndex::KdTreeIndex():isArenaAllocated(false), arenaBlockSize(MonotonicArena::DefaultBlockSize), snapshot(NULL), epoch(0), version(0), isRebuildRunning(false) {
+        
+        for (size_t slotIndex = 0; slotIndex < ReaderSlotsNumber; ++slotIndex) {
+            this->readerSlots[slotIndex].epoch.store(InactiveEpoch);
+        }
+    }
+    
+    KdTreeIndex::KdTreeIndex(const KdTree& prototype):prototype(prototype), isArenaAllocated(false), arenaBlockSize(MonotonicArena::DefaultBlockSize), snapshot(NULL), epoch(0), version(0), isRebuildRunning(false) {
+        
+        for (size_t slotIndex = 0; slotIndex < ReaderSlotsNumber; ++slotIndex) {
+            this->readerSlots[slotIndex].epoch.store(InactiveEpoch);
+        }
+    }
+    
+    //Readers must have finished before the index is destroyed.
+    KdTreeIndex::~KdTreeIndex() {
+        
+        {
+            //The error of a rebuild nobody waited for is dropped, a destructor must not throw.
+            lock_guard<mutex> lock(this->rebuildMutex);
+            
+            if (this->rebuildThread.joinable() == true) {
+                this->rebuildThread.join();
+            }
+        }
+        
+        delete this->snapshot.exchange(NULL);
+        
+        lock_guard<mutex> lock(this->retiredTreesMutex);
+        
+        vector<RetiredTree>::iterator retiredIterator;
+        
+        for (retiredIterator = this->retiredTrees.begin(); retiredIterator != this->retiredTrees.end(); ++retiredIterator) {
+            delete (*retiredIterator).tree;
+        }
+        
+        this->retiredTrees.clear();
+    }
+    
+    void* KdTreeIndex::operator new(size_t size) {
+        return MemoryResource::getDefaultResource()->allocate(size, alignof(KdTreeIndex));
+    }
+    
+    void KdTreeIndex::operator delete(void* memory, size_t size) {
+        MemoryResource::getDefaultResource()->deallocate(memory, size, alignof(KdTreeIndex));
+    }
+    
+    void KdTreeIndex::build(const vector< vector<FeatureType> >& featuresVector, const vector<NodeCategory>& categoriesVector) {
+        this->publish(this->buildTree(featuresVector, categoriesVector));
+    }
+    
+    void KdTreeIndex::rebuildAsync(vector< vector<FeatureType> > featuresVector, vector<NodeCategory> categoriesVector) {
+        
+        lock_guard<mutex> lock(this->rebuildMutex);
+        
+        if (this->rebuildThread.joinable() == true) {
+            this->rebuildThread.join();
+        }
+        
+        this->isRebuildRunning.store(true);
+        this->rebuildThread = thread(&KdTreeIndex::rebuildTask, this, std::move(featuresVector), std::move(categoriesVector));
+    }
+    
+    void KdTreeIndex::waitForRebuild() {
+        
+        lock_guard<mutex> lock(this->rebuildMutex);
+        
+        if (this->rebuildThread.joinable() == true) {
+            this->rebuildThread.join();
+        }
+        
+        if (this->rebuildError) {
+            
+            exception_ptr error = this->rebuildError;
+            this->rebuildError = exception_ptr();
+            
+            rethrow_exception(error);
+        }
+    }
+    
+    bool KdTreeIndex::isRebuilding() const {
+        return this->isRebuildRunning.load();
+    }
+    
+    EpochType KdTreeIndex::getVersion() const {
+        return this->version.load();
+    }
+    
+    const vector<KdTreeNode> KdTreeIndex::nearestKNode(const vector<FeatureType>& features, size_t k) const {
+        
+        ReadGuard guard(*this);
+        
+        const KdTree* tree = this->snapshot.load();
+        
+        if (tree == NULL) {
+            return vector<KdTreeNode>();
+        }
+        
+        return tree->nearestKNode(features, k);
+    }
+    
+    void KdTreeIndex::nearestKNode(const vector<FeatureType>& features, size_t k, KdTree::QueryContext& context) const {
+        
+        ReadGuard guard(*this);
+        
+        const KdTree* tree = this->snapshot.load();
+        
+        //The prototype is never built, searching it only clears the results of the context.
+        if (tree == NULL) {
+            tree = &(this->prototype);
+        }
+        
+        tree->nearestKNode(features, k, context);
+    }
+    
+    const vector< vector<KdTreeNode> > KdTreeIndex::nearestKNodes(const vector< vector<FeatureType> >& featuresVector, size_t k) const {
+        
+        ReadGuard guard(*this);
+        
+        const KdTree* tree = this->snapshot.load();
+        
+        if (tree == NULL) {
+            return vector< vector<KdTreeNode> >(featuresVector.size());
+        }
+        
+        return tree->nearestKNodes(featuresVector, k);
+    }
+    
+    void KdTreeIndex::reclaimRetiredTrees() {
+        
+        lock_guard<mutex> lock(this->retiredTreesMutex);
+        
+        EpochType oldestReaderEpoch = InactiveEpoch;
+        
+        for (size_t slotIndex = 0; slotIndex < ReaderSlotsNumber; ++slotIndex) {
+            oldestReaderEpoch = min(oldestReaderEpoch, this->readerSlots[slotIndex].epoch.load());
+        }
+        
+        vector<RetiredTree> stillVisibleTrees;
+        
+        vector<RetiredTree>::iterator retiredIterator;
+        
+        for (retiredIterator = this->retiredTrees.begin(); retiredIterator != this->retiredTrees.end(); ++retiredIterator) {
+            
+            //A reader that entered in the retire epoch or before may still hold the tree.
+            if (oldestReaderEpoch == InactiveEpoch || oldestReaderEpoch > (*retiredIterator).epoch) {
+                delete (*retiredIterator).tree;
+            } else {
+                stillVisibleTrees.push_back(*retiredIterator);
+            }
+        }
+        
+        this->retiredTrees.swap(stillVisibleTrees);
+    }
+    
+    size_t KdTreeIndex::getRetiredTreesNumber() const {
+        
+        lock_guard<mutex> lock(this->retiredTreesMutex);
+        
+        return this->retiredTrees.size();
+    }
+    
+    void KdTreeIndex::setArenaAllocation(bool isArenaAllocated, size_t arenaBlockSize) {
+        
+        this->isArenaAllocated = isArenaAllocated;
+        this->arenaBlockSize = arenaBlockSize;
+    }
+    
+    void KdTreeIndex::setFittedNormalizer(const FeatureNormalizer& normalizer) {
+        this->prototype.setFittedNormalizer(normalizer);
+    }
+    
+    KdTree* KdTreeIndex::buildTree(const vector< vector<FeatureType> >& featuresVector, const vector<NodeCategory>& categoriesVector) const {
+        
+        KdTree* tree = new KdTree(this->prototype);
+        
+        if (this->isArenaAllocated == true) {
+            tree->setMemoryResource(shared_ptr<MemoryResource>(new MonotonicArena(this->arenaBlockSize)));
+        }
+        
+        lock_guard<mutex> lock(this->buildContextMutex);
+        
+        try {
+            tree->build(featuresVector, categoriesVector, this->buildContext);
+        } catch (...) {
+            delete tree;
+            throw;
+        }
+        
+        return tree;
+    }
+    
+    void KdTreeIndex::rebuildTask(vector< vector<FeatureType> > featuresVector, vector<NodeCategory> categoriesVector) {
+        
+        //An exception escaping the thread would terminate the process.
+        try {
+            this->publish(this->buildTree(featuresVector, categoriesVector));
+        } catch (...) {
+            this->rebuildError = current_exception();
+        }
+        
+        this->isRebuildRunning.store(false);
+    }
+    
+    void KdTreeIndex::publish(const KdTree* tree) {
+        
+        {
+            lock_guard<mutex> lock(this->retiredTreesMutex);
+            
+            const KdTree* oldTree = this->snapshot.exchange(tree);
+            
+            if (oldTree != NULL) {
+                
+                RetiredTree retiredTree;
+                retiredTree.tree = oldTree;
+                retiredTree.epoch = this->epoch.load();
+                
+                this->retiredTrees.push_back(retiredTree);
+            }
+            
+            this->epoch.fetch_add(1);
+            this->version.fetch_add(1);
+        }
+        
+        this->reclaimRetiredTrees();
+    }
+    
+    //Claims a free slot with the current epoch, the snapshot must be loaded only after the claim.
+    size_t KdTreeIndex::acquireReaderSlot() const {
+        
+        size_t slotIndex = hash<thread::id>()(this_thread::get_id()) % ReaderSlotsNumber;
+        
+        while (true) {
+            
+            for (size_t attempt = 0; attempt < ReaderSlotsNumber; ++attempt) {
+                
+                EpochType inactiveEpoch = InactiveEpoch;
+                
+                if (this->readerSlots[slotIndex].epoch.compare_exchange_strong(inactiveEpoch, this->epoch.load()) == true) {
+                    return slotIndex;
+                }
+                
+                slotIndex = (slotIndex + 1) % ReaderSlotsNumber;
+            }
+            
+            //More concurrent readers than slots, wait for one to leave.
+            this_thread::yield();
+        }
+    }
+    
+    void KdTreeIndex::releaseReaderSlot(size_t slotIndex) const {
+        this->readerSlots[slotIndex].epoch.store(InactiveEpoch);
+    }
+    
+    KdTreeIndex::ReadGuard::ReadGuard(const KdTreeIndex& index):index(index), slotIndex(index.acquireReaderSlot()) {
+    
+    }
+    
+    KdTreeIndex::ReadGuard::~ReadGuard() {
+        this->index.releaseReaderSlot(this->slotIndex);
+    }
+}
\ No newline at end of file
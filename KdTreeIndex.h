@@ -0,0 +1,136 @@
+#ifndef __KD_TREE_INDEX_H__
+#define __KD_TREE_INDEX_H__
+
+#include <vector>
+#include <atomic>
+#include <mutex>
+#include <thread>
+#include <exception>
+#include "KdTree.h"
+
+namespace std {
+    
+    using namespace std;
+    
+    typedef unsigned long long EpochType;
+    
+    //Serves queries from an immutable KdTree snapshot while new snapshots are built in the background.
+    //Readers never block: they announce the epoch they entered in a reader slot and load the current snapshot.
+    //Replaced snapshots are retired with the epoch of the swap and deleted once no reader slot holds that epoch or an older one.
+    class KdTreeIndex {
+        
+    public:
+        
+        KdTreeIndex();
+        
+        //Options of the prototype (quantization, layout, ...) are copied into every tree this index builds.
+        KdTreeIndex(const KdTree& prototype);
+        
+        ~KdTreeIndex();
+        
+        //New only guarantees the alignment of max_align_t before C++17, the reader slots need whole cache lines.
+        static void* operator new(size_t size);
+        static void operator delete(void* memory, size_t size);
+        
+        //Builds on the calling thread and publishes the new snapshot.
+        void build(const vector< vector<FeatureType> >& featuresVector, const vector<NodeCategory>& categoriesVector);
+        
+        //Builds on a background thread, queries keep using the current snapshot until the new one is swapped in.
+        //A rebuild requested while another one is running waits for the running one first.
+        void rebuildAsync(vector< vector<FeatureType> > featuresVector, vector<NodeCategory> categoriesVector);
+        
+        //Rethrows the error of the last failed rebuild, once. A failed rebuild publishes nothing, queries keep the previous snapshot.
+        void waitForRebuild();
+        bool isRebuilding() const;
+        
+        //Counts published snapshots, 0 before the first build.
+        EpochType getVersion() const;
+        
+        const vector<KdTreeNode> nearestKNode(const vector<FeatureType>& features, size_t k) const;
+        
+        //Allocation free search with a per thread context. The snapshot may be retired once the call returns, so use the categories and scores of the results rather than KdTree::getResultFeatures.
+        void nearestKNode(const vector<FeatureType>& features, size_t k, KdTree::QueryContext& context) const;
+        
+        const vector< vector<KdTreeNode> > nearestKNodes(const vector< vector<FeatureType> >& featuresVector, size_t k) const;
+        
+        //Deletes retired snapshots no reader can still see, also done after every publish.
+        void reclaimRetiredTrees();
+        
+        size_t getRetiredTreesNumber() const;
+        
+        //Every tree built afterwards gets its own arena of blocks of arenaBlockSize bytes, retiring a snapshot then frees whole blocks.
+        void setArenaAllocation(bool isArenaAllocated, size_t arenaBlockSize = MonotonicArena::DefaultBlockSize);
+        
+        //Every tree built afterwards applies the normalizer instead of fitting its own, see KdTree::setFittedNormalizer.
+        void setFittedNormalizer(const FeatureNormalizer& normalizer);
+        
+    private:
+        
+        KdTreeIndex(const KdTreeIndex& rhs);
+        KdTreeIndex& operator=(const KdTreeIndex& rhs);
+        
+        static const size_t ReaderSlotsNumber = 64;
+        static const EpochType InactiveEpoch = ~0ULL;
+        
+        //Padded to a cache line so that readers on different slots do not share lines.
+        struct alignas(64) ReaderSlot {
+            atomic<EpochType> epoch;
+        };
+        
+        //Holds a reader slot for the lifetime of one query.
+        class ReadGuard {
+            
+        public:
+            
+            ReadGuard(const KdTreeIndex& index);
+            ~ReadGuard();
+            
+        private:
+            
+            ReadGuard(const ReadGuard& rhs);
+            ReadGuard& operator=(const ReadGuard& rhs);
+            
+            const KdTreeIndex& index;
+            size_t slotIndex;
+        };
+        
+        struct RetiredTree {
+            const KdTree* tree;
+            EpochType epoch;
+        };
+        
+        KdTree prototype;
+        
+        bool isArenaAllocated;
+        size_t arenaBlockSize;
+        
+        //Build temporaries kept between rebuilds, one build at a time uses them.
+        mutable mutex buildContextMutex;
+        mutable KdTree::BuildContext buildContext;
+        
+        atomic<const KdTree*> snapshot;
+        atomic<EpochType> epoch;
+        atomic<EpochType> version;
+        
+        mutable ReaderSlot readerSlots[ReaderSlotsNumber];
+        
+        mutable mutex retiredTreesMutex;
+        vector<RetiredTree> retiredTrees;
+        
+        mutable mutex rebuildMutex;
+        thread rebuildThread;
+        atomic<bool> isRebuildRunning;
+        
+        //Written by the rebuild thread, read after joining it.
+        exception_ptr rebuildError;
+        
+        KdTree* buildTree(const vector< vector<FeatureType> >& featuresVector, const vector<NodeCategory>& categoriesVector) const;
+        void rebuildTask(vector< vector<FeatureType> > featuresVector, vector<NodeCategory> categoriesVector);
+        void publish(const KdTree* tree);
+        
+        size_t acquireReaderSlot() const;
+        void releaseReaderSlot(size_t slotIndex) const;
+    };
+}
+
+#endif
\ No newline at end of file
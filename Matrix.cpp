@@ -1,13 +1,24 @@
 #include "Matrix.h"
 #include <iostream>
+#include <algorithm>
+#include <thread>
+#include <functional>
+#include <cmath>
+#include <limits>
+
+#if defined(__AVX__)
+#include <immintrin.h>
+#endif
 
 namespace std {
     
-    Matrix::Matrix() {
+    size_t Matrix::multiplicationThreadsNumber = 0;
+    
+    Matrix::Matrix():rowNumber(0), columNumber(0) {
         
     }
     
-    Matrix::Matrix(const Matrix& rhs):data(rhs.data) {
+    Matrix::Matrix(const Matrix& rhs):data(rhs.data), rowNumber(rhs.rowNumber), columNumber(rhs.columNumber) {
         
     }
     
@@ -17,21 +28,32 @@ namespace std {
         return *this;
     }
     
+    Matrix::Matrix(Matrix&& rhs) noexcept:data(std::move(rhs.data)), rowNumber(rhs.rowNumber), columNumber(rhs.columNumber) {
+        rhs.rowNumber = 0;
+        rhs.columNumber = 0;
+    }
+    
+    Matrix& Matrix::operator=(Matrix&& rhs) noexcept {
+        this->swap(rhs);
+        return *this;
+    }
+    
     void Matrix::swap(Matrix& other) {
         using std::swap;
         swap(this->data, other.data);
+        swap(this->rowNumber, other.rowNumber);
+        swap(this->columNumber, other.columNumber);
     }
     
-    Matrix::Matrix(SizeType rowNumber, SizeType columNumber) {
+    Matrix::Matrix(SizeType rowNumber, SizeType columNumber):rowNumber(0), columNumber(0) {
         
         if (rowNumber == 0 || columNumber == 0) {
             return;
         }
         
-        for (size_t index = 0; index < rowNumber; ++index) {
-            vector<ElementType> row(columNumber);
-            this->data.push_back(row);
-        }
+        this->data.assign(rowNumber * columNumber, 0);
+        this->rowNumber = rowNumber;
+        this->columNumber = columNumber;
     }
     
     Matrix::~Matrix() {
@@ -42,38 +64,54 @@ namespace std {
         
         if (this->getRowNumber() == 0) {
             
-            this->data.push_back(rowData);
+            this->columNumber = rowData.size();
             
         } else {
             
             assert(rowData.size() == this->getColumNumber());
-            this->data.push_back(rowData);
         }
+        
+        this->data.insert(this->data.end(), rowData.begin(), rowData.end());
+        ++this->rowNumber;
     }
     
     void Matrix::deleteRow(SizeType rowIndex) {
         
         assert(this->getRowNumber() > rowIndex);
         
-        vector< vector<ElementType> >::iterator deleteIterator = this->data.begin() + rowIndex;
+        this->data.erase(this->data.begin() + rowIndex * this->columNumber, this->data.begin() + (rowIndex + 1) * this->columNumber);
+        --this->rowNumber;
         
-        this->data.erase(deleteIterator);
+        if (this->rowNumber == 0) {
+            this->columNumber = 0;
+        }
     }
     
     void Matrix::addColum(const vector<ElementType>& columData) {
         
         if (this->getRowNumber() == 0) {
-            for (size_t index = 0; index < columData.size(); ++index) {
-                vector<ElementType> row(1, columData.at(index));
-                this->data.push_back(row);
-            }
+            
+            this->data.assign(columData.begin(), columData.end());
+            this->rowNumber = columData.size();
+            this->columNumber = 1;
+            
         } else {
             
             assert(columData.size() == this->getRowNumber());
             
-            for (size_t index = 0; index < columData.size(); ++index) {
-                this->data.at(index).push_back(columData.at(index));
+            vector<ElementType, AlignedAllocator<ElementType> > newData(this->rowNumber * (this->columNumber + 1));
+            
+            for (size_t index = 0; index < this->rowNumber; ++index) {
+                
+                const ElementType* row = this->rowData(index);
+                ElementType* newRow = newData.data() + index * (this->columNumber + 1);
+                
+                copy(row, row + this->columNumber, newRow);
+                newRow[this->columNumber] = columData.at(index);
             }
+            
+            this->data.swap(newData);
+            ++this->columNumber;
         }
     }
     
@@ -82,14 +120,25 @@ namespace std {
         assert(this->getColumNumber() > columIndex);
         
         if (this->getColumNumber() == 1 && columIndex == 0) {
+            
             this->data.clear();
+            this->rowNumber = 0;
+            this->columNumber = 0;
+            
         } else {
-        
-            for (size_t index = 0; index < this->getRowNumber(); ++index) {
-                vector<ElementType>& row = this->data.at(index);
-                vector<ElementType>::iterator deleteIterator = row.begin() + columIndex;
-                row.erase(deleteIterator);
+            
+            size_t position = 0;
+            
+            for (size_t index = 0; index < this->data.size(); ++index) {
+                
+                if (index % this->columNumber != columIndex) {
+                    this->data[position] = this->data[index];
+                    ++position;
+                }
             }
+            
+            this->data.resize(position);
+            --this->columNumber;
         }
     }
     
@@ -115,18 +164,19 @@ namespace std {
         
         assert(this->getRowNumber() > rowIndex0 && this->getRowNumber() > rowIndex1);
         
-        using std::swap;
-        swap(this->data.at(rowIndex0), this->data.at(rowIndex1));
+        if (rowIndex0 != rowIndex1) {
+            swap_ranges(this->rowData(rowIndex0), this->rowData(rowIndex0) + this->columNumber, this->rowData(rowIndex1));
+        }
     }
     
     void Matrix::multipleRow(MultipleNumberType multipleNumber, SizeType rowIndex) {
         
         assert(this->getRowNumber() > rowIndex);
         
-        vector<ElementType>& row = this->data.at(rowIndex);
+        ElementType* row = this->rowData(rowIndex);
         
-        for (size_t index = 0; index < row.size(); ++index) {
-            row.at(index) *= multipleNumber;
+        for (size_t index = 0; index < this->columNumber; ++index) {
+            row[index] *= multipleNumber;
         }
     }
     
@@ -134,11 +184,11 @@ namespace std {
         
         assert(this->getRowNumber() > rowIndex0 && this->getRowNumber() > rowIndex1);
         
-        const vector<ElementType>& row0 = this->data.at(rowIndex0);
-        vector<ElementType>& row1 = this->data.at(rowIndex1);
+        const ElementType* row0 = this->rowData(rowIndex0);
+        ElementType* row1 = this->rowData(rowIndex1);
         
-        for (size_t index = 0; index < row0.size(); ++index) {
-            row1.at(index) += row0.at(index) * multipleNumber;
+        for (size_t index = 0; index < this->columNumber; ++index) {
+            row1[index] += row0[index] * multipleNumber;
         }
     }
     
@@ -149,9 +199,7 @@ namespace std {
         using std::swap;
         
         for (size_t index = 0; index < this->getRowNumber(); ++index) {
-            
-            vector<ElementType>& row = this->data.at(index);
-            swap(row.at(columIndex0), row.at(columIndex1));
+            swap(this->element(index, columIndex0), this->element(index, columIndex1));
         }
     }
     
@@ -160,9 +208,7 @@ namespace std {
         assert(this->getColumNumber() > columIndex);
         
         for (size_t index = 0; index < this->getRowNumber(); ++index) {
-            
-            vector<ElementType>& row = this->data.at(index);
-            row.at(columIndex) *= multipleNumber;
+            this->element(index, columIndex) *= multipleNumber;
         }
     }
     
@@ -171,95 +217,771 @@ namespace std {
         assert(this->getColumNumber() > columIndex0 && this->getColumNumber() > columIndex1);
         
         for (size_t index = 0; index < this->getRowNumber(); ++index) {
+            this->element(index, columIndex1) += this->element(index, columIndex0) * multipleNumber;
+        }
+        
+    }
+    
+    Matrix Matrix::inverseOfSquareMatrix() const {
+        
+        assert(this->isEmpty() == false);
+        assert(this->isSquareMatrix() == true);
+        
+        LUDecomposition decomposition(*this);
+        
+        //Matrix is singular matrix because its rank isn't equals its order.
+        if (decomposition.isNonSingular() == false) {
+            return Matrix::emptyMatrix();
+        }
+        
+        return decomposition.inverse();
+    }
+    
+    RankValueType Matrix::getRank() const {
+        
+        if (this->isEmpty() == true) {
+            return 0;
+        }
+        
+        return LUDecomposition(*this).getRank();
+    }
+    
+    ElementType Matrix::getDeterminant() const {
+        
+        assert(this->isEmpty() == false);
+        assert(this->isSquareMatrix() == true);
+        
+        return LUDecomposition(*this).getDeterminant();
+    }
+    
+    TraceValueType Matrix::getTrace() const {
+        
+        assert(this->isSquareMatrix() == true);
+        
+        TraceValueType trace = 0;
+        
+        for (size_t rowIndex = 0; rowIndex < this->getRowNumber(); ++rowIndex) {
+            trace += this->element(rowIndex, rowIndex);
+        }
+        
+        return trace;
+    }
+    
+    //Block sizes keep a KC x NC panel of rhs in L2 and one MC x KC panel of lhs in L1 while it is reused.
+    static const SizeType MultiplicationRowBlockSize = 64;
+    static const SizeType MultiplicationInnerBlockSize = 256;
+    static const SizeType MultiplicationColumBlockSize = 512;
+    
+    //Products with fewer multiply-adds than this are not worth starting threads for.
+    static const double ParallelMultiplicationThreshold = 4.0 * 1024 * 1024;
+    
+    //result[0, size) += multipleNumber * row[0, size), the loop the whole kernel reduces to.
+    static inline void multiplyAddRow(ElementType multipleNumber, const ElementType* __restrict row, ElementType* __restrict result, SizeType size) {
+        
+        SizeType index = 0;
+        
+#if defined(__AVX__)
+        __m256d multiple = _mm256_set1_pd(multipleNumber);
+        
+        for (; index + 8 <= size; index += 8) {
+            
+            __m256d row0 = _mm256_loadu_pd(row + index);
+            __m256d row1 = _mm256_loadu_pd(row + index + 4);
+            __m256d result0 = _mm256_loadu_pd(result + index);
+            __m256d result1 = _mm256_loadu_pd(result + index + 4);
             
-            vector<ElementType>& row = this->data.at(index);
+#if defined(__FMA__)
+            result0 = _mm256_fmadd_pd(multiple, row0, result0);
+            result1 = _mm256_fmadd_pd(multiple, row1, result1);
+#else
+            result0 = _mm256_add_pd(result0, _mm256_mul_pd(multiple, row0));
+            result1 = _mm256_add_pd(result1, _mm256_mul_pd(multiple, row1));
+#endif
             
-            row.at(columIndex1) += row.at(columIndex0) * multipleNumber;
+            _mm256_storeu_pd(result + index, result0);
+            _mm256_storeu_pd(result + index + 4, result1);
         }
+#endif
         
+        for (; index < size; ++index) {
+            result[index] += multipleNumber * row[index];
+        }
     }
     
-    SizeType Matrix::firstRowContainsNonZeroElementColumUpRow(SizeType columIndex, SizeType upRowIndex) {
+    void Matrix::multiplyRows(const Matrix& lhs, const Matrix& rhs, Matrix& result, SizeType rowBegin, SizeType rowEnd) {
         
-        assert(this->getColumNumber() > columIndex);
-        assert(this->getRowNumber() > upRowIndex);
+        SizeType innerNumber = lhs.getColumNumber();
+        SizeType columNumber = rhs.getColumNumber();
         
-        SizeType firstRowIndex = this->getRowNumber();
+        for (SizeType rowIndex = rowBegin; rowIndex < rowEnd; ++rowIndex) {
+            fill(result.rowData(rowIndex), result.rowData(rowIndex) + columNumber, 0);
+        }
         
-        for (size_t rowIndex = upRowIndex; rowIndex < this->getRowNumber(); ++rowIndex) {
+        for (SizeType columBlock = 0; columBlock < columNumber; columBlock += MultiplicationColumBlockSize) {
             
-            if (this->data.at(rowIndex).at(columIndex) != 0) {
-                firstRowIndex = rowIndex;
-                break;
+            SizeType columBlockSize = min(MultiplicationColumBlockSize, columNumber - columBlock);
+            
+            for (SizeType innerBlock = 0; innerBlock < innerNumber; innerBlock += MultiplicationInnerBlockSize) {
+                
+                SizeType innerEnd = min(innerBlock + MultiplicationInnerBlockSize, innerNumber);
+                
+                for (SizeType rowBlock = rowBegin; rowBlock < rowEnd; rowBlock += MultiplicationRowBlockSize) {
+                    
+                    SizeType rowBlockEnd = min(rowBlock + MultiplicationRowBlockSize, rowEnd);
+                    
+                    for (SizeType rowIndex = rowBlock; rowIndex < rowBlockEnd; ++rowIndex) {
+                        
+                        const ElementType* lhsRow = lhs.rowData(rowIndex);
+                        ElementType* resultRow = result.rowData(rowIndex) + columBlock;
+                        
+                        for (SizeType innerIndex = innerBlock; innerIndex < innerEnd; ++innerIndex) {
+                            
+                            ElementType multipleNumber = lhsRow[innerIndex];
+                            
+                            if (multipleNumber != 0) {
+                                multiplyAddRow(multipleNumber, rhs.rowData(innerIndex) + columBlock, resultRow, columBlockSize);
+                            }
+                        }
+                    }
+                }
             }
         }
+    }
+    
+    void Matrix::multiply(const Matrix& lhs, const Matrix& rhs, Matrix& result) {
+        
+        assert(lhs.getColumNumber() == rhs.getRowNumber());
+        assert(result.getRowNumber() == lhs.getRowNumber() && result.getColumNumber() == rhs.getColumNumber());
+        assert(&result != &lhs && &result != &rhs);
+        
+        SizeType rowNumber = lhs.getRowNumber();
+        
+        double multiplyAddsNumber = (double)rowNumber * lhs.getColumNumber() * rhs.getColumNumber();
+        
+        size_t threadsNumber = Matrix::getMultiplicationThreadsNumber();
+        
+        if (multiplyAddsNumber < ParallelMultiplicationThreshold) {
+            threadsNumber = 1;
+        }
+        
+        threadsNumber = min(threadsNumber, (size_t)((rowNumber + MultiplicationRowBlockSize - 1) / MultiplicationRowBlockSize));
+        
+        if (threadsNumber <= 1) {
+            Matrix::multiplyRows(lhs, rhs, result, 0, rowNumber);
+            return;
+        }
+        
+        //Every thread owns whole row blocks of the result, so no two threads write the same cache line.
+        SizeType rowBlocksNumber = (rowNumber + MultiplicationRowBlockSize - 1) / MultiplicationRowBlockSize;
+        
+        vector<thread> threads;
+        
+        for (size_t threadIndex = 0; threadIndex < threadsNumber; ++threadIndex) {
+            
+            SizeType rowBegin = min(rowNumber, rowBlocksNumber * threadIndex / threadsNumber * MultiplicationRowBlockSize);
+            SizeType rowEnd = min(rowNumber, rowBlocksNumber * (threadIndex + 1) / threadsNumber * MultiplicationRowBlockSize);
+            
+            threads.push_back(thread(&Matrix::multiplyRows, cref(lhs), cref(rhs), ref(result), rowBegin, rowEnd));
+        }
+        
+        vector<thread>::iterator threadIterator;
+        
+        for (threadIterator = threads.begin(); threadIterator != threads.end(); ++threadIterator) {
+            (*threadIterator).join();
+        }
+    }
+    
+    void Matrix::setMultiplicationThreadsNumber(size_t threadsNumber) {
+        Matrix::multiplicationThreadsNumber = threadsNumber;
+    }
+    
+    size_t Matrix::getMultiplicationThreadsNumber() {
+        
+        if (Matrix::multiplicationThreadsNumber == 0) {
+            return max(1U, thread::hardware_concurrency());
+        }
+        
+        return Matrix::multiplicationThreadsNumber;
+    }
+    
+    Matrix Matrix::covariance(const vector< vector<ElementType> >& samples, vector<ElementType>& means) {
+        
+        assert(samples.size() > 1);
+        
+        SizeType sampleNumber = samples.size();
+        SizeType dimensionNumber = samples.at(0).size();
+        
+        means.assign(dimensionNumber, 0);
+        
+        vector< vector<ElementType> >::const_iterator sampleIterator;
+        
+        for (sampleIterator = samples.begin(); sampleIterator != samples.end(); ++sampleIterator) {
+            
+            assert((*sampleIterator).size() == dimensionNumber);
+            
+            for (SizeType index = 0; index < dimensionNumber; ++index) {
+                means[index] += (*sampleIterator)[index];
+            }
+        }
+        
+        for (SizeType index = 0; index < dimensionNumber; ++index) {
+            means[index] /= sampleNumber;
+        }
+        
+        Matrix centered(sampleNumber, dimensionNumber);
+        
+        for (SizeType sampleIndex = 0; sampleIndex < sampleNumber; ++sampleIndex) {
+            
+            const vector<ElementType>& sample = samples[sampleIndex];
+            ElementType* row = centered.rowData(sampleIndex);
+            
+            for (SizeType index = 0; index < dimensionNumber; ++index) {
+                row[index] = sample[index] - means[index];
+            }
+        }
+        
+        //X^T * X over the centered samples is one blocked multiplication.
+        Matrix result = centered.transposeMatrix() * centered;
+        result *= 1.0 / (sampleNumber - 1);
+        
+        return result;
+    }
+    
+    LUDecomposition::LUDecomposition():rank(0), permutationSign(1) {
+        
+    }
+    
+    LUDecomposition::LUDecomposition(const Matrix& matrix):rank(0), permutationSign(1) {
+        this->decompose(matrix);
+    }
+    
+    LUDecomposition::LUDecomposition(const LUDecomposition& rhs):lu(rhs.lu), rowPermutation(rhs.rowPermutation), rank(rhs.rank), permutationSign(rhs.permutationSign) {
+        
+    }
+    
+    LUDecomposition& LUDecomposition::operator=(const LUDecomposition& rhs) {
+        LUDecomposition temp(rhs);
+        this->swap(temp);
+        return *this;
+    }
+    
+    LUDecomposition::~LUDecomposition() {
         
-        return firstRowIndex;
     }
     
-    SizeType Matrix::firstColumNonZeroElementUpRow(SizeType upRowIndex) {
+    void LUDecomposition::swap(LUDecomposition& other) {
+        using std::swap;
+        swap(this->lu, other.lu);
+        swap(this->rowPermutation, other.rowPermutation);
+        swap(this->rank, other.rank);
+        swap(this->permutationSign, other.permutationSign);
+    }
+    
+    void LUDecomposition::decompose(const Matrix& matrix) {
+        
+        assert(matrix.isEmpty() == false);
+        
+        this->lu = matrix;
+        this->rank = 0;
+        this->permutationSign = 1;
+        
+        SizeType rowNumber = matrix.getRowNumber();
+        SizeType columNumber = matrix.getColumNumber();
+        
+        this->rowPermutation.resize(rowNumber);
+        
+        for (SizeType rowIndex = 0; rowIndex < rowNumber; ++rowIndex) {
+            this->rowPermutation[rowIndex] = rowIndex;
+        }
+        
+        ElementType maxMagnitude = 0;
+        
+        for (SizeType index = 0; index < rowNumber * columNumber; ++index) {
+            maxMagnitude = max(maxMagnitude, fabs(matrix.data[index]));
+        }
         
-        assert(this->getRowNumber() > upRowIndex);
+        //Pivots this small relative to the matrix are rounding noise of an exact zero.
+        ElementType tolerance = numeric_limits<ElementType>::epsilon() * max(rowNumber, columNumber) * maxMagnitude;
         
-        SizeType firstColumIndex = this->getColumNumber();
+        SizeType pivotRowIndex = 0;
         
-        for (size_t rowIndex = upRowIndex; rowIndex < this->getRowNumber(); ++rowIndex) {
+        for (SizeType columIndex = 0; columIndex < columNumber && pivotRowIndex < rowNumber; ++columIndex) {
+            
+            SizeType maxRowIndex = pivotRowIndex;
+            
+            for (SizeType rowIndex = pivotRowIndex + 1; rowIndex < rowNumber; ++rowIndex) {
+                
+                if (fabs(this->lu.element(rowIndex, columIndex)) > fabs(this->lu.element(maxRowIndex, columIndex))) {
+                    maxRowIndex = rowIndex;
+                }
+            }
+            
+            if (fabs(this->lu.element(maxRowIndex, columIndex)) <= tolerance) {
+                continue;
+            }
+            
+            if (maxRowIndex != pivotRowIndex) {
+                
+                using std::swap;
+                
+                this->lu.switchTwoRow(maxRowIndex, pivotRowIndex);
+                swap(this->rowPermutation[maxRowIndex], this->rowPermutation[pivotRowIndex]);
+                
+                this->permutationSign = -this->permutationSign;
+            }
             
-            vector<ElementType>& row = this->data.at(rowIndex);
+            const ElementType* pivotRow = this->lu.rowData(pivotRowIndex);
+            ElementType pivot = pivotRow[columIndex];
             
-            for (size_t columIndex = 0; columIndex < row.size(); ++columIndex) {
+            for (SizeType rowIndex = pivotRowIndex + 1; rowIndex < rowNumber; ++rowIndex) {
+                
+                ElementType* row = this->lu.rowData(rowIndex);
+                
+                ElementType multipleNumber = row[columIndex] / pivot;
+                row[columIndex] = multipleNumber;
                 
-                if (row.at(columIndex) != 0 && firstColumIndex > columIndex) {
-                    firstColumIndex = columIndex;
-                    break;
+                if (multipleNumber != 0) {
+                    
+                    for (SizeType index = columIndex + 1; index < columNumber; ++index) {
+                        row[index] -= multipleNumber * pivotRow[index];
+                    }
                 }
             }
+            
+            ++pivotRowIndex;
         }
         
-        return firstColumIndex;
+        this->rank = pivotRowIndex;
+    }
+    
+    bool LUDecomposition::isNonSingular() const {
+        return this->lu.isEmpty() == false && this->lu.isSquareMatrix() == true && this->rank == this->lu.getRowNumber();
     }
     
-    RankValueType Matrix::getRank() {
+    RankValueType LUDecomposition::getRank() const {
+        return this->rank;
+    }
+    
+    ElementType LUDecomposition::getDeterminant() const {
+        
+        assert(this->lu.isSquareMatrix() == true);
         
-        Matrix matrixCopy(*this);
+        if (this->isNonSingular() == false) {
+            return 0;
+        }
+        
+        ElementType determinant = this->permutationSign;
         
-        RankValueType rank = 0;
+        for (SizeType index = 0; index < this->lu.getRowNumber(); ++index) {
+            determinant *= this->lu.element(index, index);
+        }
         
-        for (size_t rowIndex = 0; rowIndex < matrixCopy.getRowNumber(); ++rowIndex) {
+        return determinant;
+    }
+    
+    void LUDecomposition::solve(const ElementType* b, ElementType* x) const {
+        
+        assert(this->isNonSingular() == true);
+        
+        SizeType order = this->lu.getRowNumber();
+        
+        if (b == x) {
             
-            SizeType firstColumNonZero = matrixCopy.firstColumNonZeroElementUpRow(rowIndex);
+            vector<ElementType> permuted(b, b + order);
             
-            //Not found non-zero element up row index.
-            if (firstColumNonZero == matrixCopy.getColumNumber()) {
-                break;
+            for (SizeType index = 0; index < order; ++index) {
+                x[index] = permuted[this->rowPermutation[index]];
             }
             
-            ++rank;
+        } else {
             
-            SizeType firstRowNonZeroInColum = matrixCopy.firstRowContainsNonZeroElementColumUpRow(firstColumNonZero, rowIndex);
-
-            matrixCopy.switchTwoRow(rowIndex, firstRowNonZeroInColum);
+            for (SizeType index = 0; index < order; ++index) {
+                x[index] = b[this->rowPermutation[index]];
+            }
+        }
+        
+        for (SizeType rowIndex = 0; rowIndex < order; ++rowIndex) {
             
-            for (size_t eliminationIndex = rowIndex + 1; eliminationIndex < matrixCopy.getRowNumber(); ++eliminationIndex) {
+            const ElementType* row = this->lu.rowData(rowIndex);
+            
+            ElementType value = x[rowIndex];
+            
+            for (SizeType index = 0; index < rowIndex; ++index) {
+                value -= row[index] * x[index];
+            }
+            
+            x[rowIndex] = value;
+        }
+        
+        for (SizeType rowIndex = order; rowIndex > 0; --rowIndex) {
+            
+            const ElementType* row = this->lu.rowData(rowIndex - 1);
+            
+            ElementType value = x[rowIndex - 1];
+            
+            for (SizeType index = rowIndex; index < order; ++index) {
+                value -= row[index] * x[index];
+            }
+            
+            x[rowIndex - 1] = value / row[rowIndex - 1];
+        }
+    }
+    
+    void LUDecomposition::solve(const vector<ElementType>& b, vector<ElementType>& x) const {
+        
+        assert(b.size() == this->lu.getRowNumber());
+        
+        x.resize(b.size());
+        
+        this->solve(b.data(), x.data());
+    }
+    
+    Matrix LUDecomposition::solve(const Matrix& b) const {
+        
+        assert(b.getRowNumber() == this->lu.getRowNumber());
+        
+        Matrix result(b.getRowNumber(), b.getColumNumber());
+        
+        vector<ElementType> colum(b.getRowNumber());
+        
+        for (SizeType columIndex = 0; columIndex < b.getColumNumber(); ++columIndex) {
+            
+            for (SizeType rowIndex = 0; rowIndex < b.getRowNumber(); ++rowIndex) {
+                colum[rowIndex] = b.element(rowIndex, columIndex);
+            }
+            
+            this->solve(colum.data(), colum.data());
+            
+            for (SizeType rowIndex = 0; rowIndex < b.getRowNumber(); ++rowIndex) {
+                result.element(rowIndex, columIndex) = colum[rowIndex];
+            }
+        }
+        
+        return result;
+    }
+    
+    Matrix LUDecomposition::inverse() const {
+        return this->solve(Matrix::unitaryMatrix(this->lu.getRowNumber()));
+    }
+    
+    CholeskyDecomposition::CholeskyDecomposition() {
+        
+    }
+    
+    CholeskyDecomposition::CholeskyDecomposition(const Matrix& matrix) {
+        this->decompose(matrix);
+    }
+    
+    CholeskyDecomposition::CholeskyDecomposition(const CholeskyDecomposition& rhs):lower(rhs.lower) {
+        
+    }
+    
+    CholeskyDecomposition& CholeskyDecomposition::operator=(const CholeskyDecomposition& rhs) {
+        CholeskyDecomposition temp(rhs);
+        this->swap(temp);
+        return *this;
+    }
+    
+    CholeskyDecomposition::~CholeskyDecomposition() {
+        
+    }
+    
+    void CholeskyDecomposition::swap(CholeskyDecomposition& other) {
+        using std::swap;
+        swap(this->lower, other.lower);
+    }
+    
+    bool CholeskyDecomposition::decompose(const Matrix& matrix) {
+        
+        assert(matrix.isEmpty() == false);
+        assert(matrix.isSquareMatrix() == true);
+        
+        SizeType order = matrix.getRowNumber();
+        
+        Matrix lower(order, order);
+        
+        for (SizeType columIndex = 0; columIndex < order; ++columIndex) {
+            
+            const ElementType* columRow = lower.rowData(columIndex);
+            
+            ElementType diagonal = matrix.element(columIndex, columIndex);
+            
+            for (SizeType index = 0; index < columIndex; ++index) {
+                diagonal -= columRow[index] * columRow[index];
+            }
+            
+            if (diagonal <= 0 || diagonal != diagonal) {
+                this->lower = Matrix::emptyMatrix();
+                return false;
+            }
+            
+            diagonal = sqrt(diagonal);
+            lower.element(columIndex, columIndex) = diagonal;
+            
+            for (SizeType rowIndex = columIndex + 1; rowIndex < order; ++rowIndex) {
                 
-                matrixCopy.addOneMultipleRowToAnotherRow(rowIndex, (-1) * (matrixCopy.data.at(eliminationIndex).at(firstColumNonZero) / matrixCopy.data.at(rowIndex).at(firstColumNonZero)), eliminationIndex);
+                const ElementType* row = lower.rowData(rowIndex);
+                
+                ElementType value = matrix.element(rowIndex, columIndex);
+                
+                for (SizeType index = 0; index < columIndex; ++index) {
+                    value -= row[index] * columRow[index];
+                }
+                
+                lower.element(rowIndex, columIndex) = value / diagonal;
             }
         }
         
-        return rank;
+        this->lower.swap(lower);
+        
+        return true;
+    }
+    
+    bool CholeskyDecomposition::isPositiveDefinite() const {
+        return this->lower.isEmpty() == false;
+    }
+    
+    ElementType CholeskyDecomposition::getDeterminant() const {
+        return exp(this->getLogDeterminant());
+    }
+    
+    ElementType CholeskyDecomposition::getLogDeterminant() const {
+        
+        assert(this->isPositiveDefinite() == true);
+        
+        ElementType logDeterminant = 0;
+        
+        for (SizeType index = 0; index < this->getOrder(); ++index) {
+            logDeterminant += 2 * log(this->lower.element(index, index));
+        }
+        
+        return logDeterminant;
     }
     
-    TraceValueType Matrix::getTrace() {
+    void CholeskyDecomposition::forwardSubstitution(const ElementType* b, ElementType* y) const {
         
-        assert(this->isSquareMatrix() == true);
+        assert(this->isPositiveDefinite() == true);
         
-        TraceValueType trace = 0;
+        SizeType order = this->getOrder();
         
-        for (size_t rowIndex = 0; rowIndex < this->getRowNumber(); ++rowIndex) {
-            trace += this->data.at(rowIndex).at(rowIndex);
+        for (SizeType rowIndex = 0; rowIndex < order; ++rowIndex) {
+            
+            const ElementType* row = this->lower.rowData(rowIndex);
+            
+            ElementType value = b[rowIndex];
+            
+            for (SizeType index = 0; index < rowIndex; ++index) {
+                value -= row[index] * y[index];
+            }
+            
+            y[rowIndex] = value / row[rowIndex];
         }
+    }
+    
+    void CholeskyDecomposition::backwardSubstitution(const ElementType* y, ElementType* x) const {
         
-        return trace;
+        assert(this->isPositiveDefinite() == true);
+        
+        SizeType order = this->getOrder();
+        
+        for (SizeType rowIndex = order; rowIndex > 0; --rowIndex) {
+            
+            ElementType value = y[rowIndex - 1];
+            
+            for (SizeType index = rowIndex; index < order; ++index) {
+                value -= this->lower.element(index, rowIndex - 1) * x[index];
+            }
+            
+            x[rowIndex - 1] = value / this->lower.element(rowIndex - 1, rowIndex - 1);
+        }
+    }
+    
+    void CholeskyDecomposition::solve(const ElementType* b, ElementType* x) const {
+        this->forwardSubstitution(b, x);
+        this->backwardSubstitution(x, x);
+    }
+    
+    void CholeskyDecomposition::solve(const vector<ElementType>& b, vector<ElementType>& x) const {
+        
+        assert(b.size() == this->getOrder());
+        
+        x.resize(b.size());
+        
+        this->solve(b.data(), x.data());
+    }
+    
+    Matrix CholeskyDecomposition::solve(const Matrix& b) const {
+        
+        assert(b.getRowNumber() == this->getOrder());
+        
+        Matrix result(b.getRowNumber(), b.getColumNumber());
+        
+        vector<ElementType> colum(b.getRowNumber());
+        
+        for (SizeType columIndex = 0; columIndex < b.getColumNumber(); ++columIndex) {
+            
+            for (SizeType rowIndex = 0; rowIndex < b.getRowNumber(); ++rowIndex) {
+                colum[rowIndex] = b.element(rowIndex, columIndex);
+            }
+            
+            this->solve(colum.data(), colum.data());
+            
+            for (SizeType rowIndex = 0; rowIndex < b.getRowNumber(); ++rowIndex) {
+                result.element(rowIndex, columIndex) = colum[rowIndex];
+            }
+        }
+        
+        return result;
+    }
+    
+    Matrix CholeskyDecomposition::inverse() const {
+        return this->solve(Matrix::unitaryMatrix(this->getOrder()));
+    }
+    
+    SymmetricEigenDecomposition::SymmetricEigenDecomposition() {
+        
+    }
+    
+    SymmetricEigenDecomposition::SymmetricEigenDecomposition(const Matrix& matrix) {
+        this->decompose(matrix);
+    }
+    
+    SymmetricEigenDecomposition::SymmetricEigenDecomposition(const SymmetricEigenDecomposition& rhs):eigenvalues(rhs.eigenvalues), eigenvectors(rhs.eigenvectors) {
+        
+    }
+    
+    SymmetricEigenDecomposition& SymmetricEigenDecomposition::operator=(const SymmetricEigenDecomposition& rhs) {
+        SymmetricEigenDecomposition temp(rhs);
+        this->swap(temp);
+        return *this;
+    }
+    
+    SymmetricEigenDecomposition::~SymmetricEigenDecomposition() {
+        
+    }
+    
+    void SymmetricEigenDecomposition::swap(SymmetricEigenDecomposition& other) {
+        using std::swap;
+        swap(this->eigenvalues, other.eigenvalues);
+        swap(this->eigenvectors, other.eigenvectors);
+    }
+    
+    //Every rotation zeroes one off-diagonal pair, sweeps repeat over all pairs until the off-diagonal part is rounding noise.
+    //The rotations are accumulated into the rows of V so that every update reads and writes whole rows.
+    void SymmetricEigenDecomposition::decompose(const Matrix& matrix) {
+        
+        assert(matrix.isEmpty() == false);
+        assert(matrix.isSquareMatrix() == true);
+        
+        SizeType order = matrix.getRowNumber();
+        
+        Matrix a(matrix);
+        Matrix v = Matrix::unitaryMatrix(order);
+        
+        ElementType totalSquares = 0;
+        
+        for (SizeType index = 0; index < order * order; ++index) {
+            totalSquares += a.data[index] * a.data[index];
+        }
+        
+        ElementType tolerance = numeric_limits<ElementType>::epsilon() * numeric_limits<ElementType>::epsilon() * totalSquares;
+        
+        for (size_t sweep = 0; sweep < MaxSweepsNumber; ++sweep) {
+            
+            ElementType offDiagonalSquares = 0;
+            
+            for (SizeType p = 0; p < order; ++p) {
+                
+                for (SizeType q = p + 1; q < order; ++q) {
+                    offDiagonalSquares += a.element(p, q) * a.element(p, q);
+                }
+            }
+            
+            if (2 * offDiagonalSquares <= tolerance) {
+                break;
+            }
+            
+            for (SizeType p = 0; p < order; ++p) {
+                
+                for (SizeType q = p + 1; q < order; ++q) {
+                    
+                    ElementType apq = a.element(p, q);
+                    
+                    if (apq == 0) {
+                        continue;
+                    }
+                    
+                    ElementType theta = (a.element(q, q) - a.element(p, p)) / (2 * apq);
+                    ElementType t = 1 / (fabs(theta) + sqrt(theta * theta + 1));
+                    
+                    if (theta < 0) {
+                        t = -t;
+                    }
+                    
+                    ElementType c = 1 / sqrt(t * t + 1);
+                    ElementType s = t * c;
+                    
+                    //A = J^T * A * J, first the columns p and q and then the rows.
+                    for (SizeType k = 0; k < order; ++k) {
+                        
+                        ElementType* row = a.rowData(k);
+                        
+                        ElementType akp = row[p];
+                        ElementType akq = row[q];
+                        
+                        row[p] = c * akp - s * akq;
+                        row[q] = s * akp + c * akq;
+                    }
+                    
+                    ElementType* rowP = a.rowData(p);
+                    ElementType* rowQ = a.rowData(q);
+                    
+                    for (SizeType k = 0; k < order; ++k) {
+                        
+                        ElementType apk = rowP[k];
+                        ElementType aqk = rowQ[k];
+                        
+                        rowP[k] = c * apk - s * aqk;
+                        rowQ[k] = s * apk + c * aqk;
+                    }
+                    
+                    rowP[q] = 0;
+                    rowQ[p] = 0;
+                    
+                    ElementType* vectorP = v.rowData(p);
+                    ElementType* vectorQ = v.rowData(q);
+                    
+                    for (SizeType k = 0; k < order; ++k) {
+                        
+                        ElementType vpk = vectorP[k];
+                        ElementType vqk = vectorQ[k];
+                        
+                        vectorP[k] = c * vpk - s * vqk;
+                        vectorQ[k] = s * vpk + c * vqk;
+                    }
+                }
+            }
+        }
+        
+        vector< pair<ElementType, SizeType> > sortedEigenvalues(order);
+        
+        for (SizeType index = 0; index < order; ++index) {
+            sortedEigenvalues[index] = make_pair(a.element(index, index), index);
+        }
+        
+        sort(sortedEigenvalues.begin(), sortedEigenvalues.end(), greater< pair<ElementType, SizeType> >());
+        
+        this->eigenvalues.resize(order);
+        this->eigenvectors = Matrix(order, order);
+        
+        for (SizeType index = 0; index < order; ++index) {
+            
+            this->eigenvalues[index] = sortedEigenvalues[index].first;
+            
+            const ElementType* source = v.rowData(sortedEigenvalues[index].second);
+            
+            copy(source, source + order, this->eigenvectors.rowData(index));
+        }
     }
 }
 
@@ -268,4 +990,19 @@ namespace std {
     void swap<std::Matrix>(std::Matrix&a, std::Matrix& b) {
         a.swap(b);
     }
+    
+    template<>
+    void swap<std::LUDecomposition>(std::LUDecomposition& a, std::LUDecomposition& b) {
+        a.swap(b);
+    }
+    
+    template<>
+    void swap<std::CholeskyDecomposition>(std::CholeskyDecomposition& a, std::CholeskyDecomposition& b) {
+        a.swap(b);
+    }
+    
+    template<>
+    void swap<std::SymmetricEigenDecomposition>(std::SymmetricEigenDecomposition& a, std::SymmetricEigenDecomposition& b) {
+        a.swap(b);
+    }
 }
\ No newline at end of file
@@ -3,6 +3,7 @@
 
 #include <vector>
 #include "assert.h"
+#include "AlignedAllocator.h"
 
 namespace std {
     
@@ -21,6 +22,10 @@ namespace std {
         Matrix(const Matrix& rhs);
         Matrix& operator=(const Matrix& rhs);
         
+        //Moves hand the buffer over, so results of the operators below are never copied.
+        Matrix(Matrix&& rhs) noexcept;
+        Matrix& operator=(Matrix&& rhs) noexcept;
+        
         Matrix(SizeType rowNumber, SizeType columNumber);
         
         ~Matrix();
@@ -31,36 +36,53 @@ namespace std {
         bool isSquareMatrix() const;
         
         inline const SizeType getRowNumber() const {
-            return (this->data).size();
+            return this->rowNumber;
         }
         
         inline const SizeType getColumNumber() const {
+            return this->columNumber;
+        }
+        
+        inline ElementType getElement(SizeType rowIndex, SizeType columIndex) const {
             
-            if (this->getRowNumber() > 0) {
-                
-                const vector<ElementType>& firstColum = (this->data).at(0);
-                
-                return firstColum.size();
-            }
+            assert(this->getRowNumber() > rowIndex && this->getColumNumber() > columIndex);
             
-            return 0;
+            return this->data[rowIndex * this->columNumber + columIndex];
+        }
+        
+        inline void setElement(SizeType rowIndex, SizeType columIndex, ElementType element) {
+            
+            assert(this->getRowNumber() > rowIndex && this->getColumNumber() > columIndex);
+            
+            this->data[rowIndex * this->columNumber + columIndex] = element;
+        }
+        
+        //Row-major elements, row r starts at r * getColumNumber().
+        inline const ElementType* getData() const {
+            return this->data.data();
+        }
+        
+        inline ElementType* getData() {
+            return this->data.data();
         }
         
         inline const vector<ElementType> getRow(SizeType rowIndex) const {
             
             assert(this->getRowNumber() > rowIndex);
             
-            return vector<ElementType>(this->data.at(rowIndex));
+            const ElementType* row = this->rowData(rowIndex);
+            
+            return vector<ElementType>(row, row + this->columNumber);
         }
         
         inline const vector<ElementType> getColum(SizeType columIndex) const {
             
             assert(this->getColumNumber() > columIndex);
             
-            vector<ElementType> colum;
+            vector<ElementType> colum(this->getRowNumber());
             
             for (size_t rowIndex = 0; rowIndex < this->getRowNumber(); ++rowIndex) {
-                colum.push_back(this->data.at(rowIndex).at(columIndex));
+                colum[rowIndex] = this->element(rowIndex, columIndex);
             }
             
             return vector<ElementType>(colum);
@@ -72,79 +94,214 @@ namespace std {
         void addColum(const vector<ElementType>& columData);
         void deleteColum(SizeType columIndex);
         
-        friend inline const Matrix operator+(const Matrix& lhs, const Matrix& rhs) {
+        Matrix& operator+=(const Matrix& rhs) {
             
-            assert(lhs.isEmpty() == false && rhs.isEmpty() == false);
-            assert(lhs.getRowNumber() == rhs.getRowNumber() && lhs.getColumNumber() == rhs.getColumNumber());
+            assert(this->getRowNumber() == rhs.getRowNumber() && this->getColumNumber() == rhs.getColumNumber());
             
-            Matrix result(lhs.getRowNumber(), lhs.getColumNumber());
+            size_t size = this->data.size();
             
-            for (SizeType rowIndex = 0; rowIndex < lhs.getRowNumber(); ++rowIndex) {
-                for (SizeType columIndex = 0; columIndex < lhs.getColumNumber(); ++columIndex) {
-                    result.data.at(rowIndex).at(columIndex) = lhs.data.at(rowIndex).at(columIndex) + rhs.data.at(rowIndex).at(columIndex);
-                }
+            for (size_t index = 0; index < size; ++index) {
+                this->data[index] += rhs.data[index];
+            }
+            
+            return *this;
+        }
+        
+        Matrix& operator-=(const Matrix& rhs) {
+            
+            assert(this->getRowNumber() == rhs.getRowNumber() && this->getColumNumber() == rhs.getColumNumber());
+            
+            size_t size = this->data.size();
+            
+            for (size_t index = 0; index < size; ++index) {
+                this->data[index] -= rhs.data[index];
             }
             
-            return Matrix(result);
+            return *this;
         }
         
-        friend inline const Matrix operator*(MultipleNumberType multipleNumber, const Matrix& rhs) {
+        Matrix& operator*=(MultipleNumberType multipleNumber) {
+            
+            size_t size = this->data.size();
+            
+            for (size_t index = 0; index < size; ++index) {
+                this->data[index] *= multipleNumber;
+            }
+            
+            return *this;
+        }
+        
+        //The product needs its own buffer, it replaces this matrix's buffer afterwards.
+        Matrix& operator*=(const Matrix& rhs) {
+            
+            Matrix result(this->getRowNumber(), rhs.getColumNumber());
+            
+            Matrix::multiply(*this, rhs, result);
+            
+            this->swap(result);
+            
+            return *this;
+        }
+        
+        friend inline Matrix operator+(const Matrix& lhs, const Matrix& rhs) {
+            
+            assert(lhs.isEmpty() == false && rhs.isEmpty() == false);
+            
+            Matrix result(lhs);
+            result += rhs;
+            
+            return result;
+        }
+        
+        //A temporary on the left is reused as the result, chains like a + b + c allocate once.
+        friend inline Matrix operator+(Matrix&& lhs, const Matrix& rhs) {
+            
+            assert(lhs.isEmpty() == false && rhs.isEmpty() == false);
+            
+            lhs += rhs;
+            
+            return std::move(lhs);
+        }
+        
+        friend inline Matrix operator-(const Matrix& lhs, const Matrix& rhs) {
+            
+            assert(lhs.isEmpty() == false && rhs.isEmpty() == false);
+            
+            Matrix result(lhs);
+            result -= rhs;
+            
+            return result;
+        }
+        
+        friend inline Matrix operator-(Matrix&& lhs, const Matrix& rhs) {
+            
+            assert(lhs.isEmpty() == false && rhs.isEmpty() == false);
+            
+            lhs -= rhs;
+            
+            return std::move(lhs);
+        }
+        
+        friend inline Matrix operator*(MultipleNumberType multipleNumber, const Matrix& rhs) {
             
             Matrix result(rhs);
+            result *= multipleNumber;
+            
+            return result;
+        }
+        
+        friend inline Matrix operator*(MultipleNumberType multipleNumber, Matrix&& rhs) {
+            
+            rhs *= multipleNumber;
+            
+            return std::move(rhs);
+        }
+        
+        friend inline Matrix operator*(const Matrix& lhs, const Matrix& rhs) {
+            
+            assert(lhs.isEmpty() == false && rhs.isEmpty() == false);
+            assert(lhs.getColumNumber() == rhs.getRowNumber());
+            
+            Matrix result(lhs.getRowNumber(), rhs.getColumNumber());
+            
+            Matrix::multiply(lhs, rhs, result);
             
-            if (rhs.isEmpty() == false) {
+            return result;
+        }
+        
+        //y = alpha * this * x + beta * y, x has getColumNumber() and y getRowNumber() elements.
+        inline void gemv(const ElementType* x, ElementType* y, ElementType alpha = 1, ElementType beta = 0) const {
+            
+            for (SizeType rowIndex = 0; rowIndex < this->rowNumber; ++rowIndex) {
                 
-                for (SizeType rowIndex = 0; rowIndex < rhs.getRowNumber(); ++rowIndex) {
-                    for (SizeType columIndex = 0; columIndex < rhs.getColumNumber(); ++columIndex) {
-                        result.data.at(rowIndex).at(columIndex) *= multipleNumber;
-                    }
+                const ElementType* row = this->rowData(rowIndex);
+                
+                ElementType product = 0;
+                
+                for (SizeType columIndex = 0; columIndex < this->columNumber; ++columIndex) {
+                    product += row[columIndex] * x[columIndex];
                 }
                 
+                if (beta == 0) {
+                    y[rowIndex] = alpha * product;
+                } else {
+                    y[rowIndex] = alpha * product + beta * y[rowIndex];
+                }
             }
+        }
+        
+        inline void gemv(const vector<ElementType>& x, vector<ElementType>& y, ElementType alpha = 1, ElementType beta = 0) const {
             
-            return Matrix(result);
+            assert(x.size() == this->getColumNumber());
+            
+            y.resize(this->getRowNumber());
+            
+            this->gemv(x.data(), y.data(), alpha, beta);
         }
         
-        friend inline const Matrix operator*(const Matrix& lhs, const Matrix& rhs) {
+        //x^T * this * x for a square matrix, evaluated row by row without any intermediate.
+        inline ElementType quadraticForm(const ElementType* x) const {
             
-            assert(lhs.isEmpty() == false && rhs.isEmpty() == false);
-            assert(lhs.getColumNumber() == rhs.getRowNumber());
+            assert(this->isSquareMatrix() == true);
             
-            Matrix result(lhs.getRowNumber(), rhs.getColumNumber());
+            ElementType result = 0;
             
-            for (SizeType rowIndex = 0; rowIndex < result.getRowNumber(); ++rowIndex) {
-                for (SizeType columIndex = 0; columIndex < result.getColumNumber(); ++columIndex) {
-                    
-                    ElementType multipleElement = 0;
-                    
-                    for (SizeType multipleElementIndex = 0; multipleElementIndex < lhs.getColumNumber(); ++multipleElementIndex) {
-                        
-                        multipleElement += lhs.data.at(rowIndex).at(multipleElementIndex) * rhs.data.at(multipleElementIndex).at(columIndex);
-                    }
-                    
-                    result.data.at(rowIndex).at(columIndex) = multipleElement;
+            for (SizeType rowIndex = 0; rowIndex < this->rowNumber; ++rowIndex) {
+                
+                const ElementType* row = this->rowData(rowIndex);
+                
+                ElementType product = 0;
+                
+                for (SizeType columIndex = 0; columIndex < this->columNumber; ++columIndex) {
+                    product += row[columIndex] * x[columIndex];
                 }
+                
+                result += x[rowIndex] * product;
             }
             
-            return Matrix(result);
+            return result;
+        }
+        
+        inline ElementType quadraticForm(const vector<ElementType>& x) const {
+            
+            assert(x.size() == this->getColumNumber());
+            
+            return this->quadraticForm(x.data());
         }
         
-        inline const Matrix transposeMatrix() {
+        inline Matrix transposeMatrix() const {
             
             Matrix result(this->getColumNumber(), this->getRowNumber());
             
             if (this->isEmpty() == false) {
                 
-                for (SizeType rowIndex = 0; rowIndex < result.getRowNumber(); ++rowIndex) {
-                    for (SizeType columIndex = 0; columIndex < result.getColumNumber(); ++columIndex) {
-                        result.data.at(rowIndex).at(columIndex) = this->data.at(columIndex).at(rowIndex);
+                //Tiles keep both the rows read and the rows written in cache.
+                for (SizeType rowBlock = 0; rowBlock < this->rowNumber; rowBlock += TransposeBlockSize) {
+                    for (SizeType columBlock = 0; columBlock < this->columNumber; columBlock += TransposeBlockSize) {
+                        
+                        SizeType rowEnd = min(rowBlock + TransposeBlockSize, this->rowNumber);
+                        SizeType columEnd = min(columBlock + TransposeBlockSize, this->columNumber);
+                        
+                        for (SizeType rowIndex = rowBlock; rowIndex < rowEnd; ++rowIndex) {
+                            for (SizeType columIndex = columBlock; columIndex < columEnd; ++columIndex) {
+                                result.element(columIndex, rowIndex) = this->element(rowIndex, columIndex);
+                            }
+                        }
                     }
                 }
             }
             
-            return Matrix(result);
+            return result;
         }
         
+        //Writes lhs * rhs into result, which must already have the product's size.
+        //Uses a cache-blocked kernel and splits the rows between threads once the product is large enough.
+        static void multiply(const Matrix& lhs, const Matrix& rhs, Matrix& result);
+        
+        //Threads used by multiply for large products, 0 means one per hardware thread.
+        static void setMultiplicationThreadsNumber(size_t threadsNumber);
+        static size_t getMultiplicationThreadsNumber();
+        
         void switchTwoRow(SizeType rowIndex0, SizeType rowIndex1);
         void multipleRow(MultipleNumberType multipleNumber, SizeType rowIndex);
         void addOneMultipleRowToAnotherRow(SizeType rowIndex0, MultipleNumberType multipleNumber, SizeType rowIndex1);
@@ -153,75 +310,211 @@ namespace std {
         void multipleColum(MultipleNumberType multipleNumber, SizeType columIndex);
         void addOneMultipleColumToAnotherColum(SizeType columIndex0, MultipleNumberType multipleNumber, SizeType columindex1);
         
-        inline const Matrix inverseOfSquareMatrix() {
-            
-            assert(this->isEmpty() == false);
-            assert(this->isSquareMatrix() == true);
- 
-            Matrix matrixCopy(*this);
-            Matrix result = Matrix::unitaryMatrix(this->getRowNumber());
-            
-            for (size_t rowIndex = 0; rowIndex < matrixCopy.getRowNumber(); ++rowIndex) {
-                
-                SizeType firstRowNonZeroInColum = matrixCopy.firstRowContainsNonZeroElementColumUpRow(rowIndex, rowIndex);
-                
-                //Matrix is singular matrix because its rank isn't equals its order.
-                if (firstRowNonZeroInColum == matrixCopy.getRowNumber()) {
-                    result = Matrix::emptyMatrix();
-                    break;
-                }
-                
-                result.switchTwoRow(rowIndex, firstRowNonZeroInColum);
-                matrixCopy.switchTwoRow(rowIndex, firstRowNonZeroInColum);
-                
-                result.multipleRow(1.0 / matrixCopy.data.at(rowIndex).at(rowIndex), rowIndex);
-                matrixCopy.multipleRow(1.0 / matrixCopy.data.at(rowIndex).at(rowIndex), rowIndex);
-                
-                for (size_t eliminationIndex = 0; eliminationIndex < matrixCopy.getRowNumber(); ++eliminationIndex) {
-                    
-                    if (eliminationIndex == rowIndex) {
-                        continue;
-                    }
-                    
-                    result.addOneMultipleRowToAnotherRow(rowIndex, (-1) * matrixCopy.data.at(eliminationIndex).at(rowIndex), eliminationIndex);
-                    matrixCopy.addOneMultipleRowToAnotherRow(rowIndex, (-1) * matrixCopy.data.at(eliminationIndex).at(rowIndex), eliminationIndex);
-                }
-            }
-            
-            return Matrix(result);
-        }
+        //Solves through a partial-pivoting LU factorization, a singular matrix gives the empty matrix.
+        //Prefer keeping an LUDecomposition or CholeskyDecomposition and solving with it when only products with the inverse are needed.
+        Matrix inverseOfSquareMatrix() const;
         
-        RankValueType getRank();
-        TraceValueType getTrace();
+        RankValueType getRank() const;
+        TraceValueType getTrace() const;
+        ElementType getDeterminant() const;
         
-        static inline const Matrix unitaryMatrix(SizeType size) {
+        static inline Matrix unitaryMatrix(SizeType size) {
             
             Matrix result(size, size);
             
             for (SizeType index = 0; index < size; ++index) {
-                result.data.at(index).at(index) = 1;
+                result.element(index, index) = 1;
             }
             
-            return Matrix(result);
+            return result;
         }
         
-        static inline const Matrix emptyMatrix() {
+        //Sample covariance (divided by n - 1) of the rows, means receives the column means.
+        static Matrix covariance(const vector< vector<ElementType> >& samples, vector<ElementType>& means);
+        
+        static inline Matrix emptyMatrix() {
             
             return Matrix();
         }
         
     private:
-        vector< vector<ElementType> > data;
         
-        SizeType firstRowContainsNonZeroElementColumUpRow(SizeType columIndex, SizeType upRowIndex);
-        SizeType firstColumNonZeroElementUpRow(SizeType upRowIndex);
+        friend class LUDecomposition;
+        friend class CholeskyDecomposition;
+        friend class SymmetricEigenDecomposition;
+        
+        static const SizeType TransposeBlockSize = 32;
+        
+        //One aligned row-major buffer instead of one allocation per row.
+        vector<ElementType, AlignedAllocator<ElementType> > data;
+        
+        SizeType rowNumber;
+        SizeType columNumber;
+        
+        static size_t multiplicationThreadsNumber;
+        
+        inline ElementType& element(SizeType rowIndex, SizeType columIndex) {
+            return this->data[rowIndex * this->columNumber + columIndex];
+        }
+        
+        inline const ElementType& element(SizeType rowIndex, SizeType columIndex) const {
+            return this->data[rowIndex * this->columNumber + columIndex];
+        }
+        
+        inline ElementType* rowData(SizeType rowIndex) {
+            return this->data.data() + rowIndex * this->columNumber;
+        }
+        
+        inline const ElementType* rowData(SizeType rowIndex) const {
+            return this->data.data() + rowIndex * this->columNumber;
+        }
+        
+        static void multiplyRows(const Matrix& lhs, const Matrix& rhs, Matrix& result, SizeType rowBegin, SizeType rowEnd);
     };
     
+    //P * A = L * U with partial pivoting by magnitude, computed once and reused for any number of right-hand sides.
+    //Columns without a pivot above the tolerance are skipped, so rectangular and rank deficient matrices give their rank as well.
+    class LUDecomposition {
+        
+    public:
+        
+        LUDecomposition();
+        LUDecomposition(const Matrix& matrix);
+        
+        LUDecomposition(const LUDecomposition& rhs);
+        LUDecomposition& operator=(const LUDecomposition& rhs);
+        
+        ~LUDecomposition();
+        
+        void swap(LUDecomposition& other);
+        
+        void decompose(const Matrix& matrix);
+        
+        //Square and of full rank.
+        bool isNonSingular() const;
+        
+        RankValueType getRank() const;
+        ElementType getDeterminant() const;
+        
+        //Solves A * x = b in place of x, b and x may be the same buffer.
+        void solve(const ElementType* b, ElementType* x) const;
+        void solve(const vector<ElementType>& b, vector<ElementType>& x) const;
+        
+        //Solves A * X = B column by column.
+        Matrix solve(const Matrix& b) const;
+        
+        Matrix inverse() const;
+        
+    private:
+        
+        //L below the diagonal with an implicit unit diagonal, U on and above it.
+        Matrix lu;
+        
+        //Row i of the factors is row rowPermutation[i] of the input.
+        vector<SizeType> rowPermutation;
+        
+        RankValueType rank;
+        ElementType permutationSign;
+    };
+    
+    //A = L * L^T for symmetric positive definite matrices such as covariances, half the work of LU and no pivoting needed.
+    class CholeskyDecomposition {
+        
+    public:
+        
+        CholeskyDecomposition();
+        CholeskyDecomposition(const Matrix& matrix);
+        
+        CholeskyDecomposition(const CholeskyDecomposition& rhs);
+        CholeskyDecomposition& operator=(const CholeskyDecomposition& rhs);
+        
+        ~CholeskyDecomposition();
+        
+        void swap(CholeskyDecomposition& other);
+        
+        //Returns false and leaves the decomposition empty when the matrix is not positive definite.
+        bool decompose(const Matrix& matrix);
+        
+        bool isPositiveDefinite() const;
+        
+        inline SizeType getOrder() const {
+            return this->lower.getRowNumber();
+        }
+        
+        inline const Matrix& getLowerTriangle() const {
+            return this->lower;
+        }
+        
+        ElementType getDeterminant() const;
+        ElementType getLogDeterminant() const;
+        
+        //Solves L * y = b, y and b may be the same buffer. ||y||^2 is then b^T * A^-1 * b.
+        void forwardSubstitution(const ElementType* b, ElementType* y) const;
+        
+        //Solves L^T * x = y, x and y may be the same buffer.
+        void backwardSubstitution(const ElementType* y, ElementType* x) const;
+        
+        //Solves A * x = b, b and x may be the same buffer.
+        void solve(const ElementType* b, ElementType* x) const;
+        void solve(const vector<ElementType>& b, vector<ElementType>& x) const;
+        
+        Matrix solve(const Matrix& b) const;
+        
+        Matrix inverse() const;
+        
+    private:
+        
+        Matrix lower;
+    };
+    
+    //A = V^T * D * V for symmetric matrices by cyclic Jacobi rotations, accurate for the small dense covariances of feature spaces.
+    class SymmetricEigenDecomposition {
+        
+    public:
+        
+        SymmetricEigenDecomposition();
+        SymmetricEigenDecomposition(const Matrix& matrix);
+        
+        SymmetricEigenDecomposition(const SymmetricEigenDecomposition& rhs);
+        SymmetricEigenDecomposition& operator=(const SymmetricEigenDecomposition& rhs);
+        
+        ~SymmetricEigenDecomposition();
+        
+        void swap(SymmetricEigenDecomposition& other);
+        
+        void decompose(const Matrix& matrix);
+        
+        //Sorted from the largest to the smallest.
+        inline const vector<ElementType>& getEigenvalues() const {
+            return this->eigenvalues;
+        }
+        
+        //Row i is the unit eigenvector of eigenvalue i.
+        inline const Matrix& getEigenvectors() const {
+            return this->eigenvectors;
+        }
+        
+    private:
+        
+        static const size_t MaxSweepsNumber = 64;
+        
+        vector<ElementType> eigenvalues;
+        Matrix eigenvectors;
+    };
 }
 
 namespace std {
     template<>
     void swap<std::Matrix>(std::Matrix& a, std::Matrix& b);
+    
+    template<>
+    void swap<std::LUDecomposition>(std::LUDecomposition& a, std::LUDecomposition& b);
+    
+    template<>
+    void swap<std::CholeskyDecomposition>(std::CholeskyDecomposition& a, std::CholeskyDecomposition& b);
+    
+    template<>
+    void swap<std::SymmetricEigenDecomposition>(std::SymmetricEigenDecomposition& a, std::SymmetricEigenDecomposition& b);
 }
 
 #endif
\ No newline at end of file
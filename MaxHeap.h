@@ -15,7 +15,7 @@ namespace std {
             
         }
         
-        MaxHeap(const MaxHeap& rhs):isNodesNumberLimited(rhs.isNodesNumberLimited), limitedNodesNumber(rhs.limitedNodesNumber), nodes(rhs.nodes) {
+        MaxHeap(const MaxHeap& rhs):nodes(rhs.nodes), isNodesNumberLimited(rhs.isNodesNumberLimited), limitedNodesNumber(rhs.limitedNodesNumber) {
             
         }
         
@@ -56,6 +56,18 @@ namespace std {
             return vector<T>(this->nodes);
         }
         
+        //The nodes in heap order, without a copy.
+        const vector<T>& getData() const {
+            return this->nodes;
+        }
+        
+        //Empties the heap for reuse, the storage of the nodes is kept.
+        void reset(size_t limitedNodesNumber) {
+            this->nodes.clear();
+            this->isNodesNumberLimited = true;
+            this->limitedNodesNumber = limitedNodesNumber;
+        }
+        
         void addData(const T& data) {
             
             if (this->isReachMaxNodeNumber() == true) {
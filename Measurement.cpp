@@ -2,6 +2,12 @@
 #include <cmath>
 #include "Statistics.h"
 #include "assert.h"
+#include <thread>
+#include <functional>
+
+#if defined(__AVX__)
+#include <immintrin.h>
+#endif
 
 namespace Measurement {
     
@@ -24,6 +30,13 @@ namespace Measurement {
         return distance;
     }
     
+    DistanceValueType euclideanDistance(const SparseVector& vector0, const SparseVector& vector1) {
+        
+        assert(vector0.getDimensionNumber() == vector1.getDimensionNumber());
+        
+        return sqrt(sparseSquaredDistance(vector0.getIndices(), vector0.getValues(), vector0.getNonZerosNumber(), vector1.getIndices(), vector1.getValues(), vector1.getNonZerosNumber()));
+    }
+    
     DistanceValueType manhattanDistance(const vector<DimensionValueType>& vector0, const vector<DimensionValueType>& vector1) {
         
         assert(vector0.size() == vector1.size());
@@ -122,18 +135,13 @@ namespace Measurement {
             matrixS.addRow(covarianceRow);
         }
         
-        Matrix matrix0;
-        matrix0.addRow(vector0);
-        
-        Matrix matrix1;
-        matrix1.addRow(vector1);
-        
-        Matrix matrixD = matrix0 + ((-1) * matrix1);
+        vector<ElementType> differenceVector(size);
         
-        Matrix resultMatrix = matrixD * matrixS.inverseOfSquareMatrix() * matrixD.transposeMatrix();
+        for (size_t index = 0; index < size; ++index) {
+            differenceVector[index] = vector0.at(index) - vector1.at(index);
+        }
         
-        vector<ElementType> resultVector = resultMatrix.getRow(0);
-        DistanceValueType distance = resultVector.at(0);
+        DistanceValueType distance = matrixS.inverseOfSquareMatrix().quadraticForm(differenceVector);
         
         return distance;
     }
@@ -173,6 +181,29 @@ namespace Measurement {
         return distance;
     }
     
+    DistanceValueType hammingDistance(const BitVector& vector0, const BitVector& vector1) {
+        
+        assert(vector0.getBitsNumber() == vector1.getBitsNumber());
+        
+        return (DistanceValueType)xorPopcount(vector0.getWords(), vector1.getWords(), vector0.getWordsNumber());
+    }
+    
+    JaccardDistanceValueType jaccardDistance(const BitVector& vector0, const BitVector& vector1) {
+        
+        assert(vector0.getBitsNumber() == vector1.getBitsNumber());
+        
+        size_t intersectionCount = 0;
+        size_t unionCount = 0;
+        
+        andOrPopcount(vector0.getWords(), vector1.getWords(), vector0.getWordsNumber(), intersectionCount, unionCount);
+        
+        if (unionCount == 0) {
+            return 0;
+        }
+        
+        return 1 - ((double)intersectionCount / unionCount);
+    }
+    
     typedef double SquareValueType;
     CosineValueType cosine(const vector<DimensionValueType>& vector0, const vector<DimensionValueType>& vector1) {
         
@@ -200,6 +231,39 @@ namespace Measurement {
         return cosineValue;
     }
     
+    CosineValueType cosine(const SparseVector& vector0, const SparseVector& vector1) {
+        
+        SquareValueType sumOfSquare0 = vector0.squaredNorm();
+        SquareValueType sumOfSquare1 = vector1.squaredNorm();
+        
+        assert(sumOfSquare0 != 0 && sumOfSquare1 != 0);
+        
+        return innerProduct(vector0, vector1) / (sqrt(sumOfSquare0) * sqrt(sumOfSquare1));
+    }
+    
+    DimensionValueType innerProduct(const SparseVector& vector0, const SparseVector& vector1) {
+        
+        assert(vector0.getDimensionNumber() == vector1.getDimensionNumber());
+        
+        return sparseDotProduct(vector0.getIndices(), vector0.getValues(), vector0.getNonZerosNumber(), vector1.getIndices(), vector1.getValues(), vector1.getNonZerosNumber());
+    }
+    
+    DimensionValueType innerProduct(const SparseVector& vector0, const vector<DimensionValueType>& vector1) {
+        
+        assert(vector0.getDimensionNumber() == vector1.size());
+        
+        const SparseIndexType* indices = vector0.getIndices();
+        const SparseValueType* values = vector0.getValues();
+        
+        DimensionValueType result = 0;
+        
+        for (size_t index = 0; index < vector0.getNonZerosNumber(); ++index) {
+            result += values[index] * vector1[indices[index]];
+        }
+        
+        return result;
+    }
+    
     typedef double MeanValueType;
     typedef double StandardScoreValueType;
     typedef double SampleStandardDeviationValueType;
@@ -231,4 +295,330 @@ namespace Measurement {
         return result;
     }
     
+    //Rows of matrix1 scanned together by the Manhattan and Chebyshev kernels.
+    static const size_t PairwiseColumnBlockSize = 64;
+    
+    //Pairs times dimensions below which no threads are started, the same bound as for Matrix::multiply.
+    static const double ParallelPairwiseThreshold = 4.0 * 1024 * 1024;
+    
+    static inline DistanceValueType manhattanRowDistance(const ElementType* __restrict row0, const ElementType* __restrict row1, size_t size) {
+        
+        size_t index = 0;
+        DistanceValueType distance = 0;
+        
+#if defined(__AVX__)
+        __m256d signMask = _mm256_set1_pd(-0.0);
+        __m256d sum0 = _mm256_setzero_pd();
+        __m256d sum1 = _mm256_setzero_pd();
+        
+        for (; index + 8 <= size; index += 8) {
+            sum0 = _mm256_add_pd(sum0, _mm256_andnot_pd(signMask, _mm256_sub_pd(_mm256_loadu_pd(row0 + index), _mm256_loadu_pd(row1 + index))));
+            sum1 = _mm256_add_pd(sum1, _mm256_andnot_pd(signMask, _mm256_sub_pd(_mm256_loadu_pd(row0 + index + 4), _mm256_loadu_pd(row1 + index + 4))));
+        }
+        
+        ElementType sums[4];
+        _mm256_storeu_pd(sums, _mm256_add_pd(sum0, sum1));
+        
+        distance = (sums[0] + sums[1]) + (sums[2] + sums[3]);
+#endif
+        
+        for (; index < size; ++index) {
+            distance += fabs(row0[index] - row1[index]);
+        }
+        
+        return distance;
+    }
+    
+    static inline DistanceValueType chebyshevRowDistance(const ElementType* __restrict row0, const ElementType* __restrict row1, size_t size) {
+        
+        size_t index = 0;
+        DistanceValueType distance = 0;
+        
+#if defined(__AVX__)
+        __m256d signMask = _mm256_set1_pd(-0.0);
+        __m256d max0 = _mm256_setzero_pd();
+        __m256d max1 = _mm256_setzero_pd();
+        
+        for (; index + 8 <= size; index += 8) {
+            max0 = _mm256_max_pd(max0, _mm256_andnot_pd(signMask, _mm256_sub_pd(_mm256_loadu_pd(row0 + index), _mm256_loadu_pd(row1 + index))));
+            max1 = _mm256_max_pd(max1, _mm256_andnot_pd(signMask, _mm256_sub_pd(_mm256_loadu_pd(row0 + index + 4), _mm256_loadu_pd(row1 + index + 4))));
+        }
+        
+        ElementType maxima[4];
+        _mm256_storeu_pd(maxima, _mm256_max_pd(max0, max1));
+        
+        distance = max(max(maxima[0], maxima[1]), max(maxima[2], maxima[3]));
+#endif
+        
+        for (; index < size; ++index) {
+            distance = max(distance, fabs(row0[index] - row1[index]));
+        }
+        
+        return distance;
+    }
+    
+    static void scanDistanceRows(const Matrix& matrix0, const Matrix& matrix1, PairwiseDistanceType distanceType, Matrix& result, size_t rowBegin, size_t rowEnd) {
+        
+        size_t size = matrix0.getColumNumber();
+        size_t columNumber = matrix1.getRowNumber();
+        
+        const ElementType* data0 = matrix0.getData();
+        const ElementType* data1 = matrix1.getData();
+        ElementType* resultData = result.getData();
+        
+        for (size_t columBlock = 0; columBlock < columNumber; columBlock += PairwiseColumnBlockSize) {
+            
+            size_t columBlockEnd = min(columBlock + PairwiseColumnBlockSize, columNumber);
+            
+            for (size_t rowIndex = rowBegin; rowIndex < rowEnd; ++rowIndex) {
+                
+                const ElementType* row0 = data0 + rowIndex * size;
+                ElementType* resultRow = resultData + rowIndex * columNumber;
+                
+                for (size_t columIndex = columBlock; columIndex < columBlockEnd; ++columIndex) {
+                    
+                    if (distanceType == ManhattanPairwiseDistance) {
+                        resultRow[columIndex] = manhattanRowDistance(row0, data1 + columIndex * size, size);
+                    } else {
+                        resultRow[columIndex] = chebyshevRowDistance(row0, data1 + columIndex * size, size);
+                    }
+                }
+            }
+        }
+    }
+    
+    static void squaredNorms(const Matrix& matrix, vector<DistanceValueType>& norms) {
+        
+        size_t size = matrix.getColumNumber();
+        const ElementType* data = matrix.getData();
+        
+        norms.resize(matrix.getRowNumber());
+        
+        for (size_t rowIndex = 0; rowIndex < matrix.getRowNumber(); ++rowIndex) {
+            
+            const ElementType* row = data + rowIndex * size;
+            
+            DistanceValueType norm = 0;
+            
+            for (size_t index = 0; index < size; ++index) {
+                norm += row[index] * row[index];
+            }
+            
+            norms[rowIndex] = norm;
+        }
+    }
+    
+    void pairwiseDistances(const Matrix& matrix0, const Matrix& matrix1, PairwiseDistanceType distanceType, Matrix& result) {
+        
+        assert(matrix0.getColumNumber() == matrix1.getColumNumber());
+        assert(result.getRowNumber() == matrix0.getRowNumber() && result.getColumNumber() == matrix1.getRowNumber());
+        
+        size_t rowNumber = matrix0.getRowNumber();
+        size_t columNumber = matrix1.getRowNumber();
+        
+        if (rowNumber == 0 || columNumber == 0) {
+            return;
+        }
+        
+        if (distanceType == ManhattanPairwiseDistance || distanceType == ChebyshevPairwiseDistance) {
+            
+            size_t threadsNumber = Matrix::getMultiplicationThreadsNumber();
+            
+            if ((double)rowNumber * columNumber * matrix0.getColumNumber() < ParallelPairwiseThreshold) {
+                threadsNumber = 1;
+            }
+            
+            threadsNumber = min(threadsNumber, rowNumber);
+            
+            vector<thread> threads;
+            
+            for (size_t threadIndex = 1; threadIndex < threadsNumber; ++threadIndex) {
+                threads.push_back(thread(scanDistanceRows, cref(matrix0), cref(matrix1), distanceType, ref(result), rowNumber * threadIndex / threadsNumber, rowNumber * (threadIndex + 1) / threadsNumber));
+            }
+            
+            scanDistanceRows(matrix0, matrix1, distanceType, result, 0, rowNumber / threadsNumber);
+            
+            vector<thread>::iterator threadIterator;
+            
+            for (threadIterator = threads.begin(); threadIterator != threads.end(); ++threadIterator) {
+                (*threadIterator).join();
+            }
+            
+            return;
+        }
+        
+        //All dot products at once, the multiplication is blocked and threaded itself.
+        Matrix::multiply(matrix0, matrix1.transposeMatrix(), result);
+        
+        vector<DistanceValueType> squaredNorms0;
+        vector<DistanceValueType> squaredNorms1;
+        
+        squaredNorms(matrix0, squaredNorms0);
+        squaredNorms(matrix1, squaredNorms1);
+        
+        ElementType* resultData = result.getData();
+        
+        for (size_t rowIndex = 0; rowIndex < rowNumber; ++rowIndex) {
+            
+            ElementType* resultRow = resultData + rowIndex * columNumber;
+            
+            if (distanceType == CosinePairwiseSimilarity) {
+                
+                assert(squaredNorms0[rowIndex] != 0);
+                
+                for (size_t columIndex = 0; columIndex < columNumber; ++columIndex) {
+                    
+                    assert(squaredNorms1[columIndex] != 0);
+                    resultRow[columIndex] /= sqrt(squaredNorms0[rowIndex] * squaredNorms1[columIndex]);
+                }
+                
+                continue;
+            }
+            
+            for (size_t columIndex = 0; columIndex < columNumber; ++columIndex) {
+                
+                //Cancellation may leave tiny negative values for (nearly) equal rows.
+                DistanceValueType distance = max(squaredNorms0[rowIndex] + squaredNorms1[columIndex] - 2 * resultRow[columIndex], 0.0);
+                
+                if (distanceType == EuclideanPairwiseDistance) {
+                    distance = sqrt(distance);
+                }
+                
+                resultRow[columIndex] = distance;
+            }
+        }
+    }
+    
+    MahalanobisMetric::MahalanobisMetric() {
+        
+    }
+    
+    MahalanobisMetric::MahalanobisMetric(const MahalanobisMetric& rhs):means(rhs.means), covariance(rhs.covariance), cholesky(rhs.cholesky) {
+        
+    }
+    
+    MahalanobisMetric& MahalanobisMetric::operator=(const MahalanobisMetric& rhs) {
+        MahalanobisMetric temp(rhs);
+        this->swap(temp);
+        return *this;
+    }
+    
+    MahalanobisMetric::~MahalanobisMetric() {
+        
+    }
+    
+    void MahalanobisMetric::swap(MahalanobisMetric& other) {
+        using std::swap;
+        swap(this->means, other.means);
+        swap(this->covariance, other.covariance);
+        swap(this->cholesky, other.cholesky);
+    }
+    
+    bool MahalanobisMetric::fit(const vector< vector<DimensionValueType> >& samples, DimensionValueType regularization) {
+        
+        assert(samples.size() > 1);
+        assert(regularization >= 0);
+        
+        this->clear();
+        
+        this->covariance = Matrix::covariance(samples, this->means);
+        
+        size_t dimensionNumber = this->means.size();
+        
+        for (size_t index = 0; index < dimensionNumber; ++index) {
+            this->covariance.setElement(index, index, this->covariance.getElement(index, index) + regularization);
+        }
+        
+        if (this->cholesky.decompose(this->covariance) == false) {
+            this->clear();
+            return false;
+        }
+        
+        return true;
+    }
+    
+    void MahalanobisMetric::clear() {
+        
+        MahalanobisMetric empty;
+        this->swap(empty);
+    }
+    
+    DistanceValueType MahalanobisMetric::squaredDistance(const DimensionValueType* vector0, const DimensionValueType* vector1, DimensionValueType* scratch) const {
+        
+        assert(this->isFitted() == true);
+        
+        size_t dimensionNumber = this->getDimensionNumber();
+        
+        for (size_t index = 0; index < dimensionNumber; ++index) {
+            scratch[index] = vector0[index] - vector1[index];
+        }
+        
+        this->cholesky.forwardSubstitution(scratch, scratch);
+        
+        DistanceValueType distance = 0;
+        
+        for (size_t index = 0; index < dimensionNumber; ++index) {
+            distance += scratch[index] * scratch[index];
+        }
+        
+        return distance;
+    }
+    
+    DistanceValueType MahalanobisMetric::distance(const vector<DimensionValueType>& vector0, const vector<DimensionValueType>& vector1) const {
+        
+        vector<DimensionValueType> scratch;
+        
+        return this->distance(vector0, vector1, scratch);
+    }
+    
+    DistanceValueType MahalanobisMetric::distance(const vector<DimensionValueType>& vector0, const vector<DimensionValueType>& vector1, vector<DimensionValueType>& scratch) const {
+        
+        assert(vector0.size() == this->getDimensionNumber());
+        assert(vector1.size() == this->getDimensionNumber());
+        
+        scratch.resize(this->getDimensionNumber());
+        
+        return sqrt(this->squaredDistance(vector0.data(), vector1.data(), scratch.data()));
+    }
+    
+    void MahalanobisMetric::whiten(const DimensionValueType* features, DimensionValueType* whitened) const {
+        
+        assert(this->isFitted() == true);
+        
+        size_t dimensionNumber = this->getDimensionNumber();
+        
+        for (size_t index = 0; index < dimensionNumber; ++index) {
+            whitened[index] = features[index] - this->means[index];
+        }
+        
+        this->cholesky.forwardSubstitution(whitened, whitened);
+    }
+    
+    void MahalanobisMetric::whiten(const vector<DimensionValueType>& features, vector<DimensionValueType>& whitened) const {
+        
+        assert(features.size() == this->getDimensionNumber());
+        
+        whitened.resize(features.size());
+        
+        this->whiten(features.data(), whitened.data());
+    }
+    
+    const vector< vector<DimensionValueType> > MahalanobisMetric::whiten(const vector< vector<DimensionValueType> >& featuresVector) const {
+        
+        vector< vector<DimensionValueType> > result(featuresVector.size());
+        
+        for (size_t index = 0; index < featuresVector.size(); ++index) {
+            this->whiten(featuresVector[index], result[index]);
+        }
+        
+        return result;
+    }
+    
+}
+
+namespace std {
+    template<>
+    void swap<Measurement::MahalanobisMetric>(Measurement::MahalanobisMetric& a, Measurement::MahalanobisMetric& b) {
+        a.swap(b);
+    }
 }
\ No newline at end of file
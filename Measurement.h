@@ -3,7 +3,11 @@
 
 #include <vector>
 #include <set>
+#include <algorithm>
+#include <iterator>
 #include "Matrix.h"
+#include "BitVector.h"
+#include "SparseVector.h"
 
 namespace Measurement {
     
@@ -19,6 +23,9 @@ namespace Measurement {
     
     DistanceValueType euclideanDistance(const vector<DimensionValueType>& vector0, const vector<DimensionValueType>& vector1);
     
+    //Sparse overloads only visit the non-zeros, the vectors are never densified.
+    DistanceValueType euclideanDistance(const SparseVector& vector0, const SparseVector& vector1);
+    
     DistanceValueType manhattanDistance(const vector<DimensionValueType>& vector0, const vector<DimensionValueType>& vector1);
     
     DistanceValueType chebyshevDistance(const vector<DimensionValueType>& vector0, const vector<DimensionValueType>& vector1);
@@ -27,28 +34,113 @@ namespace Measurement {
     
     DistanceValueType standardizedEuclideanDistance(const vector<DimensionValueType>& vector0, const vector<DimensionValueType>& vector1, const vector<StandardDeviationValueType>& standardDeviationsVector);
     
+    //Estimates the covariance from the two vectors alone and inverts it on every call, MahalanobisMetric learns it once from a dataset.
     DistanceValueType mahalanobisDistance(const vector<DimensionValueType>& vector0, const vector<DimensionValueType>& vector1, const vector<MeanValueType>& meansVector);
     
     DistanceValueType bhattacharyyaDistance(const vector<DimensionValueType>& vector0, const vector<DimensionValueType>& vector1);
     
     DistanceValueType hammingDistance(const vector<DimensionValueType>& vector0, const vector<DimensionValueType>& vector1);
     
+    //Popcount of the xor, 64 features per instruction instead of one double comparison each.
+    DistanceValueType hammingDistance(const BitVector& vector0, const BitVector& vector1);
+    
     CosineValueType cosine(const vector<DimensionValueType>& vector0, const vector<DimensionValueType>& vector1);
+    CosineValueType cosine(const SparseVector& vector0, const SparseVector& vector1);
     
-    template<typename T>
-    JaccardDistanceValueType jaccardDistance(const set<T>& set0, const set<T>& set1) {
+    DimensionValueType innerProduct(const SparseVector& vector0, const SparseVector& vector1);
+    DimensionValueType innerProduct(const SparseVector& vector0, const vector<DimensionValueType>& vector1);
+    
+    //Size of the intersection of two sorted ranges without duplicates, in linear time.
+    template<typename Iterator>
+    size_t mergeIntersectionCount(Iterator begin0, Iterator end0, Iterator begin1, Iterator end1) {
         
         size_t intersectionCount = 0;
         
-        typename set<T>::const_iterator iterator0;
+        while (begin0 != end0 && begin1 != end1) {
+            
+            if (*begin0 < *begin1) {
+                ++begin0;
+            } else if (*begin1 < *begin0) {
+                ++begin1;
+            } else {
+                ++intersectionCount;
+                ++begin0;
+                ++begin1;
+            }
+        }
         
-        for (iterator0 = set0.begin(); iterator0 != set0.end(); ++iterator0) {
+        return intersectionCount;
+    }
+    
+    //Ranges of similar size are merged, a much smaller one looks its elements up in the larger one by exponential search.
+    template<typename Iterator>
+    size_t sortedIntersectionCount(Iterator begin0, Iterator end0, Iterator begin1, Iterator end1, random_access_iterator_tag) {
+        
+        if (end0 - begin0 > end1 - begin1) {
+            swap(begin0, begin1);
+            swap(end0, end1);
+        }
+        
+        if ((end0 - begin0) * 32 >= end1 - begin1) {
+            return mergeIntersectionCount(begin0, end0, begin1, end1);
+        }
+        
+        size_t intersectionCount = 0;
+        
+        for (; begin0 != end0 && begin1 != end1; ++begin0) {
+            
+            ptrdiff_t step = 1;
             
-            if (set1.find(*iterator0) != set1.end()) {
+            while (step < end1 - begin1 && *(begin1 + step) < *begin0) {
+                begin1 += step;
+                step *= 2;
+            }
+            
+            begin1 = lower_bound(begin1, step < end1 - begin1 ? begin1 + step + 1 : end1, *begin0);
+            
+            if (begin1 != end1 && (*begin0 < *begin1) == false) {
                 ++intersectionCount;
             }
         }
         
+        return intersectionCount;
+    }
+    
+    //Without random access a jump costs as much as the steps it skips, so only the merge is linear.
+    template<typename Iterator>
+    size_t sortedIntersectionCount(Iterator begin0, Iterator end0, Iterator begin1, Iterator end1, input_iterator_tag) {
+        return mergeIntersectionCount(begin0, end0, begin1, end1);
+    }
+    
+    //Size of the intersection of two sorted ranges without duplicates.
+    template<typename Iterator>
+    size_t sortedIntersectionCount(Iterator begin0, Iterator end0, Iterator begin1, Iterator end1) {
+        return sortedIntersectionCount(begin0, end0, begin1, end1, typename iterator_traits<Iterator>::iterator_category());
+    }
+    
+    //Sets of similar size are merged, a much smaller one is looked up element by element in the tree of the larger one.
+    template<typename T>
+    JaccardDistanceValueType jaccardDistance(const set<T>& set0, const set<T>& set1) {
+        
+        const set<T>& smallSet = set0.size() <= set1.size() ? set0 : set1;
+        const set<T>& largeSet = set0.size() <= set1.size() ? set1 : set0;
+        
+        size_t intersectionCount = 0;
+        
+        if (smallSet.size() * 32 < largeSet.size()) {
+            
+            typename set<T>::const_iterator iterator0;
+            
+            for (iterator0 = smallSet.begin(); iterator0 != smallSet.end(); ++iterator0) {
+                
+                if (largeSet.find(*iterator0) != largeSet.end()) {
+                    ++intersectionCount;
+                }
+            }
+        } else {
+            intersectionCount = mergeIntersectionCount(set0.begin(), set0.end(), set1.begin(), set1.end());
+        }
+        
         size_t unionCount = set0.size() + set1.size() - intersectionCount;
         
         JaccardDistanceValueType distance = 1 - ((double)intersectionCount / unionCount);
@@ -56,8 +148,99 @@ namespace Measurement {
         return distance;
     }
     
+    //Sets stored as sorted arrays without duplicates, contiguous and much cheaper to build than a set.
+    template<typename T>
+    JaccardDistanceValueType jaccardDistance(const vector<T>& sortedSet0, const vector<T>& sortedSet1) {
+        
+        size_t intersectionCount = sortedIntersectionCount(sortedSet0.begin(), sortedSet0.end(), sortedSet1.begin(), sortedSet1.end());
+        
+        size_t unionCount = sortedSet0.size() + sortedSet1.size() - intersectionCount;
+        
+        JaccardDistanceValueType distance = 1 - ((double)intersectionCount / unionCount);
+        
+        return distance;
+    }
+    
+    //Set bits as set members, two empty sets are at distance 0.
+    JaccardDistanceValueType jaccardDistance(const BitVector& vector0, const BitVector& vector1);
+    
     PearsonCorrelationCoefficientValueType pearsonCorrelationCoefficient(const vector<DimensionValueType>& vector0, const vector<DimensionValueType>& vector1);
     
+    enum PairwiseDistanceType {
+        EuclideanPairwiseDistance,
+        SquaredEuclideanPairwiseDistance,
+        //Written as the similarity a.b / (|a| |b|), larger is closer unlike the other types.
+        CosinePairwiseSimilarity,
+        ManhattanPairwiseDistance,
+        ChebyshevPairwiseDistance
+    };
+    
+    //result(i, j) is the distance between row i of matrix0 and row j of matrix1, result must already have that shape and is overwritten.
+    //Euclidean and cosine use |a|^2 + |b|^2 - 2 a.b and a.b / (|a| |b|) with all dot products from one blocked multiplication. Cosine, like cosine(), needs nonzero rows on both sides.
+    //Manhattan and Chebyshev scan tiles of matrix1 rows that stay in cache while the rows of matrix0 pass over them.
+    //Large products are split over Matrix::getMultiplicationThreadsNumber() threads.
+    void pairwiseDistances(const Matrix& matrix0, const Matrix& matrix1, PairwiseDistanceType distanceType, Matrix& result);
+    
+    //Mahalanobis distance with the mean and covariance learned once from a dataset.
+    //The covariance is kept as its Cholesky factor L, so (x - y)^T S^-1 (x - y) = |L^-1 (x - y)|^2 costs one O(d^2) triangular solve.
+    //Whitening maps x to L^-1 (x - mean), Euclidean distances between whitened points are Mahalanobis distances between the originals.
+    class MahalanobisMetric {
+        
+    public:
+        
+        MahalanobisMetric();
+        
+        MahalanobisMetric(const MahalanobisMetric& rhs);
+        MahalanobisMetric& operator=(const MahalanobisMetric& rhs);
+        
+        ~MahalanobisMetric();
+        
+        void swap(MahalanobisMetric& other);
+        
+        //Uses the sample covariance plus regularization on its diagonal, fails when that is not positive definite.
+        bool fit(const vector< vector<DimensionValueType> >& samples, DimensionValueType regularization = 0);
+        
+        void clear();
+        
+        inline bool isFitted() const {
+            return this->cholesky.isPositiveDefinite();
+        }
+        
+        inline size_t getDimensionNumber() const {
+            return this->means.size();
+        }
+        
+        inline const vector<MeanValueType>& getMeans() const {
+            return this->means;
+        }
+        
+        inline const Matrix& getCovariance() const {
+            return this->covariance;
+        }
+        
+        //Scratch holds getDimensionNumber() values, no memory is allocated.
+        DistanceValueType squaredDistance(const DimensionValueType* vector0, const DimensionValueType* vector1, DimensionValueType* scratch) const;
+        
+        DistanceValueType distance(const vector<DimensionValueType>& vector0, const vector<DimensionValueType>& vector1) const;
+        DistanceValueType distance(const vector<DimensionValueType>& vector0, const vector<DimensionValueType>& vector1, vector<DimensionValueType>& scratch) const;
+        
+        //Whitened may be the features themselves.
+        void whiten(const DimensionValueType* features, DimensionValueType* whitened) const;
+        void whiten(const vector<DimensionValueType>& features, vector<DimensionValueType>& whitened) const;
+        const vector< vector<DimensionValueType> > whiten(const vector< vector<DimensionValueType> >& featuresVector) const;
+        
+    private:
+        
+        vector<MeanValueType> means;
+        Matrix covariance;
+        CholeskyDecomposition cholesky;
+    };
+    
+}
+
+namespace std {
+    template<>
+    void swap<Measurement::MahalanobisMetric>(Measurement::MahalanobisMetric& a, Measurement::MahalanobisMetric& b);
 }
 
 #endif
\ No newline at end of file
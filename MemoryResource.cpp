@@ -0,0 +1,377 @@
+#include "MemoryResource.h"
+#include <cstdlib>
+#include "assert.h"
+#include <new>
+#include <algorithm>
+#include <fstream>
+#include <string>
+#include <cstdio>
+#include <sys/mman.h>
+#include <unistd.h>
+#include <fcntl.h>
+#ifdef __linux__
+#include <sched.h>
+#include <sys/syscall.h>
+#endif
+
+namespace std {
+    
+    MemoryResource::~MemoryResource() {
+    
+    }
+    
+    MemoryResource* MemoryResource::getDefaultResource() {
+        
+        static HeapMemoryResource defaultResource;
+        
+        return &defaultResource;
+    }
+    
+    void* HeapMemoryResource::allocate(size_t size, size_t alignment) {
+        
+        void* memory = NULL;
+        
+        if (posix_memalign(&memory, max(alignment, sizeof(void*)), size) != 0) {
+            throw bad_alloc();
+        }
+        
+        return memory;
+    }
+    
+    void HeapMemoryResource::deallocate(void* memory, size_t, size_t) {
+        free(memory);
+    }
+    
+    //Modes of the mbind system call, defined here so that the build does not depend on libnuma headers.
+    static const int PreferredMemoryPolicy = 1;
+    static const int InterleavedMemoryPolicy = 3;
+    
+    static const size_t LongBitsNumber = sizeof(unsigned long) * 8;
+    
+    //Parses a sysfs list such as "0-3,8-11" into its members.
+    static vector<size_t> readSystemList(const char* path) {
+        
+        vector<size_t> members;
+        
+        ifstream file(path);
+        string list;
+        
+        if (!(file >> list)) {
+            return members;
+        }
+        
+        size_t position = 0;
+        
+        while (position < list.size()) {
+            
+            size_t end = list.find(',', position);
+            
+            if (end == string::npos) {
+                end = list.size();
+            }
+            
+            string range = list.substr(position, end - position);
+            
+            unsigned long first = 0;
+            unsigned long last = 0;
+            
+            if (sscanf(range.c_str(), "%lu-%lu", &first, &last) == 2) {
+                
+                for (unsigned long member = first; member <= last; ++member) {
+                    members.push_back(member);
+                }
+            } else if (sscanf(range.c_str(), "%lu", &first) == 1) {
+                members.push_back(first);
+            }
+            
+            position = end + 1;
+        }
+        
+        return members;
+    }
+    
+    PageMemoryResource::PageMemoryResource(PagePolicy pagePolicy, NumaPolicy numaPolicy, size_t numaNode):pagePolicy(pagePolicy), numaPolicy(numaPolicy), numaNode(numaNode), fallbacksNumber(0) {
+    
+    }
+    
+    void* PageMemoryResource::allocate(size_t size, size_t alignment) {
+        
+        size_t mappingSize = this->getMappingSize(size);
+        void* memory = MAP_FAILED;
+        
+#ifdef MAP_HUGETLB
+        if (this->pagePolicy == ExplicitHugePages) {
+            
+            memory = mmap(NULL, mappingSize, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+            
+            if (memory == MAP_FAILED) {
+                ++this->fallbacksNumber;
+            }
+        }
+#endif
+        
+        if (memory == MAP_FAILED) {
+            
+            if (this->pagePolicy == DefaultPages) {
+                
+                memory = mmap(NULL, mappingSize, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+                
+                if (memory == MAP_FAILED) {
+                    throw bad_alloc();
+                }
+            } else {
+                
+                //Maps a huge page more than needed and trims both ends, the kernel only uses huge pages for huge page aligned ranges.
+                char* mapping = static_cast<char*>(mmap(NULL, mappingSize + HugePageSize, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0));
+                
+                if (mapping == MAP_FAILED) {
+                    throw bad_alloc();
+                }
+                
+                size_t headSize = (HugePageSize - (size_t)mapping % HugePageSize) % HugePageSize;
+                
+                if (headSize > 0) {
+                    munmap(mapping, headSize);
+                }
+                
+                munmap(mapping + headSize + mappingSize, HugePageSize - headSize);
+                
+                memory = mapping + headSize;
+                
+#ifdef MADV_HUGEPAGE
+                madvise(memory, mappingSize, MADV_HUGEPAGE);
+#endif
+            }
+        }
+        
+        assert((size_t)memory % alignment == 0);
+        
+        this->applyNumaPolicy(memory, mappingSize);
+        
+        return memory;
+    }
+    
+    void PageMemoryResource::deallocate(void* memory, size_t size, size_t) {
+        munmap(memory, this->getMappingSize(size));
+    }
+    
+    size_t PageMemoryResource::getMappingSize(size_t size) const {
+        
+        size_t pageSize = this->pagePolicy == DefaultPages ? (size_t)sysconf(_SC_PAGESIZE) : HugePageSize;
+        
+        return (size + pageSize - 1) / pageSize * pageSize;
+    }
+    
+    //Pages are placed when first touched, so the policy only has to be set on the fresh mapping.
+    void PageMemoryResource::applyNumaPolicy(void* memory, size_t size) const {
+        
+#if defined(__linux__) && defined(SYS_mbind)
+        if (this->numaPolicy == LocalNumaPolicy) {
+            return;
+        }
+        
+        vector<size_t> nodes;
+        
+        if (this->numaPolicy == InterleavedNumaPolicy) {
+            nodes = readSystemList("/sys/devices/system/node/online");
+        } else {
+            nodes.push_back(this->numaNode);
+        }
+        
+        if (nodes.size() < 2 && this->numaPolicy == InterleavedNumaPolicy) {
+            return;
+        }
+        
+        vector<unsigned long> nodeMask(*max_element(nodes.begin(), nodes.end()) / LongBitsNumber + 1, 0);
+        
+        vector<size_t>::const_iterator nodeIterator;
+        
+        for (nodeIterator = nodes.begin(); nodeIterator != nodes.end(); ++nodeIterator) {
+            nodeMask[*nodeIterator / LongBitsNumber] |= 1UL << (*nodeIterator % LongBitsNumber);
+        }
+        
+        int mode = this->numaPolicy == InterleavedNumaPolicy ? InterleavedMemoryPolicy : PreferredMemoryPolicy;
+        
+        //The kernel reads one bit less than maxnode says.
+        syscall(SYS_mbind, memory, size, mode, nodeMask.data(), nodeMask.size() * LongBitsNumber + 1, 0);
+#endif
+    }
+    
+    size_t PageMemoryResource::getNumaNodesNumber() {
+        
+        vector<size_t> nodes = readSystemList("/sys/devices/system/node/online");
+        
+        return nodes.empty() == true ? 1 : *max_element(nodes.begin(), nodes.end()) + 1;
+    }
+    
+    size_t PageMemoryResource::getCurrentNumaNode() {
+        
+#if defined(__linux__) && defined(SYS_getcpu)
+        unsigned int cpu = 0;
+        unsigned int node = 0;
+        
+        if (syscall(SYS_getcpu, &cpu, &node, NULL) == 0) {
+            return node;
+        }
+#endif
+        
+        return 0;
+    }
+    
+    bool PageMemoryResource::pinThreadToNumaNode(size_t numaNode) {
+        
+#ifdef __linux__
+        char path[64];
+        snprintf(path, sizeof(path), "/sys/devices/system/node/node%lu/cpulist", (unsigned long)numaNode);
+        
+        vector<size_t> cpus = readSystemList(path);
+        
+        if (cpus.empty() == true) {
+            return false;
+        }
+        
+        cpu_set_t cpuSet;
+        CPU_ZERO(&cpuSet);
+        
+        vector<size_t>::const_iterator cpuIterator;
+        
+        for (cpuIterator = cpus.begin(); cpuIterator != cpus.end(); ++cpuIterator) {
+            
+            if (*cpuIterator < CPU_SETSIZE) {
+                CPU_SET(*cpuIterator, &cpuSet);
+            }
+        }
+        
+        return sched_setaffinity(0, sizeof(cpuSet), &cpuSet) == 0;
+#else
+        return false;
+#endif
+    }
+    
+    MappedFileMemoryResource::MappedFileMemoryResource(const string& path):file(-1), pageSize((size_t)sysconf(_SC_PAGESIZE)), fileSize(0) {
+        
+        this->file = open(path.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0600);
+        
+        //The open descriptor keeps the file alive, nothing is left behind even when the process dies.
+        if (this->file >= 0) {
+            unlink(path.c_str());
+        }
+    }
+    
+    MappedFileMemoryResource::~MappedFileMemoryResource() {
+        
+        if (this->file >= 0) {
+            close(this->file);
+        }
+    }
+    
+    //Every allocation gets a new range at the end of the file, the mappings stay valid whatever is mapped after them.
+    void* MappedFileMemoryResource::allocate(size_t size, size_t alignment) {
+        
+        assert(alignment <= this->pageSize);
+        
+        if (this->file < 0) {
+            throw bad_alloc();
+        }
+        
+        size_t mappingSize = this->getMappingSize(size);
+        size_t offset = 0;
+        
+        {
+            lock_guard<mutex> lock(this->fileMutex);
+            
+            offset = this->fileSize;
+            
+            if (ftruncate(this->file, (off_t)(offset + mappingSize)) != 0) {
+                throw bad_alloc();
+            }
+            
+            this->fileSize = offset + mappingSize;
+        }
+        
+        void* memory = mmap(NULL, mappingSize, PROT_READ | PROT_WRITE, MAP_SHARED, this->file, (off_t)offset);
+        
+        if (memory == MAP_FAILED) {
+            throw bad_alloc();
+        }
+        
+        return memory;
+    }
+    
+    void MappedFileMemoryResource::deallocate(void* memory, size_t size, size_t) {
+        
+        size_t mappingSize = this->getMappingSize(size);
+        
+        //Frees the disk blocks of the range without writing the dirty pages back first.
+#ifdef MADV_REMOVE
+        madvise(memory, mappingSize, MADV_REMOVE);
+#endif
+        
+        munmap(memory, mappingSize);
+    }
+    
+    size_t MappedFileMemoryResource::getFileSize() const {
+        
+        lock_guard<mutex> lock(this->fileMutex);
+        
+        return this->fileSize;
+    }
+    
+    size_t MappedFileMemoryResource::getMappingSize(size_t size) const {
+        return (size + this->pageSize - 1) / this->pageSize * this->pageSize;
+    }
+    
+    MonotonicArena::MonotonicArena(size_t blockSize, MemoryResource* upstream):blockSize(blockSize), upstream(upstream == NULL ? MemoryResource::getDefaultResource() : upstream), reservedSize(0), current(NULL), remainingSize(0) {
+    
+    }
+    
+    MonotonicArena::~MonotonicArena() {
+        this->release();
+    }
+    
+    void* MonotonicArena::allocate(size_t size, size_t alignment) {
+        
+        size_t padding = (alignment - (size_t)this->current % alignment) % alignment;
+        
+        if (this->current == NULL || padding + size > this->remainingSize) {
+            
+            Block block;
+            block.size = max(this->blockSize, size + alignment);
+            block.memory = static_cast<char*>(this->upstream->allocate(block.size, BlockAlignment));
+            
+            this->blocks.push_back(block);
+            this->reservedSize += block.size;
+            
+            this->current = block.memory;
+            this->remainingSize = block.size;
+            
+            padding = (alignment - (size_t)this->current % alignment) % alignment;
+        }
+        
+        char* memory = this->current + padding;
+        
+        this->current += padding + size;
+        this->remainingSize -= padding + size;
+        
+        return memory;
+    }
+    
+    void MonotonicArena::deallocate(void*, size_t, size_t) {
+    
+    }
+    
+    void MonotonicArena::release() {
+        
+        vector<Block>::const_iterator blockIterator;
+        
+        for (blockIterator = this->blocks.begin(); blockIterator != this->blocks.end(); ++blockIterator) {
+            this->upstream->deallocate((*blockIterator).memory, (*blockIterator).size, BlockAlignment);
+        }
+        
+        this->blocks.clear();
+        this->reservedSize = 0;
+        
+        this->current = NULL;
+        this->remainingSize = 0;
+    }
+}
\ No newline at end of file
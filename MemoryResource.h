@@ -0,0 +1,266 @@
+#ifndef __MEMORY_RESOURCE_H__
+#define __MEMORY_RESOURCE_H__
+
+#include <cstddef>
+#include <vector>
+#include <memory>
+#include <type_traits>
+#include <atomic>
+#include <mutex>
+#include <string>
+
+namespace std {
+    
+    using namespace std;
+    
+    //Where the large buffers of a tree come from. Allocations are few and big, a resource does not need to be fast for small sizes.
+    class MemoryResource {
+        
+    public:
+        
+        virtual ~MemoryResource();
+        
+        virtual void* allocate(size_t size, size_t alignment) = 0;
+        virtual void deallocate(void* memory, size_t size, size_t alignment) = 0;
+        
+        //posix_memalign and free, used wherever no resource is given.
+        static MemoryResource* getDefaultResource();
+    };
+    
+    class HeapMemoryResource: public MemoryResource {
+        
+    public:
+        
+        void* allocate(size_t size, size_t alignment);
+        void deallocate(void* memory, size_t size, size_t alignment);
+    };
+    
+    enum PagePolicy {
+        DefaultPages,
+        //Asks the kernel to back the mapping with transparent huge pages, it may still use small pages when none are free.
+        TransparentHugePages,
+        //Maps from the reserved hugetlbfs pool, falls back to transparent huge pages when the pool is empty.
+        ExplicitHugePages
+    };
+    
+    enum NumaPolicy {
+        //Pages land on the node of the thread that first touches them.
+        LocalNumaPolicy,
+        //Pages are spread round robin over all nodes, every thread sees the same average latency.
+        InterleavedNumaPolicy,
+        //Pages come from the given node while it has free memory, from another one afterwards.
+        PreferredNodeNumaPolicy
+    };
+    
+    //Maps every allocation with mmap, so page size and NUMA placement can be chosen per mapping before any page is touched.
+    //Placement is a hint: on kernels or systems without huge pages or NUMA the memory is still returned, on ordinary pages.
+    class PageMemoryResource: public MemoryResource {
+        
+    public:
+        
+        static const size_t HugePageSize = 2 << 20;
+        
+        PageMemoryResource(PagePolicy pagePolicy = TransparentHugePages, NumaPolicy numaPolicy = LocalNumaPolicy, size_t numaNode = 0);
+        
+        //Alignments up to the page size are honoured, mappings are page aligned.
+        void* allocate(size_t size, size_t alignment);
+        void deallocate(void* memory, size_t size, size_t alignment);
+        
+        inline PagePolicy getPagePolicy() const {
+            return this->pagePolicy;
+        }
+        
+        inline NumaPolicy getNumaPolicy() const {
+            return this->numaPolicy;
+        }
+        
+        inline size_t getNumaNode() const {
+            return this->numaNode;
+        }
+        
+        //Explicit huge page mappings that had to fall back because the pool was empty.
+        inline size_t getFallbacksNumber() const {
+            return this->fallbacksNumber.load();
+        }
+        
+        //Nodes the system reports online, 1 without NUMA.
+        static size_t getNumaNodesNumber();
+        
+        //Node of the cpu the calling thread runs on.
+        static size_t getCurrentNumaNode();
+        
+        //Restricts the calling thread to the cpus of the node, returns false when the affinity cannot be set.
+        static bool pinThreadToNumaNode(size_t numaNode);
+        
+    private:
+        
+        PageMemoryResource(const PageMemoryResource& rhs);
+        PageMemoryResource& operator=(const PageMemoryResource& rhs);
+        
+        PagePolicy pagePolicy;
+        NumaPolicy numaPolicy;
+        size_t numaNode;
+        
+        atomic<size_t> fallbacksNumber;
+        
+        size_t getMappingSize(size_t size) const;
+        void applyNumaPolicy(void* memory, size_t size) const;
+    };
+    
+    //Maps every allocation from a file on disk. The kernel writes the pages back to the file and drops them from memory under pressure, so the buffers may be larger than RAM and stay resident only while they are read.
+    //Meant for data read rarely, such as the full precision points of a quantized tree given to KdTree::setExactPointsResource.
+    //The file is scratch storage: it is created or truncated and unlinked at once, its space goes back to the file system with the deallocations and the resource.
+    class MappedFileMemoryResource: public MemoryResource {
+        
+    public:
+        
+        //The path should be on a disk backed file system, a file on tmpfs lives in memory again.
+        MappedFileMemoryResource(const string& path);
+        
+        ~MappedFileMemoryResource();
+        
+        //Alignments up to the page size are honoured, mappings are page aligned. Throws bad_alloc when the file could not be opened or grown.
+        void* allocate(size_t size, size_t alignment);
+        void deallocate(void* memory, size_t size, size_t alignment);
+        
+        inline bool isOpen() const {
+            return this->file >= 0;
+        }
+        
+        //Bytes the file has grown to, deallocated ranges are holes that no longer use disk space.
+        size_t getFileSize() const;
+        
+    private:
+        
+        MappedFileMemoryResource(const MappedFileMemoryResource& rhs);
+        MappedFileMemoryResource& operator=(const MappedFileMemoryResource& rhs);
+        
+        int file;
+        size_t pageSize;
+        
+        //Shards build in parallel from one prototype, so its resources are shared between threads.
+        mutable mutex fileMutex;
+        size_t fileSize;
+        
+        size_t getMappingSize(size_t size) const;
+    };
+    
+    //Hands out memory from large blocks by bumping a pointer, deallocation does nothing and the blocks are only freed together.
+    //A tree built into its own arena is freed in one step per block however many buffers it holds. Not thread safe, a build allocates from one thread.
+    class MonotonicArena: public MemoryResource {
+        
+    public:
+        
+        static const size_t DefaultBlockSize = 64 << 20;
+        
+        //Blocks come from the upstream resource, the default one when it is NULL. Requests larger than a block get a block of their own.
+        MonotonicArena(size_t blockSize = DefaultBlockSize, MemoryResource* upstream = NULL);
+        
+        ~MonotonicArena();
+        
+        void* allocate(size_t size, size_t alignment);
+        void deallocate(void* memory, size_t size, size_t alignment);
+        
+        //Frees every block, memory handed out before must no longer be used.
+        void release();
+        
+        inline size_t getBlocksNumber() const {
+            return this->blocks.size();
+        }
+        
+        //Bytes reserved from the upstream resource.
+        inline size_t getReservedSize() const {
+            return this->reservedSize;
+        }
+        
+    private:
+        
+        MonotonicArena(const MonotonicArena& rhs);
+        MonotonicArena& operator=(const MonotonicArena& rhs);
+        
+        struct Block {
+            char* memory;
+            size_t size;
+        };
+        
+        static const size_t BlockAlignment = 4096;
+        
+        size_t blockSize;
+        MemoryResource* upstream;
+        
+        vector<Block> blocks;
+        size_t reservedSize;
+        
+        char* current;
+        size_t remainingSize;
+    };
+    
+    //Standard allocator on top of a resource, containers with these allocators move their resource along on copy assignment and swap.
+    //Every allocation is aligned to a cache line like AlignedAllocator.
+    template<typename T>
+    class ResourceAllocator {
+        
+    public:
+        
+        typedef T value_type;
+        typedef true_type propagate_on_container_copy_assignment;
+        typedef true_type propagate_on_container_move_assignment;
+        typedef true_type propagate_on_container_swap;
+        
+        static const size_t Alignment = 64;
+        
+        template<typename U>
+        struct rebind {
+            typedef ResourceAllocator<U> other;
+        };
+        
+        ResourceAllocator():resource(MemoryResource::getDefaultResource()) {
+        
+        }
+        
+        ResourceAllocator(MemoryResource* resource):resource(resource == NULL ? MemoryResource::getDefaultResource() : resource) {
+        
+        }
+        
+        template<typename U>
+        ResourceAllocator(const ResourceAllocator<U>& rhs):resource(rhs.getResource()) {
+        
+        }
+        
+        T* allocate(size_t size) {
+            
+            if (size == 0) {
+                return NULL;
+            }
+            
+            return static_cast<T*>(this->resource->allocate(size * sizeof(T), Alignment));
+        }
+        
+        void deallocate(T* memory, size_t size) {
+            
+            if (memory != NULL) {
+                this->resource->deallocate(memory, size * sizeof(T), Alignment);
+            }
+        }
+        
+        inline MemoryResource* getResource() const {
+            return this->resource;
+        }
+        
+        template<typename U>
+        bool operator==(const ResourceAllocator<U>& rhs) const {
+            return this->resource == rhs.getResource();
+        }
+        
+        template<typename U>
+        bool operator!=(const ResourceAllocator<U>& rhs) const {
+            return this->resource != rhs.getResource();
+        }
+        
+    private:
+        
+        MemoryResource* resource;
+    };
+}
+
+#endif
\ No newline at end of file
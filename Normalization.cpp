@@ -0,0 +1,220 @@
+#include "Normalization.h"
+#include "Statistics.h"
+#include <cmath>
+#include <thread>
+#include <functional>
+
+namespace std {
+    
+    FeatureNormalizer::FeatureNormalizer():normalizationType(NoNormalization) {
+    
+    }
+    
+    FeatureNormalizer::FeatureNormalizer(NormalizationType normalizationType, const vector<FeatureType>& offsets, const vector<FeatureType>& scales):normalizationType(normalizationType), offsets(offsets), scales(scales) {
+        
+        assert(offsets.size() == scales.size());
+    }
+    
+    FeatureNormalizer::FeatureNormalizer(const FeatureNormalizer& rhs):normalizationType(rhs.normalizationType), offsets(rhs.offsets), scales(rhs.scales) {
+    
+    }
+    
+    FeatureNormalizer& FeatureNormalizer::operator=(const FeatureNormalizer& rhs) {
+        FeatureNormalizer temp(rhs);
+        this->swap(temp);
+        return *this;
+    }
+    
+    FeatureNormalizer::~FeatureNormalizer() {
+    
+    }
+    
+    void FeatureNormalizer::swap(FeatureNormalizer& other) {
+        using std::swap;
+        swap(this->normalizationType, other.normalizationType);
+        swap(this->offsets, other.offsets);
+        swap(this->scales, other.scales);
+    }
+    
+    static void accumulateRows(const PointBuffer& points, size_t pointBegin, size_t pointEnd, Math::StatisticsAccumulator& statistics) {
+        
+        if (pointBegin < pointEnd) {
+            statistics.addRows(points.getPoint(pointBegin), pointEnd - pointBegin);
+        }
+    }
+    
+    void FeatureNormalizer::fit(const PointBuffer& points, NormalizationType normalizationType) {
+        
+        this->clear();
+        
+        this->normalizationType = normalizationType;
+        
+        if (normalizationType == NoNormalization || normalizationType == L2Normalization || points.isEmpty() == true) {
+            return;
+        }
+        
+        size_t pointNumber = points.getPointNumber();
+        DimensionNumber dimensionNumber = points.getDimensionNumber();
+        
+        size_t threadsNumber = max((size_t)thread::hardware_concurrency(), (size_t)1);
+        threadsNumber = max(min(threadsNumber, pointNumber / ParallelFitPointsNumber), (size_t)1);
+        
+        vector<Math::StatisticsAccumulator> partialStatistics(threadsNumber, Math::StatisticsAccumulator(dimensionNumber));
+        vector<thread> threads;
+        
+        size_t pointsPerThread = (pointNumber + threadsNumber - 1) / threadsNumber;
+        
+        for (size_t threadIndex = 1; threadIndex < threadsNumber; ++threadIndex) {
+            
+            size_t pointBegin = min(threadIndex * pointsPerThread, pointNumber);
+            size_t pointEnd = min(pointBegin + pointsPerThread, pointNumber);
+            
+            threads.push_back(thread(accumulateRows, cref(points), pointBegin, pointEnd, ref(partialStatistics[threadIndex])));
+        }
+        
+        accumulateRows(points, 0, min(pointsPerThread, pointNumber), partialStatistics[0]);
+        
+        vector<thread>::iterator threadIterator;
+        
+        for (threadIterator = threads.begin(); threadIterator != threads.end(); ++threadIterator) {
+            (*threadIterator).join();
+        }
+        
+        for (size_t threadIndex = 1; threadIndex < threadsNumber; ++threadIndex) {
+            partialStatistics[0].merge(partialStatistics[threadIndex]);
+        }
+        
+        const Math::StatisticsAccumulator& statistics = partialStatistics[0];
+        
+        this->offsets.resize(dimensionNumber);
+        this->scales.resize(dimensionNumber);
+        
+        for (DimensionNumber index = 0; index < dimensionNumber; ++index) {
+            
+            FeatureType offset = 0;
+            FeatureType scale = 0;
+            
+            if (normalizationType == ZScoreNormalization) {
+                offset = statistics.getMean(index);
+                scale = sqrt(statistics.getVariance(index));
+            } else {
+                offset = statistics.getMinValue(index);
+                scale = statistics.getMaxValue(index) - statistics.getMinValue(index);
+            }
+            
+            //Constant dimensions are only shifted.
+            if (scale == 0) {
+                scale = 1;
+            }
+            
+            this->offsets[index] = offset;
+            this->scales[index] = scale;
+        }
+    }
+    
+    void FeatureNormalizer::clear() {
+        
+        FeatureNormalizer empty;
+        this->swap(empty);
+    }
+    
+    void FeatureNormalizer::apply(const FeatureType* features, FeatureType* normalized, DimensionNumber dimensionNumber) const {
+        
+        if (this->normalizationType == L2Normalization) {
+            
+            FeatureType squaredNorm = 0;
+            
+            for (DimensionNumber index = 0; index < dimensionNumber; ++index) {
+                squaredNorm += features[index] * features[index];
+            }
+            
+            //The zero vector has no direction and stays as it is.
+            FeatureType reciprocalNorm = squaredNorm > 0 ? 1 / sqrt(squaredNorm) : 1;
+            
+            for (DimensionNumber index = 0; index < dimensionNumber; ++index) {
+                normalized[index] = features[index] * reciprocalNorm;
+            }
+            
+        } else if (this->normalizationType != NoNormalization) {
+            
+            assert(dimensionNumber == this->offsets.size());
+            
+            for (DimensionNumber index = 0; index < dimensionNumber; ++index) {
+                normalized[index] = (features[index] - this->offsets[index]) / this->scales[index];
+            }
+            
+        } else if (normalized != features) {
+            copy(features, features + dimensionNumber, normalized);
+        }
+    }
+    
+    void FeatureNormalizer::apply(const vector<FeatureType>& features, vector<FeatureType>& normalized) const {
+        
+        normalized.resize(features.size());
+        
+        this->apply(features.data(), normalized.data(), features.size());
+    }
+    
+    void FeatureNormalizer::apply(PointBuffer& points) const {
+        
+        if (this->normalizationType == NoNormalization) {
+            return;
+        }
+        
+        DimensionNumber dimensionNumber = points.getDimensionNumber();
+        
+        for (PointIndexType pointIndex = 0; pointIndex < points.getPointNumber(); ++pointIndex) {
+            
+            FeatureType* point = points.getPoint(pointIndex);
+            
+            this->apply(point, point, dimensionNumber);
+        }
+    }
+    
+    FeatureType FeatureNormalizer::normalizedSquaredDistance(const FeatureType* normalizedFeatures, const FeatureType* point, DimensionNumber dimensionNumber) const {
+        
+        FeatureType distance = 0;
+        
+        if (this->normalizationType == L2Normalization) {
+            
+            FeatureType squaredNorm = 0;
+            
+            for (DimensionNumber index = 0; index < dimensionNumber; ++index) {
+                squaredNorm += point[index] * point[index];
+            }
+            
+            FeatureType reciprocalNorm = squaredNorm > 0 ? 1 / sqrt(squaredNorm) : 1;
+            
+            for (DimensionNumber index = 0; index < dimensionNumber; ++index) {
+                
+                FeatureType difference = normalizedFeatures[index] - point[index] * reciprocalNorm;
+                distance += difference * difference;
+            }
+            
+        } else if (this->normalizationType != NoNormalization) {
+            
+            for (DimensionNumber index = 0; index < dimensionNumber; ++index) {
+                
+                FeatureType difference = normalizedFeatures[index] - (point[index] - this->offsets[index]) / this->scales[index];
+                distance += difference * difference;
+            }
+            
+        } else {
+            
+            for (DimensionNumber index = 0; index < dimensionNumber; ++index) {
+                
+                FeatureType difference = normalizedFeatures[index] - point[index];
+                distance += difference * difference;
+            }
+        }
+        
+        return distance;
+    }
+}
+
+namespace std {
+    template<>
+    void swap<std::FeatureNormalizer>(std::FeatureNormalizer& a, std::FeatureNormalizer& b) {
+        a.swap(b);
+    }
+}
\ No newline at end of file
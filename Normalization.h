@@ -0,0 +1,78 @@
+#ifndef __NORMALIZATION_H__
+#define __NORMALIZATION_H__
+
+#include <vector>
+#include "assert.h"
+#include "PointBuffer.h"
+
+namespace std {
+    
+    using namespace std;
+    
+    enum NormalizationType {
+        NoNormalization,
+        ZScoreNormalization,
+        MinMaxNormalization,
+        L2Normalization
+    };
+    
+    //Maps features to (feature - offset) / scale per dimension, or divides every point by its Euclidean norm.
+    //Parameters are fitted once on the dataset and then applied to the points and to every query, so a normalized search costs the same as a plain one.
+    class FeatureNormalizer {
+    
+    public:
+        
+        FeatureNormalizer();
+        
+        //Restores parameters fitted before, offsets and scales are ignored for L2 normalization.
+        FeatureNormalizer(NormalizationType normalizationType, const vector<FeatureType>& offsets, const vector<FeatureType>& scales);
+        
+        FeatureNormalizer(const FeatureNormalizer& rhs);
+        FeatureNormalizer& operator=(const FeatureNormalizer& rhs);
+        
+        ~FeatureNormalizer();
+        
+        void swap(FeatureNormalizer& other);
+        
+        //Large datasets are scanned by several threads whose statistics are merged.
+        void fit(const PointBuffer& points, NormalizationType normalizationType);
+        void clear();
+        
+        inline NormalizationType getNormalizationType() const {
+            return this->normalizationType;
+        }
+        
+        inline const vector<FeatureType>& getOffsets() const {
+            return this->offsets;
+        }
+        
+        inline const vector<FeatureType>& getScales() const {
+            return this->scales;
+        }
+        
+        //Normalized may be the features themselves.
+        void apply(const FeatureType* features, FeatureType* normalized, DimensionNumber dimensionNumber) const;
+        void apply(const vector<FeatureType>& features, vector<FeatureType>& normalized) const;
+        void apply(PointBuffer& points) const;
+        
+        //Squared distance between already normalized features and a point normalized on the fly.
+        FeatureType normalizedSquaredDistance(const FeatureType* normalizedFeatures, const FeatureType* point, DimensionNumber dimensionNumber) const;
+        
+    private:
+        
+        //Rows per thread below which fitting stays on the calling thread.
+        static const size_t ParallelFitPointsNumber = 65536;
+        
+        NormalizationType normalizationType;
+        
+        vector<FeatureType> offsets;
+        vector<FeatureType> scales;
+    };
+}
+
+namespace std {
+    template<>
+    void swap<std::FeatureNormalizer>(std::FeatureNormalizer& a, std::FeatureNormalizer& b);
+}
+
+#endif
\ No newline at end of file
@@ -0,0 +1,95 @@
+#include "PointBuffer.h"
+
+namespace std {
+    
+    PointBuffer::PointBuffer():pointNumber(0), dimensionNumber(0) {
+    
+    }
+    
+    PointBuffer::PointBuffer(const vector< vector<FeatureType> >& featuresVector):pointNumber(0), dimensionNumber(0) {
+        this->assign(featuresVector);
+    }
+    
+    PointBuffer::PointBuffer(const PointBuffer& rhs):data(rhs.data), pointNumber(rhs.pointNumber), dimensionNumber(rhs.dimensionNumber) {
+    
+    }
+    
+    PointBuffer::PointBuffer(const PointBuffer& rhs, MemoryResource* memoryResource):data(rhs.data.begin(), rhs.data.end(), ResourceAllocator<FeatureType>(memoryResource)), pointNumber(rhs.pointNumber), dimensionNumber(rhs.dimensionNumber) {
+    
+    }
+    
+    PointBuffer& PointBuffer::operator=(const PointBuffer& rhs) {
+        PointBuffer temp(rhs);
+        this->swap(temp);
+        return *this;
+    }
+    
+    PointBuffer::~PointBuffer() {
+    
+    }
+    
+    void PointBuffer::swap(PointBuffer& other) {
+        using std::swap;
+        swap(this->data, other.data);
+        swap(this->pointNumber, other.pointNumber);
+        swap(this->dimensionNumber, other.dimensionNumber);
+    }
+    
+    void PointBuffer::assign(const vector< vector<FeatureType> >& featuresVector) {
+        
+        this->clear();
+        
+        if (featuresVector.size() == 0) {
+            return;
+        }
+        
+        this->pointNumber = featuresVector.size();
+        this->dimensionNumber = featuresVector.at(0).size();
+        
+        this->data.reserve(this->pointNumber * this->dimensionNumber);
+        
+        vector< vector<FeatureType> >::const_iterator featuresIterator;
+        
+        for (featuresIterator = featuresVector.begin(); featuresIterator != featuresVector.end(); ++featuresIterator) {
+            
+            assert((*featuresIterator).size() == this->dimensionNumber);
+            this->data.insert(this->data.end(), (*featuresIterator).begin(), (*featuresIterator).end());
+        }
+    }
+    
+    void PointBuffer::assign(const FeatureType* data, size_t pointNumber, DimensionNumber dimensionNumber) {
+        
+        this->clear();
+        
+        if (pointNumber == 0) {
+            return;
+        }
+        
+        this->data.assign(data, data + pointNumber * dimensionNumber);
+        
+        this->pointNumber = pointNumber;
+        this->dimensionNumber = dimensionNumber;
+    }
+    
+    void PointBuffer::setMemoryResource(MemoryResource* memoryResource) {
+        
+        PointBufferData resourceData(this->data.begin(), this->data.end(), ResourceAllocator<FeatureType>(memoryResource));
+        this->data.swap(resourceData);
+    }
+    
+    void PointBuffer::clear() {
+        
+        PointBufferData empty(this->data.get_allocator());
+        this->data.swap(empty);
+        
+        this->pointNumber = 0;
+        this->dimensionNumber = 0;
+    }
+}
+
+namespace std {
+    template<>
+    void swap<std::PointBuffer>(std::PointBuffer& a, std::PointBuffer& b) {
+        a.swap(b);
+    }
+}
\ No newline at end of file
@@ -0,0 +1,104 @@
+#ifndef __POINT_BUFFER_H__
+#define __POINT_BUFFER_H__
+
+#include <vector>
+#include "assert.h"
+#include "MemoryResource.h"
+
+namespace std {
+    
+    using namespace std;
+    
+    typedef double FeatureType;
+    typedef size_t DimensionNumber;
+    typedef size_t PointIndexType;
+    typedef vector<FeatureType, ResourceAllocator<FeatureType> > PointBufferData;
+    
+    //All points stored row by row in one contiguous buffer, point i occupies [i * dimensionNumber, (i + 1) * dimensionNumber).
+    class PointBuffer {
+    
+    public:
+        
+        PointBuffer();
+        
+        PointBuffer(const vector< vector<FeatureType> >& featuresVector);
+        
+        PointBuffer(const PointBuffer& rhs);
+        PointBuffer& operator=(const PointBuffer& rhs);
+        
+        //Copy allocated from another resource, the default one when it is NULL.
+        PointBuffer(const PointBuffer& rhs, MemoryResource* memoryResource);
+        
+        ~PointBuffer();
+        
+        void swap(PointBuffer& other);
+        
+        void assign(const vector< vector<FeatureType> >& featuresVector);
+        
+        //Copies pointNumber points already laid out row by row.
+        void assign(const FeatureType* data, size_t pointNumber, DimensionNumber dimensionNumber);
+        void clear();
+        
+        //Following assigns allocate from the resource, the default one when it is NULL. The resource must outlive the buffer.
+        void setMemoryResource(MemoryResource* memoryResource);
+        
+        inline MemoryResource* getMemoryResource() const {
+            return this->data.get_allocator().getResource();
+        }
+        
+        inline size_t getPointNumber() const {
+            return this->pointNumber;
+        }
+        
+        inline DimensionNumber getDimensionNumber() const {
+            return this->dimensionNumber;
+        }
+        
+        inline bool isEmpty() const {
+            return this->pointNumber == 0;
+        }
+        
+        inline const FeatureType* getPoint(PointIndexType pointIndex) const {
+            
+            assert(pointIndex < this->pointNumber);
+            
+            return &(this->data[pointIndex * this->dimensionNumber]);
+        }
+        
+        //For transformations that rewrite the points in place.
+        inline FeatureType* getPoint(PointIndexType pointIndex) {
+            
+            assert(pointIndex < this->pointNumber);
+            
+            return &(this->data[pointIndex * this->dimensionNumber]);
+        }
+        
+        inline FeatureType getFeature(PointIndexType pointIndex, DimensionNumber dimensionIndex) const {
+            
+            assert(pointIndex < this->pointNumber && dimensionIndex < this->dimensionNumber);
+            
+            return this->data[pointIndex * this->dimensionNumber + dimensionIndex];
+        }
+        
+        inline const vector<FeatureType> getFeatures(PointIndexType pointIndex) const {
+            
+            const FeatureType* point = this->getPoint(pointIndex);
+            
+            return vector<FeatureType>(point, point + this->dimensionNumber);
+        }
+    
+    private:
+        
+        PointBufferData data;
+        
+        size_t pointNumber;
+        DimensionNumber dimensionNumber;
+    };
+}
+
+namespace std {
+    template<>
+    void swap<std::PointBuffer>(std::PointBuffer& a, std::PointBuffer& b);
+}
+
+#endif
\ No newline at end of file
@@ -0,0 +1,259 @@
+#include "Quantization.h"
+#include "Statistics.h"
+#include <cmath>
+#include <cstring>
+
+namespace std {
+    
+    Float16CodeType floatToHalf(float value) {
+        
+        unsigned int bits = 0;
+        memcpy(&bits, &value, sizeof(bits));
+        
+        unsigned int sign = (bits >> 16) & 0x8000;
+        int exponent = (int)((bits >> 23) & 0xff) - 127 + 15;
+        unsigned int mantissa = bits & 0x7fffff;
+        
+        //NaN keeps a quiet NaN, overflow saturates to infinity.
+        if ((bits & 0x7fffffff) > 0x7f800000) {
+            return (Float16CodeType)(sign | 0x7e00);
+        }
+        
+        if (exponent >= 31) {
+            return (Float16CodeType)(sign | 0x7c00);
+        }
+        
+        if (exponent <= 0) {
+            
+            if (exponent < -10) {
+                return (Float16CodeType)sign;
+            }
+            
+            mantissa |= 0x800000;
+            
+            unsigned int shift = (unsigned int)(14 - exponent);
+            unsigned int half = mantissa >> shift;
+            
+            if ((mantissa >> (shift - 1)) & 1) {
+                ++half;
+            }
+            
+            return (Float16CodeType)(sign | half);
+        }
+        
+        unsigned int half = sign | ((unsigned int)exponent << 10) | (mantissa >> 13);
+        
+        //Round to nearest, a carry into the exponent is the correct result.
+        if (mantissa & 0x1000) {
+            ++half;
+        }
+        
+        return (Float16CodeType)half;
+    }
+    
+    //Shifting the exponent and mantissa into a float and scaling by 2^112 rebases the exponent, subnormal halves land on subnormal floats and come out right as well. Only infinity and NaN need their exponent forced.
+    static inline float decodeHalf(Float16CodeType code) {
+        
+        unsigned int bits = ((unsigned int)code & 0x7fff) << 13;
+        
+        float value = 0;
+        memcpy(&value, &bits, sizeof(value));
+        
+        value *= 5.192296858534828e+33f;
+        memcpy(&bits, &value, sizeof(bits));
+        
+        bits |= ((unsigned int)code & 0x7c00) == 0x7c00 ? 0x7f800000 : 0;
+        bits |= ((unsigned int)code & 0x8000) << 16;
+        
+        memcpy(&value, &bits, sizeof(value));
+        
+        return value;
+    }
+    
+    float halfToFloat(Float16CodeType code) {
+        return decodeHalf(code);
+    }
+    
+    QuantizedPointBuffer::QuantizedPointBuffer():quantizationType(NoQuantization), pointNumber(0), dimensionNumber(0) {
+    
+    }
+    
+    QuantizedPointBuffer::QuantizedPointBuffer(const QuantizedPointBuffer& rhs):quantizationType(rhs.quantizationType), int8Codes(rhs.int8Codes), float16Codes(rhs.float16Codes), offsets(rhs.offsets), scales(rhs.scales), pointNumber(rhs.pointNumber), dimensionNumber(rhs.dimensionNumber) {
+    
+    }
+    
+    QuantizedPointBuffer::QuantizedPointBuffer(const QuantizedPointBuffer& rhs, MemoryResource* memoryResource):quantizationType(rhs.quantizationType), int8Codes(rhs.int8Codes.begin(), rhs.int8Codes.end(), ResourceAllocator<Int8CodeType>(memoryResource)), float16Codes(rhs.float16Codes.begin(), rhs.float16Codes.end(), ResourceAllocator<Float16CodeType>(memoryResource)), offsets(rhs.offsets), scales(rhs.scales), pointNumber(rhs.pointNumber), dimensionNumber(rhs.dimensionNumber) {
+    
+    }
+    
+    QuantizedPointBuffer& QuantizedPointBuffer::operator=(const QuantizedPointBuffer& rhs) {
+        QuantizedPointBuffer temp(rhs);
+        this->swap(temp);
+        return *this;
+    }
+    
+    QuantizedPointBuffer::~QuantizedPointBuffer() {
+    
+    }
+    
+    void QuantizedPointBuffer::swap(QuantizedPointBuffer& other) {
+        using std::swap;
+        swap(this->quantizationType, other.quantizationType);
+        swap(this->int8Codes, other.int8Codes);
+        swap(this->float16Codes, other.float16Codes);
+        swap(this->offsets, other.offsets);
+        swap(this->scales, other.scales);
+        swap(this->pointNumber, other.pointNumber);
+        swap(this->dimensionNumber, other.dimensionNumber);
+    }
+    
+    void QuantizedPointBuffer::build(const PointBuffer& points, QuantizationType quantizationType) {
+        
+        this->clear();
+        
+        if (quantizationType == NoQuantization || points.isEmpty() == true) {
+            return;
+        }
+        
+        this->quantizationType = quantizationType;
+        this->pointNumber = points.getPointNumber();
+        this->dimensionNumber = points.getDimensionNumber();
+        
+        size_t size = this->pointNumber * this->dimensionNumber;
+        
+        if (quantizationType == Int8Quantization) {
+            this->int8Codes.resize(size);
+        } else {
+            this->float16Codes.resize(size);
+        }
+        
+        this->offsets.resize(this->dimensionNumber);
+        this->scales.resize(this->dimensionNumber);
+        
+        Math::StatisticsAccumulator statistics(this->dimensionNumber);
+        statistics.addRows(points.getPoint(0), this->pointNumber);
+        
+        for (DimensionNumber dimensionIndex = 0; dimensionIndex < this->dimensionNumber; ++dimensionIndex) {
+            
+            FeatureType minValue = statistics.getMinValue(dimensionIndex);
+            FeatureType maxValue = statistics.getMaxValue(dimensionIndex);
+            
+            FeatureType offset = 0;
+            FeatureType scale = 0;
+            
+            if (quantizationType == Int8Quantization) {
+                
+                //Codes 0..255 cover [min, max] and are stored shifted into the signed range.
+                offset = minValue;
+                scale = (maxValue - minValue) / 255;
+            
+            } else {
+                
+                //Halves are centred on the mean and scaled into [-1, 1] where their relative precision is best used.
+                offset = statistics.getMean(dimensionIndex);
+                scale = max(fabs(maxValue - offset), fabs(minValue - offset));
+            }
+            
+            if (scale == 0) {
+                scale = 1;
+            }
+            
+            this->offsets[dimensionIndex] = offset;
+            this->scales[dimensionIndex] = scale;
+        }
+        
+        for (PointIndexType pointIndex = 0; pointIndex < this->pointNumber; ++pointIndex) {
+            
+            const FeatureType* point = points.getPoint(pointIndex);
+            
+            for (DimensionNumber dimensionIndex = 0; dimensionIndex < this->dimensionNumber; ++dimensionIndex) {
+                
+                size_t position = pointIndex * this->dimensionNumber + dimensionIndex;
+                FeatureType code = (point[dimensionIndex] - this->offsets[dimensionIndex]) / this->scales[dimensionIndex];
+                
+                if (quantizationType == Int8Quantization) {
+                    
+                    long roundedCode = (long)floor(code + 0.5);
+                    roundedCode = min(max(roundedCode, 0L), 255L);
+                    
+                    this->int8Codes[position] = (Int8CodeType)(roundedCode - 128);
+                } else {
+                    this->float16Codes[position] = floatToHalf((float)code);
+                }
+            }
+        }
+    }
+    
+    void QuantizedPointBuffer::clear() {
+        
+        Int8CodeVector emptyInt8Codes(this->int8Codes.get_allocator());
+        Float16CodeVector emptyFloat16Codes(this->float16Codes.get_allocator());
+        
+        this->int8Codes.swap(emptyInt8Codes);
+        this->float16Codes.swap(emptyFloat16Codes);
+        
+        this->offsets.clear();
+        this->scales.clear();
+        
+        this->quantizationType = NoQuantization;
+        this->pointNumber = 0;
+        this->dimensionNumber = 0;
+    }
+    
+    void QuantizedPointBuffer::setMemoryResource(MemoryResource* memoryResource) {
+        
+        Int8CodeVector resourceInt8Codes(this->int8Codes.begin(), this->int8Codes.end(), ResourceAllocator<Int8CodeType>(memoryResource));
+        Float16CodeVector resourceFloat16Codes(this->float16Codes.begin(), this->float16Codes.end(), ResourceAllocator<Float16CodeType>(memoryResource));
+        
+        this->int8Codes.swap(resourceInt8Codes);
+        this->float16Codes.swap(resourceFloat16Codes);
+    }
+    
+    //The type is checked once per point, the row is then decoded in a loop without branches.
+    QuantizedDistanceType QuantizedPointBuffer::squaredDistance(const vector<FeatureType>& features, PointIndexType pointIndex) const {
+        
+        assert(features.size() == this->dimensionNumber);
+        assert(pointIndex < this->pointNumber);
+        
+        const FeatureType* offsets = this->offsets.data();
+        const FeatureType* scales = this->scales.data();
+        
+        size_t position = pointIndex * this->dimensionNumber;
+        
+        QuantizedDistanceType distance = 0;
+        
+        if (this->quantizationType == Int8Quantization) {
+            
+            const Int8CodeType* codes = &(this->int8Codes[position]);
+            
+            for (DimensionNumber dimensionIndex = 0; dimensionIndex < this->dimensionNumber; ++dimensionIndex) {
+                
+                QuantizedDistanceType difference = features[dimensionIndex] - (offsets[dimensionIndex] + scales[dimensionIndex] * ((FeatureType)codes[dimensionIndex] + 128));
+                distance += difference * difference;
+            }
+            
+        } else {
+            
+            const Float16CodeType* codes = &(this->float16Codes[position]);
+            
+            for (DimensionNumber dimensionIndex = 0; dimensionIndex < this->dimensionNumber; ++dimensionIndex) {
+                
+                QuantizedDistanceType difference = features[dimensionIndex] - (offsets[dimensionIndex] + scales[dimensionIndex] * decodeHalf(codes[dimensionIndex]));
+                distance += difference * difference;
+            }
+        }
+        
+        return distance;
+    }
+    
+    size_t QuantizedPointBuffer::getCodesSize() const {
+        return this->int8Codes.size() * sizeof(Int8CodeType) + this->float16Codes.size() * sizeof(Float16CodeType);
+    }
+}
+
+namespace std {
+    template<>
+    void swap<std::QuantizedPointBuffer>(std::QuantizedPointBuffer& a, std::QuantizedPointBuffer& b) {
+        a.swap(b);
+    }
+}
\ No newline at end of file
@@ -0,0 +1,129 @@
+#ifndef __QUANTIZATION_H__
+#define __QUANTIZATION_H__
+
+#include <vector>
+#include "assert.h"
+#include "PointBuffer.h"
+
+namespace std {
+    
+    using namespace std;
+    
+    enum QuantizationType {
+        NoQuantization,
+        Int8Quantization,
+        Float16Quantization
+    };
+    
+    typedef signed char Int8CodeType;
+    typedef unsigned short Float16CodeType;
+    typedef double QuantizedDistanceType;
+    typedef vector<Int8CodeType, ResourceAllocator<Int8CodeType> > Int8CodeVector;
+    typedef vector<Float16CodeType, ResourceAllocator<Float16CodeType> > Float16CodeVector;
+    
+    Float16CodeType floatToHalf(float value);
+    float halfToFloat(Float16CodeType code);
+    
+    //Compressed copy of a PointBuffer, every coordinate is stored as offset + scale * code with per-dimension offset and scale.
+    class QuantizedPointBuffer {
+    
+    public:
+        
+        QuantizedPointBuffer();
+        
+        QuantizedPointBuffer(const QuantizedPointBuffer& rhs);
+        QuantizedPointBuffer& operator=(const QuantizedPointBuffer& rhs);
+        
+        //Copy whose codes are allocated from another resource, the default one when it is NULL.
+        QuantizedPointBuffer(const QuantizedPointBuffer& rhs, MemoryResource* memoryResource);
+        
+        ~QuantizedPointBuffer();
+        
+        void swap(QuantizedPointBuffer& other);
+        
+        void build(const PointBuffer& points, QuantizationType quantizationType);
+        void clear();
+        
+        //Following builds allocate the codes from the resource, the default one when it is NULL. The resource must outlive the buffer.
+        void setMemoryResource(MemoryResource* memoryResource);
+        
+        inline MemoryResource* getMemoryResource() const {
+            return this->int8Codes.get_allocator().getResource();
+        }
+        
+        inline QuantizationType getQuantizationType() const {
+            return this->quantizationType;
+        }
+        
+        inline size_t getPointNumber() const {
+            return this->pointNumber;
+        }
+        
+        inline DimensionNumber getDimensionNumber() const {
+            return this->dimensionNumber;
+        }
+        
+        inline FeatureType getFeature(PointIndexType pointIndex, DimensionNumber dimensionIndex) const {
+            
+            assert(pointIndex < this->pointNumber && dimensionIndex < this->dimensionNumber);
+            
+            size_t position = pointIndex * this->dimensionNumber + dimensionIndex;
+            
+            FeatureType code = 0;
+            
+            if (this->quantizationType == Int8Quantization) {
+                code = (FeatureType)this->int8Codes[position] + 128;
+            } else {
+                code = halfToFloat(this->float16Codes[position]);
+            }
+            
+            return this->offsets[dimensionIndex] + this->scales[dimensionIndex] * code;
+        }
+        
+        inline const void* getPointCodes(PointIndexType pointIndex) const {
+            
+            assert(pointIndex < this->pointNumber);
+            
+            if (this->quantizationType == Int8Quantization) {
+                return &(this->int8Codes[pointIndex * this->dimensionNumber]);
+            }
+            
+            return &(this->float16Codes[pointIndex * this->dimensionNumber]);
+        }
+        
+        inline size_t getPointCodesSize() const {
+            
+            if (this->quantizationType == Int8Quantization) {
+                return this->dimensionNumber * sizeof(Int8CodeType);
+            }
+            
+            return this->dimensionNumber * sizeof(Float16CodeType);
+        }
+        
+        //Squared euclidean distance between features and the decoded point.
+        QuantizedDistanceType squaredDistance(const vector<FeatureType>& features, PointIndexType pointIndex) const;
+        
+        //Bytes held by the codes, without the per-dimension parameters.
+        size_t getCodesSize() const;
+    
+    private:
+        
+        QuantizationType quantizationType;
+        
+        Int8CodeVector int8Codes;
+        Float16CodeVector float16Codes;
+        
+        vector<FeatureType> offsets;
+        vector<FeatureType> scales;
+        
+        size_t pointNumber;
+        DimensionNumber dimensionNumber;
+    };
+}
+
+namespace std {
+    template<>
+    void swap<std::QuantizedPointBuffer>(std::QuantizedPointBuffer& a, std::QuantizedPointBuffer& b);
+}
+
+#endif
\ No newline at end of file
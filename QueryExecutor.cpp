@@ -0,0 +1,226 @@
+#include "QueryExecutor.h"
+#include <algorithm>
+
+namespace std {
+    
+    QueryExecutor::QueryExecutor(const KdTree& tree, size_t workersNumber, size_t maxBatchSize, chrono::microseconds batchWindow, size_t maxPendingQueriesNumber):tree(tree), maxBatchSize(max(maxBatchSize, (size_t)1)), batchWindow(batchWindow), maxPendingQueriesNumber(max(maxPendingQueriesNumber, (size_t)1)), isStopping(false), answeredQueriesNumber(0), batchesNumber(0), failedCallbacksNumber(0) {
+        
+        if (workersNumber == 0) {
+            workersNumber = max(thread::hardware_concurrency(), 1U);
+        }
+        
+        for (size_t workerIndex = 0; workerIndex < workersNumber; ++workerIndex) {
+            this->workers.push_back(thread(&QueryExecutor::workerTask, this));
+        }
+    }
+    
+    QueryExecutor::~QueryExecutor() {
+        
+        {
+            lock_guard<mutex> lock(this->queueMutex);
+            this->isStopping = true;
+        }
+        
+        this->queueNotEmpty.notify_all();
+        
+        vector<thread>::iterator workerIterator;
+        
+        for (workerIterator = this->workers.begin(); workerIterator != this->workers.end(); ++workerIterator) {
+            (*workerIterator).join();
+        }
+    }
+    
+    future< vector<KdTreeNode> > QueryExecutor::submit(const vector<FeatureType>& features, size_t k) {
+        
+        PendingQuery query;
+        query.features = features;
+        query.k = k;
+        
+        future< vector<KdTreeNode> > result = query.result.get_future();
+        
+        this->enqueue(query, true);
+        
+        return result;
+    }
+    
+    void QueryExecutor::submit(const vector<FeatureType>& features, size_t k, const QueryCallback& callback) {
+        
+        PendingQuery query;
+        query.features = features;
+        query.k = k;
+        query.callback = callback;
+        
+        this->enqueue(query, true);
+    }
+    
+    bool QueryExecutor::trySubmit(const vector<FeatureType>& features, size_t k, future< vector<KdTreeNode> >& result) {
+        
+        PendingQuery query;
+        query.features = features;
+        query.k = k;
+        
+        future< vector<KdTreeNode> > queryResult = query.result.get_future();
+        
+        if (this->enqueue(query, false) == false) {
+            return false;
+        }
+        
+        result = std::move(queryResult);
+        
+        return true;
+    }
+    
+    bool QueryExecutor::trySubmit(const vector<FeatureType>& features, size_t k, const QueryCallback& callback) {
+        
+        PendingQuery query;
+        query.features = features;
+        query.k = k;
+        query.callback = callback;
+        
+        return this->enqueue(query, false);
+    }
+    
+    size_t QueryExecutor::getPendingQueriesNumber() const {
+        
+        lock_guard<mutex> lock(this->queueMutex);
+        
+        return this->pendingQueries.size();
+    }
+    
+    size_t QueryExecutor::getAnsweredQueriesNumber() const {
+        return this->answeredQueriesNumber.load();
+    }
+    
+    size_t QueryExecutor::getBatchesNumber() const {
+        return this->batchesNumber.load();
+    }
+    
+    size_t QueryExecutor::getFailedCallbacksNumber() const {
+        return this->failedCallbacksNumber.load();
+    }
+    
+    bool QueryExecutor::enqueue(PendingQuery& query, bool isBlocking) {
+        
+        {
+            unique_lock<mutex> lock(this->queueMutex);
+            
+            assert(this->isStopping == false);
+            
+            if (isBlocking == true) {
+                
+                while (this->pendingQueries.size() >= this->maxPendingQueriesNumber) {
+                    this->queueNotFull.wait(lock);
+                }
+            } else if (this->pendingQueries.size() >= this->maxPendingQueriesNumber) {
+                return false;
+            }
+            
+            query.submitTime = Clock::now();
+            this->pendingQueries.push_back(std::move(query));
+        }
+        
+        this->queueNotEmpty.notify_one();
+        
+        return true;
+    }
+    
+    void QueryExecutor::workerTask() {
+        
+        vector<PendingQuery> batch;
+        batch.reserve(this->maxBatchSize);
+        
+        while (true) {
+            
+            {
+                unique_lock<mutex> lock(this->queueMutex);
+                
+                while (this->pendingQueries.empty() == true && this->isStopping == false) {
+                    this->queueNotEmpty.wait(lock);
+                }
+                
+                if (this->pendingQueries.empty() == true) {
+                    return;
+                }
+                
+                //A lone query is answered once it has waited the window, it does not wait for a full batch.
+                Clock::time_point deadline = this->pendingQueries.front().submitTime + this->batchWindow;
+                
+                while (this->pendingQueries.size() < this->maxBatchSize && this->isStopping == false && Clock::now() < deadline) {
+                    this->queueNotEmpty.wait_until(lock, deadline);
+                }
+                
+                //Another worker may have taken the queries in the meantime.
+                size_t batchSize = min(this->maxBatchSize, this->pendingQueries.size());
+                
+                for (size_t queryIndex = 0; queryIndex < batchSize; ++queryIndex) {
+                    batch.push_back(std::move(this->pendingQueries.front()));
+                    this->pendingQueries.pop_front();
+                }
+            }
+            
+            if (batch.empty() == false) {
+                
+                this->queueNotFull.notify_all();
+                
+                this->answerBatch(batch);
+                batch.clear();
+            }
+        }
+    }
+    
+    //Queries of one batch may ask for different k, the batch searches for the largest and every result is cut to its own k.
+    void QueryExecutor::answerBatch(vector<PendingQuery>& batch) {
+        
+        vector< vector<KdTreeNode> > results;
+        exception_ptr error;
+        
+        try {
+            
+            vector< vector<FeatureType> > featuresVector(batch.size());
+            size_t k = 0;
+            
+            for (size_t queryIndex = 0; queryIndex < batch.size(); ++queryIndex) {
+                featuresVector[queryIndex].swap(batch[queryIndex].features);
+                k = max(k, batch[queryIndex].k);
+            }
+            
+            results = this->tree.nearestKNodes(featuresVector, k);
+        } catch (...) {
+            
+            //Every query of the batch is answered with the error.
+            error = current_exception();
+            results.assign(batch.size(), vector<KdTreeNode>());
+        }
+        
+        for (size_t queryIndex = 0; queryIndex < batch.size(); ++queryIndex) {
+            
+            PendingQuery& query = batch[queryIndex];
+            vector<KdTreeNode>& result = results[queryIndex];
+            
+            if (result.size() > query.k) {
+                result.erase(result.begin() + query.k, result.end());
+            }
+            
+            if (query.callback) {
+                this->invokeCallback(query, result, error);
+            } else if (error) {
+                query.result.set_exception(error);
+            } else {
+                query.result.set_value(std::move(result));
+            }
+        }
+        
+        this->answeredQueriesNumber += batch.size();
+        ++this->batchesNumber;
+    }
+    
+    //A throwing callback would end the worker thread and the process with it, it only loses its own answer instead.
+    void QueryExecutor::invokeCallback(const PendingQuery& query, const vector<KdTreeNode>& result, exception_ptr error) {
+        
+        try {
+            query.callback(result, error);
+        } catch (...) {
+            ++this->failedCallbacksNumber;
+        }
+    }
+}
\ No newline at end of file
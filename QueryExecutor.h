@@ -0,0 +1,99 @@
+#ifndef __QUERY_EXECUTOR_H__
+#define __QUERY_EXECUTOR_H__
+
+#include <vector>
+#include <deque>
+#include <exception>
+#include <future>
+#include <functional>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include <atomic>
+#include <chrono>
+#include "KdTree.h"
+
+namespace std {
+    
+    using namespace std;
+    
+    //Receives the results, or no results and the error when the search failed.
+    typedef function<void (const vector<KdTreeNode>&, exception_ptr)> QueryCallback;
+    
+    //Answers single queries submitted from any thread with batched searches on worker threads.
+    //A worker waits up to the batch window after the oldest pending query for a full batch, then answers what it has with one nearestKNodes call.
+    //The pending queue is bounded: submit blocks and trySubmit fails while it is full, so producers slow down to the speed of the workers.
+    class QueryExecutor {
+        
+    public:
+        
+        static const size_t DefaultMaxBatchSize = 64;
+        static const size_t DefaultMaxPendingQueriesNumber = 4096;
+        
+        //The tree must stay built and unchanged while the executor exists. Zero workers means one per hardware thread.
+        QueryExecutor(const KdTree& tree, size_t workersNumber = 0, size_t maxBatchSize = DefaultMaxBatchSize, chrono::microseconds batchWindow = chrono::microseconds(200), size_t maxPendingQueriesNumber = DefaultMaxPendingQueriesNumber);
+        
+        //Answers the queries still pending before the workers stop.
+        ~QueryExecutor();
+        
+        //Blocks while the queue is full.
+        future< vector<KdTreeNode> > submit(const vector<FeatureType>& features, size_t k);
+        
+        //The callback runs on a worker thread and should return quickly, the other queries of its batch wait for it.
+        //Exceptions thrown by the callback are counted and dropped, they do not reach the caller.
+        void submit(const vector<FeatureType>& features, size_t k, const QueryCallback& callback);
+        
+        //Returns false instead of blocking when the queue is full.
+        bool trySubmit(const vector<FeatureType>& features, size_t k, future< vector<KdTreeNode> >& result);
+        bool trySubmit(const vector<FeatureType>& features, size_t k, const QueryCallback& callback);
+        
+        size_t getPendingQueriesNumber() const;
+        
+        //Answered queries and the batches they were answered in, their ratio is the mean batch size. Queries answered with an error count as well.
+        size_t getAnsweredQueriesNumber() const;
+        size_t getBatchesNumber() const;
+        
+        size_t getFailedCallbacksNumber() const;
+        
+    private:
+        
+        QueryExecutor(const QueryExecutor& rhs);
+        QueryExecutor& operator=(const QueryExecutor& rhs);
+        
+        typedef chrono::steady_clock Clock;
+        
+        struct PendingQuery {
+            vector<FeatureType> features;
+            size_t k;
+            promise< vector<KdTreeNode> > result;
+            QueryCallback callback;
+            Clock::time_point submitTime;
+        };
+        
+        const KdTree& tree;
+        
+        size_t maxBatchSize;
+        chrono::microseconds batchWindow;
+        size_t maxPendingQueriesNumber;
+        
+        mutable mutex queueMutex;
+        condition_variable queueNotEmpty;
+        condition_variable queueNotFull;
+        deque<PendingQuery> pendingQueries;
+        bool isStopping;
+        
+        atomic<size_t> answeredQueriesNumber;
+        atomic<size_t> batchesNumber;
+        atomic<size_t> failedCallbacksNumber;
+        
+        vector<thread> workers;
+        
+        bool enqueue(PendingQuery& query, bool isBlocking);
+        
+        void workerTask();
+        void answerBatch(vector<PendingQuery>& batch);
+        void invokeCallback(const PendingQuery& query, const vector<KdTreeNode>& result, exception_ptr error);
+    };
+}
+
+#endif
\ No newline at end of file
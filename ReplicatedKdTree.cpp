@@ -0,0 +1,66 @@
+#include "ReplicatedKdTree.h"
+#include <thread>
+#include <functional>
+
+namespace std {
+    
+    ReplicatedKdTree::ReplicatedKdTree(const KdTree& tree, PagePolicy pagePolicy):replicas(PageMemoryResource::getNumaNodesNumber(), NULL) {
+        
+        vector<thread> replicaThreads;
+        
+        for (size_t numaNode = 0; numaNode < this->replicas.size(); ++numaNode) {
+            replicaThreads.push_back(thread(&ReplicatedKdTree::buildReplica, this, cref(tree), pagePolicy, numaNode));
+        }
+        
+        vector<thread>::iterator threadIterator;
+        
+        for (threadIterator = replicaThreads.begin(); threadIterator != replicaThreads.end(); ++threadIterator) {
+            (*threadIterator).join();
+        }
+    }
+    
+    ReplicatedKdTree::~ReplicatedKdTree() {
+        
+        vector<KdTree*>::iterator replicaIterator;
+        
+        for (replicaIterator = this->replicas.begin(); replicaIterator != this->replicas.end(); ++replicaIterator) {
+            delete *replicaIterator;
+        }
+    }
+    
+    const KdTree& ReplicatedKdTree::getReplica(size_t numaNode) const {
+        
+        assert(numaNode < this->replicas.size());
+        
+        return *(this->replicas[numaNode]);
+    }
+    
+    const KdTree& ReplicatedKdTree::getLocalReplica() const {
+        
+        size_t numaNode = PageMemoryResource::getCurrentNumaNode();
+        
+        return *(this->replicas[numaNode < this->replicas.size() ? numaNode : 0]);
+    }
+    
+    const vector<KdTreeNode> ReplicatedKdTree::nearestKNode(const vector<FeatureType>& features, size_t k) const {
+        return this->getLocalReplica().nearestKNode(features, k);
+    }
+    
+    void ReplicatedKdTree::nearestKNode(const vector<FeatureType>& features, size_t k, KdTree::QueryContext& context) const {
+        this->getLocalReplica().nearestKNode(features, k, context);
+    }
+    
+    const vector< vector<KdTreeNode> > ReplicatedKdTree::nearestKNodes(const vector< vector<FeatureType> >& featuresVector, size_t k) const {
+        return this->getLocalReplica().nearestKNodes(featuresVector, k);
+    }
+    
+    //Runs on the node so that the copy is also first touched there, the preferred node policy keeps it there when the thread cannot be pinned.
+    void ReplicatedKdTree::buildReplica(const KdTree& tree, PagePolicy pagePolicy, size_t numaNode) {
+        
+        PageMemoryResource::pinThreadToNumaNode(numaNode);
+        
+        shared_ptr<MemoryResource> memoryResource(new PageMemoryResource(pagePolicy, PreferredNodeNumaPolicy, numaNode));
+        
+        this->replicas[numaNode] = new KdTree(tree, memoryResource);
+    }
+}
\ No newline at end of file
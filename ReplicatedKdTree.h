@@ -0,0 +1,48 @@
+#ifndef __REPLICATED_KD_TREE_H__
+#define __REPLICATED_KD_TREE_H__
+
+#include <vector>
+#include "KdTree.h"
+#include "MemoryResource.h"
+
+namespace std {
+    
+    using namespace std;
+    
+    //Read only copies of a built tree, one per NUMA node with its points and nodes allocated on that node.
+    //Queries search the replica of the node the calling thread runs on, threads pinned with PageMemoryResource::pinThreadToNumaNode only read local memory.
+    class ReplicatedKdTree {
+        
+    public:
+        
+        //Every replica is copied by a thread pinned to its node, in parallel.
+        ReplicatedKdTree(const KdTree& tree, PagePolicy pagePolicy = TransparentHugePages);
+        
+        ~ReplicatedKdTree();
+        
+        inline size_t getReplicasNumber() const {
+            return this->replicas.size();
+        }
+        
+        const KdTree& getReplica(size_t numaNode) const;
+        const KdTree& getLocalReplica() const;
+        
+        const vector<KdTreeNode> nearestKNode(const vector<FeatureType>& features, size_t k) const;
+        
+        //Results of the context refer to the local replica, look their features up with getLocalReplica().getResultFeatures on the same thread.
+        void nearestKNode(const vector<FeatureType>& features, size_t k, KdTree::QueryContext& context) const;
+        
+        const vector< vector<KdTreeNode> > nearestKNodes(const vector< vector<FeatureType> >& featuresVector, size_t k) const;
+        
+    private:
+        
+        ReplicatedKdTree(const ReplicatedKdTree& rhs);
+        ReplicatedKdTree& operator=(const ReplicatedKdTree& rhs);
+        
+        vector<KdTree*> replicas;
+        
+        void buildReplica(const KdTree& tree, PagePolicy pagePolicy, size_t numaNode);
+    };
+}
+
+#endif
\ No newline at end of file
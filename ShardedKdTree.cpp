@@ -0,0 +1,406 @@
+#include "ShardedKdTree.h"
+#include <algorithm>
+#include <random>
+#include <limits>
+
+namespace std {
+    
+    ShardedKdTree::ShardedKdTree(size_t shardsNumber, ShardPartition partition):partition(partition), isStopping(false) {
+        this->initShards(shardsNumber);
+    }
+    
+    ShardedKdTree::ShardedKdTree(size_t shardsNumber, const KdTree& prototype, ShardPartition partition):prototype(prototype), partition(partition), isStopping(false) {
+        this->initShards(shardsNumber);
+    }
+    
+    ShardedKdTree::~ShardedKdTree() {
+        
+        {
+            lock_guard<mutex> lock(this->tasksMutex);
+            this->isStopping = true;
+        }
+        
+        this->tasksNotEmpty.notify_all();
+        
+        vector<thread>::iterator workerIterator;
+        
+        for (workerIterator = this->workers.begin(); workerIterator != this->workers.end(); ++workerIterator) {
+            (*workerIterator).join();
+        }
+        
+        vector<KdTreeIndex*>::iterator shardIterator;
+        
+        for (shardIterator = this->shards.begin(); shardIterator != this->shards.end(); ++shardIterator) {
+            delete *shardIterator;
+        }
+    }
+    
+    //The calling thread of a query searches one shard itself, the workers take the others.
+    void ShardedKdTree::initShards(size_t shardsNumber) {
+        
+        assert(shardsNumber > 0);
+        
+        for (size_t shardIndex = 0; shardIndex < shardsNumber; ++shardIndex) {
+            this->shards.push_back(new KdTreeIndex(this->prototype));
+        }
+        
+        for (size_t workerIndex = 1; workerIndex < shardsNumber; ++workerIndex) {
+            this->workers.push_back(thread(&ShardedKdTree::workerTask, this));
+        }
+    }
+    
+    void ShardedKdTree::build(const vector< vector<FeatureType> >& featuresVector, const vector<NodeCategory>& categoriesVector) {
+        
+        assert(featuresVector.size() == categoriesVector.size());
+        
+        size_t shardsNumber = this->shards.size();
+        vector< vector<size_t> > shardIndices(shardsNumber);
+        
+        this->partitionNodes.clear();
+        
+        if (this->partition == KdSplitPartition) {
+            
+            vector<size_t> indices(featuresVector.size());
+            
+            for (size_t index = 0; index < indices.size(); ++index) {
+                indices[index] = index;
+            }
+            
+            this->partitionByKdSplit(featuresVector, indices, 0, indices.size(), 0, shardsNumber, shardIndices);
+        } else {
+            this->partitionRandomly(featuresVector.size(), shardIndices);
+        }
+        
+        //Shards fitting their own parameters would score on different scales, so they share one normalizer fitted over the whole collection.
+        NormalizationType normalizationType = this->prototype.getNormalizationType();
+        
+        if (normalizationType != NoNormalization && featuresVector.empty() == false) {
+            
+            FeatureNormalizer normalizer;
+            normalizer.fit(PointBuffer(featuresVector), normalizationType);
+            
+            vector<KdTreeIndex*>::iterator shardIterator;
+            
+            for (shardIterator = this->shards.begin(); shardIterator != this->shards.end(); ++shardIterator) {
+                (*shardIterator)->setFittedNormalizer(normalizer);
+            }
+        }
+        
+        vector<thread> buildThreads;
+        vector<exception_ptr> buildErrors(shardsNumber);
+        
+        for (size_t shardIndex = 0; shardIndex < shardsNumber; ++shardIndex) {
+            buildThreads.push_back(thread(&ShardedKdTree::buildShard, this, shardIndex, &featuresVector, &categoriesVector, &shardIndices[shardIndex], &buildErrors[shardIndex]));
+        }
+        
+        vector<thread>::iterator threadIterator;
+        
+        for (threadIterator = buildThreads.begin(); threadIterator != buildThreads.end(); ++threadIterator) {
+            (*threadIterator).join();
+        }
+        
+        vector<exception_ptr>::const_iterator errorIterator;
+        
+        for (errorIterator = buildErrors.begin(); errorIterator != buildErrors.end(); ++errorIterator) {
+            
+            if (*errorIterator) {
+                rethrow_exception(*errorIterator);
+            }
+        }
+    }
+    
+    void ShardedKdTree::rebuildShard(size_t shardIndex, const vector< vector<FeatureType> >& featuresVector, const vector<NodeCategory>& categoriesVector) {
+        
+        assert(shardIndex < this->shards.size());
+        
+        this->shards[shardIndex]->build(featuresVector, categoriesVector);
+    }
+    
+    void ShardedKdTree::rebuildShardAsync(size_t shardIndex, vector< vector<FeatureType> > featuresVector, vector<NodeCategory> categoriesVector) {
+        
+        assert(shardIndex < this->shards.size());
+        
+        this->shards[shardIndex]->rebuildAsync(std::move(featuresVector), std::move(categoriesVector));
+    }
+    
+    void ShardedKdTree::waitForRebuilds() {
+        
+        exception_ptr error;
+        
+        vector<KdTreeIndex*>::iterator shardIterator;
+        
+        //Every shard is waited for before the first error is rethrown.
+        for (shardIterator = this->shards.begin(); shardIterator != this->shards.end(); ++shardIterator) {
+            
+            try {
+                (*shardIterator)->waitForRebuild();
+            } catch (...) {
+                
+                if (!error) {
+                    error = current_exception();
+                }
+            }
+        }
+        
+        if (error) {
+            rethrow_exception(error);
+        }
+    }
+    
+    size_t ShardedKdTree::getShardIndex(const vector<FeatureType>& features) const {
+        
+        assert(this->partition == KdSplitPartition && this->partitionNodes.empty() == false);
+        
+        size_t node = 0;
+        
+        while (this->partitionNodes[node].shardIndex == NullPartitionNode) {
+            
+            const PartitionNode& partitionNode = this->partitionNodes[node];
+            
+            node = features[partitionNode.splitFeatureIndex] < partitionNode.splitFeature ? partitionNode.leftChild : partitionNode.rightChild;
+        }
+        
+        return this->partitionNodes[node].shardIndex;
+    }
+    
+    const KdTreeIndex& ShardedKdTree::getShard(size_t shardIndex) const {
+        
+        assert(shardIndex < this->shards.size());
+        
+        return *(this->shards[shardIndex]);
+    }
+    
+    const vector<KdTreeNode> ShardedKdTree::nearestKNode(const vector<FeatureType>& features, size_t k) const {
+        
+        vector< vector<FeatureType> > featuresVector(1, features);
+        
+        return this->nearestKNodes(featuresVector, k).front();
+    }
+    
+    const vector< vector<KdTreeNode> > ShardedKdTree::nearestKNodes(const vector< vector<FeatureType> >& featuresVector, size_t k) const {
+        
+        vector< vector< vector<KdTreeNode> > > shardResults(this->shards.size());
+        
+        this->scatter(featuresVector, k, shardResults);
+        
+        ResultBetter resultBetter(this->prototype.getSearchMode() != EuclideanSearch);
+        
+        vector< vector<KdTreeNode> > results(featuresVector.size());
+        
+        for (size_t queryIndex = 0; queryIndex < featuresVector.size(); ++queryIndex) {
+            
+            vector<KdTreeNode>& result = results[queryIndex];
+            
+            for (size_t shardIndex = 0; shardIndex < shardResults.size(); ++shardIndex) {
+                
+                //A shard without a snapshot yet answers nothing.
+                if (queryIndex < shardResults[shardIndex].size()) {
+                    
+                    const vector<KdTreeNode>& shardResult = shardResults[shardIndex][queryIndex];
+                    
+                    result.insert(result.end(), shardResult.begin(), shardResult.end());
+                }
+            }
+            
+            size_t resultSize = min(k, result.size());
+            
+            partial_sort(result.begin(), result.begin() + resultSize, result.end(), resultBetter);
+            result.erase(result.begin() + resultSize, result.end());
+        }
+        
+        return results;
+    }
+    
+    //The median of the widest dimension at the rank that leaves every cell an equal share, so shard counts other than powers of two stay balanced.
+    size_t ShardedKdTree::partitionByKdSplit(const vector< vector<FeatureType> >& featuresVector, vector<size_t>& indices, size_t low, size_t up, size_t firstShardIndex, size_t shardsNumber, vector< vector<size_t> >& shardIndices) {
+        
+        size_t node = this->partitionNodes.size();
+        
+        PartitionNode partitionNode;
+        partitionNode.splitFeature = 0;
+        partitionNode.splitFeatureIndex = 0;
+        partitionNode.leftChild = NullPartitionNode;
+        partitionNode.rightChild = NullPartitionNode;
+        partitionNode.shardIndex = NullPartitionNode;
+        
+        this->partitionNodes.push_back(partitionNode);
+        
+        if (shardsNumber == 1) {
+            
+            this->partitionNodes[node].shardIndex = firstShardIndex;
+            shardIndices[firstShardIndex].assign(indices.begin() + low, indices.begin() + up);
+            
+            return node;
+        }
+        
+        DimensionNumber splitFeatureIndex = 0;
+        
+        if (up > low) {
+            
+            DimensionNumber dimensionNumber = featuresVector[indices[low]].size();
+            FeatureType maxSpread = -1;
+            
+            for (DimensionNumber dimensionIndex = 0; dimensionIndex < dimensionNumber; ++dimensionIndex) {
+                
+                FeatureType minFeature = numeric_limits<FeatureType>::max();
+                FeatureType maxFeature = -numeric_limits<FeatureType>::max();
+                
+                for (size_t position = low; position < up; ++position) {
+                    
+                    FeatureType feature = featuresVector[indices[position]][dimensionIndex];
+                    
+                    minFeature = min(minFeature, feature);
+                    maxFeature = max(maxFeature, feature);
+                }
+                
+                if (maxFeature - minFeature > maxSpread) {
+                    maxSpread = maxFeature - minFeature;
+                    splitFeatureIndex = dimensionIndex;
+                }
+            }
+        }
+        
+        size_t leftShardsNumber = shardsNumber / 2;
+        size_t middle = low + (up - low) * leftShardsNumber / shardsNumber;
+        
+        FeatureType splitFeature = 0;
+        
+        if (middle < up) {
+            
+            nth_element(indices.begin() + low, indices.begin() + middle, indices.begin() + up, FeatureIndexLess(featuresVector, splitFeatureIndex));
+            splitFeature = featuresVector[indices[middle]][splitFeatureIndex];
+        }
+        
+        size_t leftChild = this->partitionByKdSplit(featuresVector, indices, low, middle, firstShardIndex, leftShardsNumber, shardIndices);
+        size_t rightChild = this->partitionByKdSplit(featuresVector, indices, middle, up, firstShardIndex + leftShardsNumber, shardsNumber - leftShardsNumber, shardIndices);
+        
+        this->partitionNodes[node].splitFeature = splitFeature;
+        this->partitionNodes[node].splitFeatureIndex = splitFeatureIndex;
+        this->partitionNodes[node].leftChild = leftChild;
+        this->partitionNodes[node].rightChild = rightChild;
+        
+        return node;
+    }
+    
+    //Fixed seed, the same points always land in the same shards.
+    void ShardedKdTree::partitionRandomly(size_t pointsNumber, vector< vector<size_t> >& shardIndices) const {
+        
+        vector<size_t> indices(pointsNumber);
+        
+        for (size_t index = 0; index < pointsNumber; ++index) {
+            indices[index] = index;
+        }
+        
+        minstd_rand generator(pointsNumber);
+        shuffle(indices.begin(), indices.end(), generator);
+        
+        size_t shardsNumber = shardIndices.size();
+        
+        for (size_t shardIndex = 0; shardIndex < shardsNumber; ++shardIndex) {
+            shardIndices[shardIndex].assign(indices.begin() + pointsNumber * shardIndex / shardsNumber, indices.begin() + pointsNumber * (shardIndex + 1) / shardsNumber);
+        }
+    }
+    
+    //An exception escaping the build thread would terminate the process, it is handed to build instead.
+    void ShardedKdTree::buildShard(size_t shardIndex, const vector< vector<FeatureType> >* featuresVector, const vector<NodeCategory>* categoriesVector, const vector<size_t>* indices, exception_ptr* error) {
+        
+        try {
+            this->buildShardPoints(shardIndex, featuresVector, categoriesVector, indices);
+        } catch (...) {
+            *error = current_exception();
+        }
+    }
+    
+    void ShardedKdTree::buildShardPoints(size_t shardIndex, const vector< vector<FeatureType> >* featuresVector, const vector<NodeCategory>* categoriesVector, const vector<size_t>* indices) {
+        
+        vector< vector<FeatureType> > shardFeaturesVector;
+        vector<NodeCategory> shardCategoriesVector;
+        
+        shardFeaturesVector.reserve(indices->size());
+        shardCategoriesVector.reserve(indices->size());
+        
+        vector<size_t>::const_iterator indexIterator;
+        
+        for (indexIterator = indices->begin(); indexIterator != indices->end(); ++indexIterator) {
+            shardFeaturesVector.push_back((*featuresVector)[*indexIterator]);
+            shardCategoriesVector.push_back((*categoriesVector)[*indexIterator]);
+        }
+        
+        //An empty shard keeps no snapshot and answers nothing.
+        if (shardFeaturesVector.empty() == false) {
+            this->shards[shardIndex]->build(shardFeaturesVector, shardCategoriesVector);
+        }
+    }
+    
+    void ShardedKdTree::workerTask() {
+        
+        while (true) {
+            
+            ShardTask task;
+            
+            {
+                unique_lock<mutex> lock(this->tasksMutex);
+                
+                while (this->tasks.empty() == true && this->isStopping == false) {
+                    this->tasksNotEmpty.wait(lock);
+                }
+                
+                if (this->tasks.empty() == true) {
+                    return;
+                }
+                
+                task = this->tasks.front();
+                this->tasks.pop_front();
+            }
+            
+            this->runTask(task);
+        }
+    }
+    
+    void ShardedKdTree::runTask(const ShardTask& task) const {
+        
+        *(task.results) = this->shards[task.shardIndex]->nearestKNodes(*(task.featuresVector), task.k);
+        
+        lock_guard<mutex> lock(task.gather->gatherMutex);
+        
+        if (--task.gather->pendingShardsNumber == 0) {
+            task.gather->gatherDone.notify_one();
+        }
+    }
+    
+    void ShardedKdTree::scatter(const vector< vector<FeatureType> >& featuresVector, size_t k, vector< vector< vector<KdTreeNode> > >& shardResults) const {
+        
+        ShardGather gather;
+        gather.pendingShardsNumber = this->shards.size();
+        
+        ShardTask task;
+        task.featuresVector = &featuresVector;
+        task.k = k;
+        task.gather = &gather;
+        
+        {
+            lock_guard<mutex> lock(this->tasksMutex);
+            
+            for (size_t shardIndex = 1; shardIndex < this->shards.size(); ++shardIndex) {
+                
+                task.shardIndex = shardIndex;
+                task.results = &shardResults[shardIndex];
+                
+                this->tasks.push_back(task);
+            }
+        }
+        
+        this->tasksNotEmpty.notify_all();
+        
+        task.shardIndex = 0;
+        task.results = &shardResults[0];
+        
+        this->runTask(task);
+        
+        unique_lock<mutex> lock(gather.gatherMutex);
+        
+        while (gather.pendingShardsNumber > 0) {
+            gather.gatherDone.wait(lock);
+        }
+    }
+}
\ No newline at end of file
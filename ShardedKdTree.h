@@ -0,0 +1,165 @@
+#ifndef __SHARDED_KD_TREE_H__
+#define __SHARDED_KD_TREE_H__
+
+#include <vector>
+#include <deque>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include "KdTree.h"
+#include "KdTreeIndex.h"
+
+namespace std {
+    
+    using namespace std;
+    
+    enum ShardPartition {
+        //Median splits of the widest dimension, recursively, until there is one cell per shard. getShardIndex routes a point to its cell.
+        KdSplitPartition,
+        //Points are dealt to the shards after a seeded shuffle, every shard holds a sample of the whole collection.
+        RandomPartition
+    };
+    
+    //Splits a collection over independently built shards, each a KdTreeIndex so that one shard can be rebuilt while the others keep serving.
+    //Queries go to every shard at once on a pool of worker threads and the per shard top-k lists are merged.
+    class ShardedKdTree {
+        
+    public:
+        
+        ShardedKdTree(size_t shardsNumber, ShardPartition partition = KdSplitPartition);
+        
+        //Options of the prototype (search mode, quantization, split rule, ...) are copied into every shard.
+        ShardedKdTree(size_t shardsNumber, const KdTree& prototype, ShardPartition partition = KdSplitPartition);
+        
+        //Queries must have finished before the tree is destroyed.
+        ~ShardedKdTree();
+        
+        //Partitions the points and builds the shards in parallel, one thread per shard.
+        //Normalization parameters are fitted once over all points and shared by the shards, rebuilt shards keep them.
+        //Rethrows the first error of a shard build once all of them have finished, shards that failed keep their previous points.
+        void build(const vector< vector<FeatureType> >& featuresVector, const vector<NodeCategory>& categoriesVector);
+        
+        //Replaces the points of one shard, on the calling thread or in the background. Queries keep seeing the previous points of the shard until the new ones are swapped in.
+        void rebuildShard(size_t shardIndex, const vector< vector<FeatureType> >& featuresVector, const vector<NodeCategory>& categoriesVector);
+        void rebuildShardAsync(size_t shardIndex, vector< vector<FeatureType> > featuresVector, vector<NodeCategory> categoriesVector);
+        
+        //Rethrows the first error of a failed shard rebuild, see KdTreeIndex::waitForRebuild.
+        void waitForRebuilds();
+        
+        inline size_t getShardsNumber() const {
+            return this->shards.size();
+        }
+        
+        inline ShardPartition getPartition() const {
+            return this->partition;
+        }
+        
+        //Shard whose cell of the last build holds the point, only defined for KdSplitPartition.
+        size_t getShardIndex(const vector<FeatureType>& features) const;
+        
+        const KdTreeIndex& getShard(size_t shardIndex) const;
+        
+        const vector<KdTreeNode> nearestKNode(const vector<FeatureType>& features, size_t k) const;
+        
+        //Every shard answers the whole batch with its interleaved traversal, then the lists are merged query by query.
+        const vector< vector<KdTreeNode> > nearestKNodes(const vector< vector<FeatureType> >& featuresVector, size_t k) const;
+        
+    private:
+        
+        ShardedKdTree(const ShardedKdTree& rhs);
+        ShardedKdTree& operator=(const ShardedKdTree& rhs);
+        
+        static const size_t NullPartitionNode = (size_t)(-1);
+        
+        //Inner nodes split the cell in two, leaves name their shard.
+        struct PartitionNode {
+            FeatureType splitFeature;
+            DimensionNumber splitFeatureIndex;
+            size_t leftChild;
+            size_t rightChild;
+            size_t shardIndex;
+        };
+        
+        //Waits for the shard searches of one query or batch.
+        struct ShardGather {
+            mutex gatherMutex;
+            condition_variable gatherDone;
+            size_t pendingShardsNumber;
+        };
+        
+        struct ShardTask {
+            size_t shardIndex;
+            const vector< vector<FeatureType> >* featuresVector;
+            size_t k;
+            vector< vector<KdTreeNode> >* results;
+            ShardGather* gather;
+        };
+        
+        //Orders point indices by one feature of the points being partitioned.
+        class FeatureIndexLess {
+            
+        public:
+            
+            FeatureIndexLess(const vector< vector<FeatureType> >& featuresVector, DimensionNumber dimensionIndex):featuresVector(featuresVector), dimensionIndex(dimensionIndex) {
+                
+            }
+            
+            inline bool operator()(size_t lhs, size_t rhs) const {
+                return this->featuresVector[lhs][this->dimensionIndex] < this->featuresVector[rhs][this->dimensionIndex];
+            }
+            
+        private:
+            
+            const vector< vector<FeatureType> >& featuresVector;
+            DimensionNumber dimensionIndex;
+        };
+        
+        //Best result first: smallest distance, or largest similarity for cosine and inner product search.
+        class ResultBetter {
+            
+        public:
+            
+            ResultBetter(bool isSimilarity):isSimilarity(isSimilarity) {
+                
+            }
+            
+            inline bool operator()(const KdTreeNode& lhs, const KdTreeNode& rhs) const {
+                return this->isSimilarity == true ? lhs.getScore() > rhs.getScore() : lhs.getScore() < rhs.getScore();
+            }
+            
+        private:
+            
+            bool isSimilarity;
+        };
+        
+        KdTree prototype;
+        ShardPartition partition;
+        
+        vector<KdTreeIndex*> shards;
+        vector<PartitionNode> partitionNodes;
+        
+        mutable mutex tasksMutex;
+        mutable condition_variable tasksNotEmpty;
+        mutable deque<ShardTask> tasks;
+        bool isStopping;
+        
+        vector<thread> workers;
+        
+        void initShards(size_t shardsNumber);
+        
+        //Splits indices[low, up) into shardsNumber cells numbered from firstShardIndex and returns the partition node of the range.
+        size_t partitionByKdSplit(const vector< vector<FeatureType> >& featuresVector, vector<size_t>& indices, size_t low, size_t up, size_t firstShardIndex, size_t shardsNumber, vector< vector<size_t> >& shardIndices);
+        void partitionRandomly(size_t pointsNumber, vector< vector<size_t> >& shardIndices) const;
+        
+        void buildShard(size_t shardIndex, const vector< vector<FeatureType> >* featuresVector, const vector<NodeCategory>* categoriesVector, const vector<size_t>* indices, exception_ptr* error);
+        void buildShardPoints(size_t shardIndex, const vector< vector<FeatureType> >* featuresVector, const vector<NodeCategory>* categoriesVector, const vector<size_t>* indices);
+        
+        void workerTask();
+        void runTask(const ShardTask& task) const;
+        
+        //Searches every shard, the calling thread takes the first one.
+        void scatter(const vector< vector<FeatureType> >& featuresVector, size_t k, vector< vector< vector<KdTreeNode> > >& shardResults) const;
+    };
+}
+
+#endif
\ No newline at end of file
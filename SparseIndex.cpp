@@ -0,0 +1,268 @@
+#include "SparseIndex.h"
+#include <algorithm>
+#include <cmath>
+
+namespace std {
+    
+    SparseIndex::SparseIndex():searchMode(EuclideanSearch), dimensionNumber(0) {
+    
+    }
+    
+    SparseIndex::SparseIndex(const SparseIndex& rhs):searchMode(rhs.searchMode), dimensionNumber(rhs.dimensionNumber), points(rhs.points), categories(rhs.categories), squaredNorms(rhs.squaredNorms), postingOffsets(rhs.postingOffsets), postingPoints(rhs.postingPoints), postingValues(rhs.postingValues), pointsByNorm(rhs.pointsByNorm) {
+    
+    }
+    
+    SparseIndex& SparseIndex::operator=(const SparseIndex& rhs) {
+        SparseIndex temp(rhs);
+        this->swap(temp);
+        return *this;
+    }
+    
+    SparseIndex::~SparseIndex() {
+    
+    }
+    
+    void SparseIndex::swap(SparseIndex& other) {
+        using std::swap;
+        swap(this->searchMode, other.searchMode);
+        swap(this->dimensionNumber, other.dimensionNumber);
+        swap(this->points, other.points);
+        swap(this->categories, other.categories);
+        swap(this->squaredNorms, other.squaredNorms);
+        swap(this->postingOffsets, other.postingOffsets);
+        swap(this->postingPoints, other.postingPoints);
+        swap(this->postingValues, other.postingValues);
+        swap(this->pointsByNorm, other.pointsByNorm);
+    }
+    
+    //Orders point indices by their squared norm.
+    class PointNormLess {
+        
+    public:
+        
+        PointNormLess(const vector<SparseValueType>& squaredNorms):squaredNorms(squaredNorms) {
+            
+        }
+        
+        inline bool operator()(PointIndexType lhs, PointIndexType rhs) const {
+            return this->squaredNorms[lhs] < this->squaredNorms[rhs];
+        }
+        
+    private:
+        
+        const vector<SparseValueType>& squaredNorms;
+    };
+    
+    void SparseIndex::build(const vector<SparseVector>& points, const vector<NodeCategory>& categoriesVector) {
+        
+        assert(points.size() == categoriesVector.size());
+        
+        this->points = points;
+        this->categories = categoriesVector;
+        this->dimensionNumber = points.empty() == true ? 0 : points.front().getDimensionNumber();
+        
+        size_t pointNumber = points.size();
+        
+        this->squaredNorms.resize(pointNumber);
+        this->pointsByNorm.resize(pointNumber);
+        this->postingOffsets.assign(this->dimensionNumber + 1, 0);
+        
+        //Counts the postings of every dimension, then turns the counts into offsets.
+        for (PointIndexType pointIndex = 0; pointIndex < pointNumber; ++pointIndex) {
+            
+            const SparseVector& point = points[pointIndex];
+            
+            assert(point.getDimensionNumber() == this->dimensionNumber);
+            
+            const SparseIndexType* indices = point.getIndices();
+            
+            for (size_t index = 0; index < point.getNonZerosNumber(); ++index) {
+                ++this->postingOffsets[indices[index] + 1];
+            }
+            
+            this->squaredNorms[pointIndex] = point.squaredNorm();
+            this->pointsByNorm[pointIndex] = pointIndex;
+        }
+        
+        for (size_t dimensionIndex = 0; dimensionIndex < this->dimensionNumber; ++dimensionIndex) {
+            this->postingOffsets[dimensionIndex + 1] += this->postingOffsets[dimensionIndex];
+        }
+        
+        this->postingPoints.resize(this->postingOffsets.back());
+        this->postingValues.resize(this->postingOffsets.back());
+        
+        vector<size_t> postingEnds(this->postingOffsets.begin(), this->postingOffsets.end() - 1);
+        
+        for (PointIndexType pointIndex = 0; pointIndex < pointNumber; ++pointIndex) {
+            
+            const SparseVector& point = points[pointIndex];
+            
+            const SparseIndexType* indices = point.getIndices();
+            const SparseValueType* values = point.getValues();
+            
+            for (size_t index = 0; index < point.getNonZerosNumber(); ++index) {
+                
+                size_t postingIndex = postingEnds[indices[index]]++;
+                
+                this->postingPoints[postingIndex] = pointIndex;
+                this->postingValues[postingIndex] = values[index];
+            }
+        }
+        
+        stable_sort(this->pointsByNorm.begin(), this->pointsByNorm.end(), PointNormLess(this->squaredNorms));
+    }
+    
+    void SparseIndex::setSearchMode(KdTreeSearchMode searchMode) {
+        this->searchMode = searchMode;
+    }
+    
+    KdTreeSearchMode SparseIndex::getSearchMode() const {
+        return this->searchMode;
+    }
+    
+    const vector<SparseSearchResult> SparseIndex::nearestKNode(const SparseVector& features, size_t k) const {
+        
+        vector<SparseSearchResult> result;
+        
+        if (this->points.empty() == true || k == 0) {
+            return result;
+        }
+        
+        SparseQueryScratch scratch;
+        this->initScratch(scratch);
+        
+        this->search(features, k, scratch, result);
+        
+        return result;
+    }
+    
+    const vector< vector<SparseSearchResult> > SparseIndex::nearestKNodes(const vector<SparseVector>& featuresVector, size_t k) const {
+        
+        vector< vector<SparseSearchResult> > result(featuresVector.size());
+        
+        if (this->points.empty() == true || k == 0) {
+            return result;
+        }
+        
+        SparseQueryScratch scratch;
+        this->initScratch(scratch);
+        
+        for (size_t index = 0; index < featuresVector.size(); ++index) {
+            this->search(featuresVector[index], k, scratch, result[index]);
+        }
+        
+        return result;
+    }
+    
+    void SparseIndex::initScratch(SparseQueryScratch& scratch) const {
+        
+        scratch.innerProducts.assign(this->points.size(), 0);
+        scratch.isTouched.assign(this->points.size(), false);
+        scratch.touchedPoints.clear();
+        scratch.candidates.clear();
+    }
+    
+    void SparseIndex::search(const SparseVector& features, size_t k, SparseQueryScratch& scratch, vector<SparseSearchResult>& result) const {
+        
+        assert(features.getDimensionNumber() == this->dimensionNumber);
+        
+        k = min(k, this->points.size());
+        
+        const SparseIndexType* indices = features.getIndices();
+        const SparseValueType* values = features.getValues();
+        
+        for (size_t index = 0; index < features.getNonZerosNumber(); ++index) {
+            
+            SparseIndexType dimensionIndex = indices[index];
+            SparseValueType value = values[index];
+            
+            for (size_t postingIndex = this->postingOffsets[dimensionIndex]; postingIndex < this->postingOffsets[dimensionIndex + 1]; ++postingIndex) {
+                
+                PointIndexType pointIndex = this->postingPoints[postingIndex];
+                
+                if (scratch.isTouched[pointIndex] == false) {
+                    scratch.isTouched[pointIndex] = true;
+                    scratch.touchedPoints.push_back(pointIndex);
+                }
+                
+                scratch.innerProducts[pointIndex] += value * this->postingValues[postingIndex];
+            }
+        }
+        
+        SparseValueType querySquaredNorm = features.squaredNorm();
+        
+        scratch.candidates.clear();
+        
+        vector<PointIndexType>::const_iterator pointIterator;
+        
+        for (pointIterator = scratch.touchedPoints.begin(); pointIterator != scratch.touchedPoints.end(); ++pointIterator) {
+            
+            SparseCandidate candidate;
+            candidate.pointIndex = *pointIterator;
+            
+            SparseValueType innerProduct = scratch.innerProducts[*pointIterator];
+            
+            if (this->searchMode == EuclideanSearch) {
+                candidate.distance = max((SparseValueType)0, querySquaredNorm + this->squaredNorms[*pointIterator] - 2 * innerProduct);
+            } else if (this->searchMode == CosineSearch) {
+                candidate.distance = this->squaredNorms[*pointIterator] == 0 || querySquaredNorm == 0 ? 0 : -innerProduct / sqrt(querySquaredNorm * this->squaredNorms[*pointIterator]);
+            } else {
+                candidate.distance = -innerProduct;
+            }
+            
+            scratch.candidates.push_back(candidate);
+        }
+        
+        //Untouched points all score 0 in cosine and inner product search, in Euclidean search the k smallest norms are the only ones that can still rank.
+        const vector<PointIndexType>* untouchedOrder = this->searchMode == EuclideanSearch ? &(this->pointsByNorm) : NULL;
+        size_t untouchedNumber = 0;
+        
+        for (size_t orderIndex = 0; orderIndex < this->points.size() && untouchedNumber < k; ++orderIndex) {
+            
+            PointIndexType pointIndex = untouchedOrder == NULL ? orderIndex : (*untouchedOrder)[orderIndex];
+            
+            if (scratch.isTouched[pointIndex] == true) {
+                continue;
+            }
+            
+            SparseCandidate candidate;
+            candidate.pointIndex = pointIndex;
+            candidate.distance = this->searchMode == EuclideanSearch ? querySquaredNorm + this->squaredNorms[pointIndex] : 0;
+            
+            scratch.candidates.push_back(candidate);
+            ++untouchedNumber;
+        }
+        
+        for (pointIterator = scratch.touchedPoints.begin(); pointIterator != scratch.touchedPoints.end(); ++pointIterator) {
+            scratch.innerProducts[*pointIterator] = 0;
+            scratch.isTouched[*pointIterator] = false;
+        }
+        
+        scratch.touchedPoints.clear();
+        
+        if (scratch.candidates.size() > k) {
+            nth_element(scratch.candidates.begin(), scratch.candidates.begin() + k, scratch.candidates.end(), SparseCandidateDistanceLess());
+            scratch.candidates.resize(k);
+        }
+        
+        sort(scratch.candidates.begin(), scratch.candidates.end(), SparseCandidateDistanceLess());
+        
+        result.resize(scratch.candidates.size());
+        
+        for (size_t index = 0; index < scratch.candidates.size(); ++index) {
+            
+            const SparseCandidate& candidate = scratch.candidates[index];
+            
+            result[index].pointIndex = candidate.pointIndex;
+            result[index].category = this->categories[candidate.pointIndex];
+            result[index].score = this->searchMode == EuclideanSearch ? sqrt(candidate.distance) : -candidate.distance;
+        }
+    }
+}
+
+namespace std {
+    template<>
+    void swap<std::SparseIndex>(std::SparseIndex& a, std::SparseIndex& b) {
+        a.swap(b);
+    }
+}
\ No newline at end of file
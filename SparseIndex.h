@@ -0,0 +1,116 @@
+#ifndef __SPARSE_INDEX_H__
+#define __SPARSE_INDEX_H__
+
+#include <vector>
+#include "assert.h"
+#include "SparseVector.h"
+#include "KdTree.h"
+
+namespace std {
+    
+    using namespace std;
+    
+    struct SparseSearchResult {
+        PointIndexType pointIndex;
+        NodeCategory category;
+        
+        //Same meaning as KdTreeNode::getScore: the distance in Euclidean search, the similarity in cosine and inner product search.
+        NodeDistanceType score;
+    };
+    
+    //Exact nearest neighbour search over high dimensional sparse points, for data a KdTree would have to densify.
+    //An inverted index keeps one posting list per dimension, a query only walks the lists of its own non-zeros to accumulate inner products with the points sharing one.
+    //Points sharing no dimension have inner product 0, so the remaining candidates are the first points by index or, in Euclidean search, by norm.
+    class SparseIndex {
+        
+    public:
+        
+        SparseIndex();
+        
+        SparseIndex(const SparseIndex& rhs);
+        SparseIndex& operator=(const SparseIndex& rhs);
+        
+        ~SparseIndex();
+        
+        void swap(SparseIndex& other);
+        
+        //Points must share one dimension number.
+        void build(const vector<SparseVector>& points, const vector<NodeCategory>& categoriesVector);
+        
+        //Scoring only, takes effect on the next query.
+        void setSearchMode(KdTreeSearchMode searchMode);
+        KdTreeSearchMode getSearchMode() const;
+        
+        inline size_t getPointNumber() const {
+            return this->points.size();
+        }
+        
+        inline size_t getDimensionNumber() const {
+            return this->dimensionNumber;
+        }
+        
+        inline const SparseVector& getPoint(PointIndexType pointIndex) const {
+            
+            assert(pointIndex < this->points.size());
+            
+            return this->points[pointIndex];
+        }
+        
+        //Results are ordered best first.
+        const vector<SparseSearchResult> nearestKNode(const SparseVector& features, size_t k) const;
+        
+        //Reuses one accumulator for the whole batch instead of clearing a fresh one per query.
+        const vector< vector<SparseSearchResult> > nearestKNodes(const vector<SparseVector>& featuresVector, size_t k) const;
+        
+    private:
+        
+        //Smaller distance is better: the squared distance in Euclidean search, the negated similarity otherwise.
+        struct SparseCandidate {
+            NodeDistanceType distance;
+            PointIndexType pointIndex;
+        };
+        
+        class SparseCandidateDistanceLess {
+            
+        public:
+            
+            inline bool operator()(const SparseCandidate& lhs, const SparseCandidate& rhs) const {
+                return lhs.distance < rhs.distance || (lhs.distance == rhs.distance && lhs.pointIndex < rhs.pointIndex);
+            }
+        };
+        
+        //Inner products of one query, only the touched points are non-zero and reset after the query.
+        struct SparseQueryScratch {
+            vector<SparseValueType> innerProducts;
+            vector<bool> isTouched;
+            vector<PointIndexType> touchedPoints;
+            vector<SparseCandidate> candidates;
+        };
+        
+        KdTreeSearchMode searchMode;
+        
+        size_t dimensionNumber;
+        
+        vector<SparseVector> points;
+        vector<NodeCategory> categories;
+        vector<SparseValueType> squaredNorms;
+        
+        //Postings of dimension d are [postingOffsets[d], postingOffsets[d + 1]) of postingPoints and postingValues, in point order.
+        vector<size_t> postingOffsets;
+        vector<PointIndexType> postingPoints;
+        vector<SparseValueType> postingValues;
+        
+        //Point indices by increasing norm, the order of |q - p|^2 = |q|^2 + |p|^2 for points sharing no dimension with q.
+        vector<PointIndexType> pointsByNorm;
+        
+        void initScratch(SparseQueryScratch& scratch) const;
+        void search(const SparseVector& features, size_t k, SparseQueryScratch& scratch, vector<SparseSearchResult>& result) const;
+    };
+}
+
+namespace std {
+    template<>
+    void swap<std::SparseIndex>(std::SparseIndex& a, std::SparseIndex& b);
+}
+
+#endif
\ No newline at end of file
@@ -0,0 +1,198 @@
+#include "SparseVector.h"
+#include <algorithm>
+#include <utility>
+
+namespace std {
+    
+    SparseVector::SparseVector():dimensionNumber(0) {
+    
+    }
+    
+    SparseVector::SparseVector(size_t dimensionNumber):dimensionNumber(dimensionNumber) {
+    
+    }
+    
+    SparseVector::SparseVector(const vector<SparseValueType>& features):dimensionNumber(features.size()) {
+        
+        for (size_t index = 0; index < features.size(); ++index) {
+            
+            if (features[index] != 0) {
+                this->indices.push_back((SparseIndexType)index);
+                this->values.push_back(features[index]);
+            }
+        }
+    }
+    
+    SparseVector::SparseVector(size_t dimensionNumber, const vector<SparseIndexType>& indices, const vector<SparseValueType>& values):dimensionNumber(dimensionNumber) {
+        
+        assert(indices.size() == values.size());
+        
+        vector< pair<SparseIndexType, SparseValueType> > entries(indices.size());
+        
+        for (size_t index = 0; index < entries.size(); ++index) {
+            
+            assert(indices[index] < dimensionNumber);
+            
+            entries[index] = make_pair(indices[index], values[index]);
+        }
+        
+        sort(entries.begin(), entries.end());
+        
+        for (size_t entryIndex = 0; entryIndex < entries.size();) {
+            
+            SparseIndexType index = entries[entryIndex].first;
+            SparseValueType value = 0;
+            
+            for (; entryIndex < entries.size() && entries[entryIndex].first == index; ++entryIndex) {
+                value += entries[entryIndex].second;
+            }
+            
+            if (value != 0) {
+                this->indices.push_back(index);
+                this->values.push_back(value);
+            }
+        }
+    }
+    
+    SparseVector::SparseVector(const SparseVector& rhs):indices(rhs.indices), values(rhs.values), dimensionNumber(rhs.dimensionNumber) {
+    
+    }
+    
+    SparseVector& SparseVector::operator=(const SparseVector& rhs) {
+        SparseVector temp(rhs);
+        this->swap(temp);
+        return *this;
+    }
+    
+    SparseVector::~SparseVector() {
+    
+    }
+    
+    void SparseVector::swap(SparseVector& other) {
+        using std::swap;
+        swap(this->indices, other.indices);
+        swap(this->values, other.values);
+        swap(this->dimensionNumber, other.dimensionNumber);
+    }
+    
+    SparseValueType SparseVector::getValue(SparseIndexType index) const {
+        
+        assert(index < this->dimensionNumber);
+        
+        vector<SparseIndexType>::const_iterator position = lower_bound(this->indices.begin(), this->indices.end(), index);
+        
+        if (position == this->indices.end() || *position != index) {
+            return 0;
+        }
+        
+        return this->values[position - this->indices.begin()];
+    }
+    
+    SparseValueType SparseVector::squaredNorm() const {
+        
+        SparseValueType result = 0;
+        
+        for (size_t index = 0; index < this->values.size(); ++index) {
+            result += this->values[index] * this->values[index];
+        }
+        
+        return result;
+    }
+    
+    const vector<SparseValueType> SparseVector::toDense() const {
+        
+        vector<SparseValueType> result(this->dimensionNumber, 0);
+        
+        for (size_t index = 0; index < this->indices.size(); ++index) {
+            result[this->indices[index]] = this->values[index];
+        }
+        
+        return result;
+    }
+    
+    SparseValueType sparseDotProduct(const SparseIndexType* indices0, const SparseValueType* values0, size_t size0, const SparseIndexType* indices1, const SparseValueType* values1, size_t size1) {
+        
+        if (size0 > size1) {
+            swap(indices0, indices1);
+            swap(values0, values1);
+            swap(size0, size1);
+        }
+        
+        SparseValueType result = 0;
+        
+        if (size0 * 32 < size1) {
+            
+            const SparseIndexType* begin1 = indices1;
+            const SparseIndexType* end1 = indices1 + size1;
+            
+            for (size_t index0 = 0; index0 < size0 && begin1 != end1; ++index0) {
+                
+                begin1 = lower_bound(begin1, end1, indices0[index0]);
+                
+                if (begin1 != end1 && *begin1 == indices0[index0]) {
+                    result += values0[index0] * values1[begin1 - indices1];
+                }
+            }
+            
+            return result;
+        }
+        
+        size_t index0 = 0;
+        size_t index1 = 0;
+        
+        while (index0 < size0 && index1 < size1) {
+            
+            if (indices0[index0] < indices1[index1]) {
+                ++index0;
+            } else if (indices1[index1] < indices0[index0]) {
+                ++index1;
+            } else {
+                result += values0[index0] * values1[index1];
+                ++index0;
+                ++index1;
+            }
+        }
+        
+        return result;
+    }
+    
+    SparseValueType sparseSquaredDistance(const SparseIndexType* indices0, const SparseValueType* values0, size_t size0, const SparseIndexType* indices1, const SparseValueType* values1, size_t size1) {
+        
+        SparseValueType result = 0;
+        
+        size_t index0 = 0;
+        size_t index1 = 0;
+        
+        while (index0 < size0 && index1 < size1) {
+            
+            SparseValueType difference = 0;
+            
+            if (indices0[index0] < indices1[index1]) {
+                difference = values0[index0++];
+            } else if (indices1[index1] < indices0[index0]) {
+                difference = values1[index1++];
+            } else {
+                difference = values0[index0++] - values1[index1++];
+            }
+            
+            result += difference * difference;
+        }
+        
+        for (; index0 < size0; ++index0) {
+            result += values0[index0] * values0[index0];
+        }
+        
+        for (; index1 < size1; ++index1) {
+            result += values1[index1] * values1[index1];
+        }
+        
+        return result;
+    }
+}
+
+namespace std {
+    template<>
+    void swap<std::SparseVector>(std::SparseVector& a, std::SparseVector& b) {
+        a.swap(b);
+    }
+}
\ No newline at end of file
@@ -0,0 +1,90 @@
+#ifndef __SPARSE_VECTOR_H__
+#define __SPARSE_VECTOR_H__
+
+#include <vector>
+#include "assert.h"
+
+namespace std {
+    
+    using namespace std;
+    
+    typedef unsigned int SparseIndexType;
+    typedef double SparseValueType;
+    
+    //Non-zero features as two parallel arrays sorted by feature index, memory and work grow with the non-zeros instead of the dimension.
+    class SparseVector {
+    
+    public:
+        
+        SparseVector();
+        SparseVector(size_t dimensionNumber);
+        
+        //Keeps the non-zero features.
+        SparseVector(const vector<SparseValueType>& features);
+        
+        //Indices in any order, values of a repeated index are summed and zeros dropped.
+        SparseVector(size_t dimensionNumber, const vector<SparseIndexType>& indices, const vector<SparseValueType>& values);
+        
+        SparseVector(const SparseVector& rhs);
+        SparseVector& operator=(const SparseVector& rhs);
+        
+        ~SparseVector();
+        
+        void swap(SparseVector& other);
+        
+        //Indices must be appended in increasing order.
+        inline void append(SparseIndexType index, SparseValueType value) {
+            
+            assert(index < this->dimensionNumber);
+            assert(this->indices.empty() == true || this->indices.back() < index);
+            
+            if (value != 0) {
+                this->indices.push_back(index);
+                this->values.push_back(value);
+            }
+        }
+        
+        inline size_t getDimensionNumber() const {
+            return this->dimensionNumber;
+        }
+        
+        inline size_t getNonZerosNumber() const {
+            return this->indices.size();
+        }
+        
+        inline const SparseIndexType* getIndices() const {
+            return this->indices.data();
+        }
+        
+        inline const SparseValueType* getValues() const {
+            return this->values.data();
+        }
+        
+        //Binary search in the non-zeros.
+        SparseValueType getValue(SparseIndexType index) const;
+        
+        SparseValueType squaredNorm() const;
+        
+        const vector<SparseValueType> toDense() const;
+        
+    private:
+        
+        vector<SparseIndexType> indices;
+        vector<SparseValueType> values;
+        
+        size_t dimensionNumber;
+    };
+    
+    //Merge of the two sorted index arrays, a much shorter one is looked up in the longer one by binary search instead.
+    SparseValueType sparseDotProduct(const SparseIndexType* indices0, const SparseValueType* values0, size_t size0, const SparseIndexType* indices1, const SparseValueType* values1, size_t size1);
+    
+    //Squared distance over the union of the non-zeros.
+    SparseValueType sparseSquaredDistance(const SparseIndexType* indices0, const SparseValueType* values0, size_t size0, const SparseIndexType* indices1, const SparseValueType* values1, size_t size1);
+}
+
+namespace std {
+    template<>
+    void swap<std::SparseVector>(std::SparseVector& a, std::SparseVector& b);
+}
+
+#endif
\ No newline at end of file
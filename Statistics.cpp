@@ -1,11 +1,126 @@
 #include "Statistics.h"
 #include <cmath>
 #include "assert.h"
+#include <limits>
 
 namespace Math {
     
     using namespace std;
     
+    StatisticsAccumulator::StatisticsAccumulator():count(0) {
+        
+    }
+    
+    StatisticsAccumulator::StatisticsAccumulator(size_t columnsNumber):count(0) {
+        this->reset(columnsNumber);
+    }
+    
+    StatisticsAccumulator::StatisticsAccumulator(const StatisticsAccumulator& rhs):count(rhs.count), means(rhs.means), squaredDeviations(rhs.squaredDeviations), minValues(rhs.minValues), maxValues(rhs.maxValues) {
+        
+    }
+    
+    StatisticsAccumulator& StatisticsAccumulator::operator=(const StatisticsAccumulator& rhs) {
+        StatisticsAccumulator temp(rhs);
+        this->swap(temp);
+        return *this;
+    }
+    
+    StatisticsAccumulator::~StatisticsAccumulator() {
+        
+    }
+    
+    void StatisticsAccumulator::swap(StatisticsAccumulator& other) {
+        using std::swap;
+        swap(this->count, other.count);
+        swap(this->means, other.means);
+        swap(this->squaredDeviations, other.squaredDeviations);
+        swap(this->minValues, other.minValues);
+        swap(this->maxValues, other.maxValues);
+    }
+    
+    void StatisticsAccumulator::reset() {
+        this->reset(this->means.size());
+    }
+    
+    void StatisticsAccumulator::reset(size_t columnsNumber) {
+        
+        this->count = 0;
+        
+        this->means.assign(columnsNumber, 0);
+        this->squaredDeviations.assign(columnsNumber, 0);
+        this->minValues.assign(columnsNumber, numeric_limits<double>::infinity());
+        this->maxValues.assign(columnsNumber, -numeric_limits<double>::infinity());
+    }
+    
+    void StatisticsAccumulator::addRows(const double* rows, size_t rowsNumber) {
+        
+        size_t columnsNumber = this->means.size();
+        
+        for (size_t rowIndex = 0; rowIndex < rowsNumber; ++rowIndex) {
+            this->add(rows + rowIndex * columnsNumber);
+        }
+    }
+    
+    //Chan et al.: the squared deviations of the union are those of both parts plus delta^2 * n0 * n1 / n.
+    void StatisticsAccumulator::merge(const StatisticsAccumulator& other) {
+        
+        assert(other.means.size() == this->means.size());
+        
+        if (other.count == 0) {
+            return;
+        }
+        
+        if (this->count == 0) {
+            *this = other;
+            return;
+        }
+        
+        double count0 = (double)this->count;
+        double count1 = (double)other.count;
+        double totalCount = count0 + count1;
+        
+        size_t columnsNumber = this->means.size();
+        
+        for (size_t index = 0; index < columnsNumber; ++index) {
+            
+            double delta = other.means[index] - this->means[index];
+            
+            this->means[index] += delta * (count1 / totalCount);
+            this->squaredDeviations[index] += other.squaredDeviations[index] + delta * delta * (count0 * count1 / totalCount);
+            
+            this->minValues[index] = min(this->minValues[index], other.minValues[index]);
+            this->maxValues[index] = max(this->maxValues[index], other.maxValues[index]);
+        }
+        
+        this->count += other.count;
+    }
+    
+    const vector<double> StatisticsAccumulator::getVariances() const {
+        
+        vector<double> result(this->means.size());
+        
+        for (size_t index = 0; index < this->means.size(); ++index) {
+            result[index] = this->getVariance(index);
+        }
+        
+        return result;
+    }
+    
+    //Ties go to the lowest column, like maxValueIndex.
+    size_t StatisticsAccumulator::maxVarianceColumnIndex() const {
+        
+        size_t maxIndex = 0;
+        
+        for (size_t index = 1; index < this->squaredDeviations.size(); ++index) {
+            
+            if (this->squaredDeviations[index] > this->squaredDeviations[maxIndex]) {
+                maxIndex = index;
+            }
+        }
+        
+        return maxIndex;
+    }
+    
     double sum(const vector<double>& values) {
         
         assert(values.size() > 0);
@@ -41,7 +156,7 @@ namespace Math {
         vector<double>::const_iterator vectorIterator;
         
         for (vectorIterator = values.begin(); vectorIterator != values.end(); ++vectorIterator) {
-            result += pow(*vectorIterator, 2);
+            result += (*vectorIterator) * (*vectorIterator);
         }
         
         return result;
@@ -51,25 +166,20 @@ namespace Math {
         
         assert(values.size() > 0);
         
-        double sumOfSquaresValue = sumOfSquares(values);
-        double meanValue = mean(values);
+        StatisticsAccumulator accumulator(1);
+        accumulator.addRows(values.data(), values.size());
         
-        double result;
-        
-        result = sumOfSquaresValue - pow(meanValue, 2);
-        
-        return result;
+        return accumulator.getVariance(0);
     }
     
     double sampleStandardDeviation(const vector<double>& values) {
         
         assert(values.size() > 1);
         
-        double result = 0;
-        
-        result = sqrt(variance(values) / (values.size() - 1));
+        StatisticsAccumulator accumulator(1);
+        accumulator.addRows(values.data(), values.size());
         
-        return result;
+        return sqrt(accumulator.getSampleVariance(0));
     }
     
     size_t maxValueIndex(const vector<double>& values) {
@@ -96,4 +206,36 @@ namespace Math {
         
         return maxIndex;
     }
+    
+    size_t minValueIndex(const vector<double>& values) {
+        
+        double minValue = 0;
+        size_t minIndex = 0;
+        
+        size_t index = 0;
+        
+        vector<double>::const_iterator vectorIterator;
+        
+        for (vectorIterator = values.begin(); vectorIterator != values.end(); ++vectorIterator) {
+            
+            if (vectorIterator == values.begin()) {
+                minValue = *vectorIterator;
+            } else {
+                if (*vectorIterator < minValue) {
+                    minValue = *vectorIterator;
+                    minIndex = index;
+                }
+            }
+            ++index;
+        }
+        
+        return minIndex;
+    }
+}
+
+namespace std {
+    template<>
+    void swap<Math::StatisticsAccumulator>(Math::StatisticsAccumulator& a, Math::StatisticsAccumulator& b) {
+        a.swap(b);
+    }
 }
\ No newline at end of file
@@ -4,41 +4,335 @@
 #include <vector>
 #include <map>
 #include <set>
+#include <unordered_map>
+#include <type_traits>
+#include <algorithm>
+#include "assert.h"
 
 namespace Math {
     
     using namespace std;
     
+    //Running mean, variance, min and max of many columns at once, every row is read exactly once.
+    //Uses Welford's update, which stays accurate where sum of squares minus squared mean cancels, and Chan's formula to merge accumulators filled by different threads.
+    class StatisticsAccumulator {
+        
+    public:
+        
+        StatisticsAccumulator();
+        StatisticsAccumulator(size_t columnsNumber);
+        
+        StatisticsAccumulator(const StatisticsAccumulator& rhs);
+        StatisticsAccumulator& operator=(const StatisticsAccumulator& rhs);
+        
+        ~StatisticsAccumulator();
+        
+        void swap(StatisticsAccumulator& other);
+        
+        //Forgets all rows, the columns number stays.
+        void reset();
+        void reset(size_t columnsNumber);
+        
+        //The column loop has no dependency between columns, so it vectorizes.
+        inline void add(const double* row) {
+            
+            ++this->count;
+            
+            double reciprocalCount = 1.0 / this->count;
+            size_t columnsNumber = this->means.size();
+            
+            double* means = this->means.data();
+            double* squaredDeviations = this->squaredDeviations.data();
+            double* minValues = this->minValues.data();
+            double* maxValues = this->maxValues.data();
+            
+            for (size_t index = 0; index < columnsNumber; ++index) {
+                
+                double value = row[index];
+                double delta = value - means[index];
+                
+                means[index] += delta * reciprocalCount;
+                squaredDeviations[index] += delta * (value - means[index]);
+                
+                minValues[index] = value < minValues[index] ? value : minValues[index];
+                maxValues[index] = value > maxValues[index] ? value : maxValues[index];
+            }
+        }
+        
+        inline void add(const vector<double>& row) {
+            
+            assert(row.size() == this->means.size());
+            
+            this->add(row.data());
+        }
+        
+        //Adds rowsNumber rows stored one after another.
+        void addRows(const double* rows, size_t rowsNumber);
+        
+        void merge(const StatisticsAccumulator& other);
+        
+        inline size_t getCount() const {
+            return this->count;
+        }
+        
+        inline size_t getColumnsNumber() const {
+            return this->means.size();
+        }
+        
+        inline double getMean(size_t columnIndex) const {
+            return this->means[columnIndex];
+        }
+        
+        //Population variance, divided by the count.
+        inline double getVariance(size_t columnIndex) const {
+            
+            assert(this->count > 0);
+            
+            return this->squaredDeviations[columnIndex] / this->count;
+        }
+        
+        //Divided by count - 1.
+        inline double getSampleVariance(size_t columnIndex) const {
+            
+            assert(this->count > 1);
+            
+            return this->squaredDeviations[columnIndex] / (this->count - 1);
+        }
+        
+        inline double getMinValue(size_t columnIndex) const {
+            return this->minValues[columnIndex];
+        }
+        
+        inline double getMaxValue(size_t columnIndex) const {
+            return this->maxValues[columnIndex];
+        }
+        
+        inline const vector<double>& getMeans() const {
+            return this->means;
+        }
+        
+        const vector<double> getVariances() const;
+        
+        size_t maxVarianceColumnIndex() const;
+        
+    private:
+        
+        size_t count;
+        
+        vector<double> means;
+        
+        //Sum of squared deviations from the running mean, Welford's M2.
+        vector<double> squaredDeviations;
+        
+        vector<double> minValues;
+        vector<double> maxValues;
+    };
+    
     double sum(const vector<double>& values);
     double mean(const vector<double>& values);
     double sumOfSquares(const vector<double>& values);
+    //Population variance, sampleStandardDeviation divides by n - 1 instead.
     double variance(const vector<double>& values);
     double sampleStandardDeviation(const vector<double>& values);
     size_t maxValueIndex(const vector<double>& values);
+    size_t minValueIndex(const vector<double>& values);
     
-    template <typename T>
-    inline const map<T, double> distribution(const vector<T>& data) {
+    //Maps small non-negative integers to a slot of the dense counts, other keys always go to the hash table.
+    template<typename T, bool IsIntegral = is_integral<T>::value>
+    struct HistogramDenseSlot {
+        
+        static inline bool find(const T&, size_t, size_t&) {
+            return false;
+        }
+        
+        static inline T value(size_t) {
+            return T();
+        }
+    };
+    
+    template<typename T>
+    struct HistogramDenseSlot<T, true> {
+        
+        static inline bool find(const T& value, size_t slotsNumber, size_t& slot) {
+            
+            if (value < T() || (unsigned long long)value >= slotsNumber) {
+                return false;
+            }
+            
+            slot = (size_t)value;
+            
+            return true;
+        }
         
-        map<T, double> result;
+        static inline T value(size_t slot) {
+            return (T)slot;
+        }
+    };
+    
+    //Counts values in linear time: integers below denseSlotsNumber (such as class labels) index a flat array, everything else is hashed.
+    //Can be filled incrementally, cleared and reused for every query, and merged across threads.
+    template<typename T>
+    class Histogram {
         
-        multiset<T> multiSet;
+    public:
         
-        size_t size = data.size();
+        static const size_t DefaultDenseSlotsNumber = 256;
         
-        for (size_t index = 0; index < size; ++index) {
+        Histogram(size_t denseSlotsNumber = DefaultDenseSlotsNumber):totalCount(0) {
             
-            multiSet.insert(data.at(index));
+            if (is_integral<T>::value == true) {
+                this->denseCounts.assign(denseSlotsNumber, 0);
+            }
         }
         
-        typename multiset<T>::iterator multiSetIterator;
+        inline void add(const T& value, size_t count = 1) {
+            
+            size_t slot = 0;
+            
+            if (HistogramDenseSlot<T>::find(value, this->denseCounts.size(), slot) == true) {
+                this->denseCounts[slot] += count;
+            } else {
+                this->sparseCounts[value] += count;
+            }
+            
+            this->totalCount += count;
+        }
         
-        for (multiSetIterator = multiSet.begin(); multiSetIterator != multiSet.end(); ++multiSetIterator) {
-            size_t count = multiSet.count(*multiSetIterator);
-            result[*multiSetIterator] = count / (double)size;
+        inline void add(const vector<T>& values) {
+            
+            typename vector<T>::const_iterator valueIterator;
+            
+            for (valueIterator = values.begin(); valueIterator != values.end(); ++valueIterator) {
+                this->add(*valueIterator);
+            }
         }
-
-        return map<T, double>(result);
+        
+        //Both histograms must use the same dense slots number.
+        void merge(const Histogram<T>& other) {
+            
+            assert(other.denseCounts.size() == this->denseCounts.size());
+            
+            for (size_t slot = 0; slot < this->denseCounts.size(); ++slot) {
+                this->denseCounts[slot] += other.denseCounts[slot];
+            }
+            
+            typename unordered_map<T, size_t>::const_iterator countIterator;
+            
+            for (countIterator = other.sparseCounts.begin(); countIterator != other.sparseCounts.end(); ++countIterator) {
+                this->sparseCounts[(*countIterator).first] += (*countIterator).second;
+            }
+            
+            this->totalCount += other.totalCount;
+        }
+        
+        //Keeps the allocated storage.
+        void clear() {
+            
+            fill(this->denseCounts.begin(), this->denseCounts.end(), 0);
+            this->sparseCounts.clear();
+            
+            this->totalCount = 0;
+        }
+        
+        inline size_t getCount(const T& value) const {
+            
+            size_t slot = 0;
+            
+            if (HistogramDenseSlot<T>::find(value, this->denseCounts.size(), slot) == true) {
+                return this->denseCounts[slot];
+            }
+            
+            typename unordered_map<T, size_t>::const_iterator countIterator = this->sparseCounts.find(value);
+            
+            return countIterator != this->sparseCounts.end() ? (*countIterator).second : 0;
+        }
+        
+        inline size_t getTotalCount() const {
+            return this->totalCount;
+        }
+        
+        inline double getFrequency(const T& value) const {
+            
+            assert(this->totalCount > 0);
+            
+            return this->getCount(value) / (double)this->totalCount;
+        }
+        
+        //The most counted value, ties go to the smallest one.
+        T getMostFrequentValue() const {
+            
+            assert(this->totalCount > 0);
+            
+            T result = T();
+            size_t maxCount = 0;
+            
+            for (size_t slot = 0; slot < this->denseCounts.size(); ++slot) {
+                
+                if (this->denseCounts[slot] > maxCount) {
+                    result = HistogramDenseSlot<T>::value(slot);
+                    maxCount = this->denseCounts[slot];
+                }
+            }
+            
+            typename unordered_map<T, size_t>::const_iterator countIterator;
+            
+            for (countIterator = this->sparseCounts.begin(); countIterator != this->sparseCounts.end(); ++countIterator) {
+                
+                if ((*countIterator).second > maxCount || ((*countIterator).second == maxCount && (*countIterator).first < result)) {
+                    result = (*countIterator).first;
+                    maxCount = (*countIterator).second;
+                }
+            }
+            
+            return result;
+        }
+        
+        //Frequencies of the counted values ordered by value.
+        const map<T, double> getDistribution() const {
+            
+            map<T, double> result;
+            
+            if (this->totalCount == 0) {
+                return result;
+            }
+            
+            for (size_t slot = 0; slot < this->denseCounts.size(); ++slot) {
+                
+                if (this->denseCounts[slot] > 0) {
+                    result[HistogramDenseSlot<T>::value(slot)] = this->denseCounts[slot] / (double)this->totalCount;
+                }
+            }
+            
+            typename unordered_map<T, size_t>::const_iterator countIterator;
+            
+            for (countIterator = this->sparseCounts.begin(); countIterator != this->sparseCounts.end(); ++countIterator) {
+                result[(*countIterator).first] = (*countIterator).second / (double)this->totalCount;
+            }
+            
+            return result;
+        }
+        
+    private:
+        
+        vector<size_t> denseCounts;
+        unordered_map<T, size_t> sparseCounts;
+        
+        size_t totalCount;
+    };
+    
+    template <typename T>
+    inline const map<T, double> distribution(const vector<T>& data) {
+        
+        Histogram<T> histogram;
+        histogram.add(data);
+        
+        return histogram.getDistribution();
     }
 }
 
+namespace std {
+    template<>
+    void swap<Math::StatisticsAccumulator>(Math::StatisticsAccumulator& a, Math::StatisticsAccumulator& b);
+}
+
 #endif
\ No newline at end of file
@@ -0,0 +1,361 @@
+#include "VpTree.h"
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+namespace std {
+    
+    const NodeIndexType VpTree::NullNodeIndex = (NodeIndexType)(-1);
+    
+    VpTree::VpTree():metric(EuclideanMetric), minkowskiP(2), builtMetric(EuclideanMetric), builtMinkowskiP(2), rootNode(NullNodeIndex) {
+    
+    }
+    
+    VpTree::VpTree(const VpTree& rhs):metric(rhs.metric), minkowskiP(rhs.minkowskiP), builtMetric(rhs.builtMetric), builtMinkowskiP(rhs.builtMinkowskiP), points(rhs.points), sourcePoints(rhs.sourcePoints), categories(rhs.categories), normalizer(rhs.normalizer), treeNodes(rhs.treeNodes), rootNode(rhs.rootNode) {
+    
+    }
+    
+    VpTree& VpTree::operator=(const VpTree& rhs) {
+        VpTree temp(rhs);
+        this->swap(temp);
+        return *this;
+    }
+    
+    VpTree::~VpTree() {
+    
+    }
+    
+    void VpTree::swap(VpTree& other) {
+        using std::swap;
+        swap(this->metric, other.metric);
+        swap(this->minkowskiP, other.minkowskiP);
+        swap(this->builtMetric, other.builtMetric);
+        swap(this->builtMinkowskiP, other.builtMinkowskiP);
+        swap(this->points, other.points);
+        swap(this->sourcePoints, other.sourcePoints);
+        swap(this->categories, other.categories);
+        swap(this->normalizer, other.normalizer);
+        swap(this->treeNodes, other.treeNodes);
+        swap(this->rootNode, other.rootNode);
+        swap(this->pointIndices, other.pointIndices);
+        swap(this->vantageDistances, other.vantageDistances);
+    }
+    
+    void VpTree::build(const vector< vector<FeatureType> >& featuresVector, const vector<NodeCategory>& categoriesVector) {
+        
+        assert(featuresVector.size() == categoriesVector.size());
+        assert(this->metric != MinkowskiMetric || this->minkowskiP > 0);
+        
+        this->builtMetric = this->metric;
+        this->builtMinkowskiP = this->minkowskiP;
+        
+        this->points.assign(featuresVector);
+        this->sourcePoints.clear();
+        this->categories = categoriesVector;
+        this->normalizer.clear();
+        
+        this->treeNodes.clear();
+        this->rootNode = NullNodeIndex;
+        
+        if (this->points.isEmpty() == true) {
+            return;
+        }
+        
+        if (this->builtMetric == CosineMetric) {
+            
+            this->sourcePoints = this->points;
+            
+            this->normalizer.fit(this->points, L2Normalization);
+            this->normalizer.apply(this->points);
+            
+        } else if (this->builtMetric == BhattacharyyaMetric) {
+            
+            this->sourcePoints = this->points;
+            
+            for (PointIndexType pointIndex = 0; pointIndex < this->points.getPointNumber(); ++pointIndex) {
+                
+                FeatureType* point = this->points.getPoint(pointIndex);
+                
+                for (DimensionNumber index = 0; index < this->points.getDimensionNumber(); ++index) {
+                    
+                    assert(point[index] >= 0);
+                    
+                    point[index] = sqrt(point[index]);
+                }
+            }
+        }
+        
+        size_t pointNumber = this->points.getPointNumber();
+        
+        this->pointIndices.resize(pointNumber);
+        this->vantageDistances.resize(pointNumber);
+        
+        for (PointIndexType pointIndex = 0; pointIndex < pointNumber; ++pointIndex) {
+            this->pointIndices[pointIndex] = pointIndex;
+        }
+        
+        this->treeNodes.reserve(pointNumber);
+        this->rootNode = this->buildTree(0, pointNumber);
+        
+        vector<PointIndexType>().swap(this->pointIndices);
+        vector<VpTreeCandidate>().swap(this->vantageDistances);
+    }
+    
+    void VpTree::setMetric(VpTreeMetric metric, unsigned long p) {
+        this->metric = metric;
+        this->minkowskiP = p;
+    }
+    
+    VpTreeMetric VpTree::getMetric() const {
+        return this->metric;
+    }
+    
+    unsigned long VpTree::getMinkowskiP() const {
+        return this->minkowskiP;
+    }
+    
+    const vector<KdTreeNode> VpTree::nearestKNode(const vector<FeatureType>& features, size_t k) const {
+        
+        if (this->rootNode == NullNodeIndex || k == 0) {
+            return vector<KdTreeNode>();
+        }
+        
+        vector<FeatureType> searchFeatures;
+        this->getSearchFeatures(features, searchFeatures);
+        
+        VpTreeCandidateMaxHeap candidateMaxHeap(k);
+        
+        this->searchTree(this->rootNode, searchFeatures.data(), candidateMaxHeap, k);
+        
+        return this->getQueryResult(features, candidateMaxHeap);
+    }
+    
+    const vector< vector<KdTreeNode> > VpTree::nearestKNodes(const vector< vector<FeatureType> >& featuresVector, size_t k) const {
+        
+        vector< vector<KdTreeNode> > result(featuresVector.size());
+        
+        for (size_t index = 0; index < featuresVector.size(); ++index) {
+            result[index] = this->nearestKNode(featuresVector[index], k);
+        }
+        
+        return result;
+    }
+    
+    //The vantage point is the point farthest from a pseudo random one of the range, points near the boundary of the data split it into the most even shells.
+    NodeIndexType VpTree::buildTree(size_t low, size_t up) {
+        
+        if (low >= up) {
+            return NullNodeIndex;
+        }
+        
+        NodeIndexType node = this->treeNodes.size();
+        this->treeNodes.push_back(VpTreeNode());
+        
+        if (up - low > 2) {
+            
+            const FeatureType* seed = this->points.getPoint(this->pointIndices[low + (up - low) * 7 / 13]);
+            
+            size_t farthestIndex = low;
+            NodeDistanceType farthestDistance = -1;
+            
+            for (size_t index = low; index < up; ++index) {
+                
+                NodeDistanceType seedDistance = this->distance(seed, this->points.getPoint(this->pointIndices[index]));
+                
+                if (seedDistance > farthestDistance) {
+                    farthestDistance = seedDistance;
+                    farthestIndex = index;
+                }
+            }
+            
+            std::swap(this->pointIndices[low], this->pointIndices[farthestIndex]);
+        }
+        
+        PointIndexType vantagePointIndex = this->pointIndices[low];
+        const FeatureType* vantagePoint = this->points.getPoint(vantagePointIndex);
+        
+        for (size_t index = low + 1; index < up; ++index) {
+            this->vantageDistances[index].pointIndex = this->pointIndices[index];
+            this->vantageDistances[index].distance = this->distance(vantagePoint, this->points.getPoint(this->pointIndices[index]));
+        }
+        
+        size_t median = low + 1 + (up - low - 1) / 2;
+        
+        nth_element(this->vantageDistances.begin() + low + 1, this->vantageDistances.begin() + median, this->vantageDistances.begin() + up, VpTreeCandidateDistanceLess());
+        
+        VpTreeNode treeNode;
+        treeNode.pointIndex = vantagePointIndex;
+        treeNode.insideMinDistance = numeric_limits<NodeDistanceType>::max();
+        treeNode.insideMaxDistance = 0;
+        treeNode.outsideMinDistance = numeric_limits<NodeDistanceType>::max();
+        treeNode.outsideMaxDistance = 0;
+        
+        for (size_t index = low + 1; index < up; ++index) {
+            
+            NodeDistanceType vantageDistance = this->vantageDistances[index].distance;
+            
+            this->pointIndices[index] = this->vantageDistances[index].pointIndex;
+            
+            if (index < median) {
+                treeNode.insideMinDistance = min(treeNode.insideMinDistance, vantageDistance);
+                treeNode.insideMaxDistance = max(treeNode.insideMaxDistance, vantageDistance);
+            } else {
+                treeNode.outsideMinDistance = min(treeNode.outsideMinDistance, vantageDistance);
+                treeNode.outsideMaxDistance = max(treeNode.outsideMaxDistance, vantageDistance);
+            }
+        }
+        
+        treeNode.inside = this->buildTree(low + 1, median);
+        treeNode.outside = this->buildTree(median, up);
+        
+        this->treeNodes[node] = treeNode;
+        
+        return node;
+    }
+    
+    NodeDistanceType VpTree::distance(const FeatureType* point0, const FeatureType* point1) const {
+        
+        DimensionNumber dimensionNumber = this->points.getDimensionNumber();
+        
+        NodeDistanceType result = 0;
+        
+        switch (this->builtMetric) {
+            
+            case ManhattanMetric:
+                
+                for (DimensionNumber index = 0; index < dimensionNumber; ++index) {
+                    result += fabs(point0[index] - point1[index]);
+                }
+                
+                return result;
+                
+            case ChebyshevMetric:
+                
+                for (DimensionNumber index = 0; index < dimensionNumber; ++index) {
+                    result = max(result, (NodeDistanceType)fabs(point0[index] - point1[index]));
+                }
+                
+                return result;
+                
+            case MinkowskiMetric:
+                
+                for (DimensionNumber index = 0; index < dimensionNumber; ++index) {
+                    result += pow(fabs(point0[index] - point1[index]), (double)this->builtMinkowskiP);
+                }
+                
+                return pow(result, 1.0 / this->builtMinkowskiP);
+                
+            default:
+                
+                for (DimensionNumber index = 0; index < dimensionNumber; ++index) {
+                    
+                    NodeDistanceType difference = point0[index] - point1[index];
+                    result += difference * difference;
+                }
+                
+                return sqrt(result);
+        }
+    }
+    
+    void VpTree::getSearchFeatures(const vector<FeatureType>& features, vector<FeatureType>& searchFeatures) const {
+        
+        assert(features.size() == this->points.getDimensionNumber());
+        
+        if (this->builtMetric == CosineMetric) {
+            
+            this->normalizer.apply(features, searchFeatures);
+            
+        } else if (this->builtMetric == BhattacharyyaMetric) {
+            
+            searchFeatures.resize(features.size());
+            
+            for (size_t index = 0; index < features.size(); ++index) {
+                
+                assert(features[index] >= 0);
+                
+                searchFeatures[index] = sqrt(features[index]);
+            }
+            
+        } else {
+            searchFeatures = features;
+        }
+    }
+    
+    //Descends into the child whose shell holds the query first, the other one is only entered when the search ball still reaches its shell.
+    void VpTree::searchTree(NodeIndexType node, const FeatureType* features, VpTreeCandidateMaxHeap& candidateMaxHeap, size_t k) const {
+        
+        const VpTreeNode& treeNode = this->treeNodes[node];
+        
+        VpTreeCandidate candidate;
+        candidate.pointIndex = treeNode.pointIndex;
+        candidate.distance = this->distance(features, this->points.getPoint(treeNode.pointIndex));
+        
+        candidateMaxHeap.addData(candidate);
+        
+        NodeDistanceType vantageDistance = candidate.distance;
+        
+        bool isInsideFirst = vantageDistance < (treeNode.insideMaxDistance + treeNode.outsideMinDistance) / 2;
+        
+        for (size_t childIndex = 0; childIndex < 2; ++childIndex) {
+            
+            bool isInside = (childIndex == 0) == isInsideFirst;
+            
+            NodeIndexType child = isInside == true ? treeNode.inside : treeNode.outside;
+            
+            if (child == NullNodeIndex) {
+                continue;
+            }
+            
+            NodeDistanceType searchRadius = candidateMaxHeap.nodesNumber() < k ? numeric_limits<NodeDistanceType>::max() : candidateMaxHeap.maxData().distance;
+            
+            NodeDistanceType minDistance = isInside == true ? treeNode.insideMinDistance : treeNode.outsideMinDistance;
+            NodeDistanceType maxDistance = isInside == true ? treeNode.insideMaxDistance : treeNode.outsideMaxDistance;
+            
+            if (vantageDistance + searchRadius >= minDistance && vantageDistance - searchRadius <= maxDistance) {
+                this->searchTree(child, features, candidateMaxHeap, k);
+            }
+        }
+    }
+    
+    const vector<KdTreeNode> VpTree::getQueryResult(const vector<FeatureType>& features, VpTreeCandidateMaxHeap& candidateMaxHeap) const {
+        
+        vector<VpTreeCandidate> candidates = candidateMaxHeap.getAllData();
+        
+        sort(candidates.begin(), candidates.end(), VpTreeCandidateDistanceLess());
+        
+        const PointBuffer& resultPoints = this->sourcePoints.isEmpty() == true ? this->points : this->sourcePoints;
+        
+        vector<KdTreeNode> result;
+        result.reserve(candidates.size());
+        
+        vector<VpTreeCandidate>::const_iterator candidateIterator;
+        
+        for (candidateIterator = candidates.begin(); candidateIterator != candidates.end(); ++candidateIterator) {
+            
+            vector<FeatureType> resultFeatures = resultPoints.getFeatures((*candidateIterator).pointIndex);
+            
+            NodeDistanceType score = (*candidateIterator).distance;
+            
+            if (this->builtMetric == CosineMetric) {
+                
+                //|q - p|^2 = 2 - 2 cos for unit vectors.
+                score = 1 - score * score / 2;
+                
+            } else if (this->builtMetric == BhattacharyyaMetric) {
+                score = Measurement::bhattacharyyaDistance(features, resultFeatures);
+            }
+            
+            result.push_back(KdTreeNode(resultFeatures, this->categories[(*candidateIterator).pointIndex]));
+            result.back().setScore(score);
+        }
+        
+        return result;
+    }
+}
+
+namespace std {
+    template<>
+    void swap<std::VpTree>(std::VpTree& a, std::VpTree& b) {
+        a.swap(b);
+    }
+}
\ No newline at end of file
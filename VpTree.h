@@ -0,0 +1,138 @@
+#ifndef __VP_TREE_H__
+#define __VP_TREE_H__
+
+#include <vector>
+#include "assert.h"
+#include "MaxHeap.h"
+#include "Measurement.h"
+#include "PointBuffer.h"
+#include "Normalization.h"
+#include "KdTree.h"
+
+namespace std {
+    
+    using namespace std;
+    
+    //Distances a VpTree can prune with, all of them obey the triangle inequality in the space the points are searched in.
+    //Cosine search compares L2 normalized points by their chord length, which orders them like the angle.
+    //Bhattacharyya search compares the square roots of the features by Euclidean distance (the Hellinger distance), which orders histograms summing to 1 like the Bhattacharyya distance.
+    enum VpTreeMetric {
+        EuclideanMetric,
+        ManhattanMetric,
+        ChebyshevMetric,
+        MinkowskiMetric,
+        CosineMetric,
+        BhattacharyyaMetric
+    };
+    
+    //Vantage point tree, an alternative to KdTree for metrics whose balls are far from axis aligned boxes.
+    //Every node splits its points by the median distance to its vantage point, pruning only needs the triangle inequality instead of split planes.
+    //Shares the point buffer, the node and category types and the KdTreeNode results with KdTree, so both can be built from the same data and compared.
+    class VpTree {
+        
+    public:
+        
+        VpTree();
+        
+        VpTree(const VpTree& rhs);
+        VpTree& operator=(const VpTree& rhs);
+        
+        ~VpTree();
+        
+        void swap(VpTree& other);
+        
+        void build(const vector< vector<FeatureType> >& featuresVector, const vector<NodeCategory>& categoriesVector);
+        
+        //Takes effect on the next build. p is only used by the Minkowski metric.
+        void setMetric(VpTreeMetric metric, unsigned long p = 2);
+        VpTreeMetric getMetric() const;
+        unsigned long getMinkowskiP() const;
+        
+        inline size_t getNodesNumber() const {
+            return this->treeNodes.size();
+        }
+        
+        //Results are ordered best first, scored by the metric distance, the cosine similarity or the Bhattacharyya distance.
+        const vector<KdTreeNode> nearestKNode(const vector<FeatureType>& features, size_t k) const;
+        const vector< vector<KdTreeNode> > nearestKNodes(const vector< vector<FeatureType> >& featuresVector, size_t k) const;
+        
+    private:
+        
+        struct VpTreeCandidate {
+            NodeDistanceType distance;
+            PointIndexType pointIndex;
+        };
+        
+        class VpTreeCandidateMaxHeap: public MaxHeap<VpTreeCandidate> {
+            
+        public:
+            
+            VpTreeCandidateMaxHeap(size_t limitedNodesNumber):MaxHeap<VpTreeCandidate>(limitedNodesNumber) {
+            
+            }
+            
+            bool isNodeGreaterThanAnother(const VpTreeCandidate& node0, const VpTreeCandidate& node1) {
+                return node0.distance > node1.distance;
+            }
+        };
+        
+        class VpTreeCandidateDistanceLess {
+            
+        public:
+            
+            inline bool operator()(const VpTreeCandidate& lhs, const VpTreeCandidate& rhs) const {
+                return lhs.distance < rhs.distance;
+            }
+        };
+        
+        //Points closer to the vantage point than the median go inside, the others outside.
+        //The children keep the distance range of their points to the vantage point, a query at distance d with search radius r only enters a child whose range meets [d - r, d + r].
+        struct VpTreeNode {
+            PointIndexType pointIndex;
+            NodeDistanceType insideMinDistance;
+            NodeDistanceType insideMaxDistance;
+            NodeDistanceType outsideMinDistance;
+            NodeDistanceType outsideMaxDistance;
+            NodeIndexType inside;
+            NodeIndexType outside;
+        };
+        
+        static const NodeIndexType NullNodeIndex;
+        
+        VpTreeMetric metric;
+        unsigned long minkowskiP;
+        
+        VpTreeMetric builtMetric;
+        unsigned long builtMinkowskiP;
+        
+        //Points in the search space, sourcePoints keeps the original features and is empty when they are the same.
+        PointBuffer points;
+        PointBuffer sourcePoints;
+        vector<NodeCategory> categories;
+        
+        FeatureNormalizer normalizer;
+        
+        vector<VpTreeNode> treeNodes;
+        NodeIndexType rootNode;
+        
+        //Build scratch: the index permutation partitioned in place and the distances of its points to the current vantage point.
+        vector<PointIndexType> pointIndices;
+        vector<VpTreeCandidate> vantageDistances;
+        
+        NodeIndexType buildTree(size_t low, size_t up);
+        
+        NodeDistanceType distance(const FeatureType* point0, const FeatureType* point1) const;
+        
+        void getSearchFeatures(const vector<FeatureType>& features, vector<FeatureType>& searchFeatures) const;
+        void searchTree(NodeIndexType node, const FeatureType* features, VpTreeCandidateMaxHeap& candidateMaxHeap, size_t k) const;
+        
+        const vector<KdTreeNode> getQueryResult(const vector<FeatureType>& features, VpTreeCandidateMaxHeap& candidateMaxHeap) const;
+    };
+}
+
+namespace std {
+    template<>
+    void swap<std::VpTree>(std::VpTree& a, std::VpTree& b);
+}
+
+#endif
\ No newline at end of file
@@ -1,8 +1,140 @@
 #include "KdTree.h"
+#include "QueryExecutor.h"
+#include "BruteForceSearcher.h"
 #include <iostream>
+#include <cstdlib>
+#include <cmath>
+#include <atomic>
+#include <chrono>
+#include <thread>
 
 using namespace std;
 
+static const size_t ClientsNumber = 4;
+static const size_t ClientQueriesNumber = 2500;
+static const DimensionNumber LoadDimensionNumber = 6;
+static const size_t LoadPointsNumber = 50000;
+static const size_t ValidationPointsNumber = 2000;
+static const size_t ValidationQueriesNumber = 200;
+//Every this many points and queries is the zero vector.
+static const size_t ValidationZeroPeriod = 25;
+
+static vector<FeatureType> randomFeatures(DimensionNumber dimensionNumber) {
+    
+    vector<FeatureType> features(dimensionNumber);
+    
+    for (DimensionNumber dimensionIndex = 0; dimensionIndex < dimensionNumber; ++dimensionIndex) {
+        features[dimensionIndex] = rand() / (FeatureType)RAND_MAX;
+    }
+    
+    return features;
+}
+
+//Counts answers delivered to callbacks without an error, on the worker threads.
+class AnswerCounter {
+    
+public:
+    
+    AnswerCounter(atomic<size_t>& answersNumber):answersNumber(answersNumber) {
+        
+    }
+    
+    void operator()(const vector<KdTreeNode>&, exception_ptr error) const {
+        
+        if (!error) {
+            ++this->answersNumber;
+        }
+    }
+    
+private:
+    
+    atomic<size_t>& answersNumber;
+};
+
+//One client of the executor: even queries wait on a future, odd ones leave a callback.
+static void clientTask(QueryExecutor* executor, const vector< vector<FeatureType> >* queries, atomic<size_t>* answersNumber) {
+    
+    vector< future< vector<KdTreeNode> > > results;
+    
+    for (size_t queryIndex = 0; queryIndex < queries->size(); ++queryIndex) {
+        
+        if (queryIndex % 2 == 0) {
+            results.push_back(executor->submit((*queries)[queryIndex], 10));
+        } else {
+            executor->submit((*queries)[queryIndex], 10, AnswerCounter(*answersNumber));
+        }
+    }
+    
+    vector< future< vector<KdTreeNode> > >::iterator resultIterator;
+    
+    for (resultIterator = results.begin(); resultIterator != results.end(); ++resultIterator) {
+        
+        if ((*resultIterator).get().size() == 10) {
+            ++(*answersNumber);
+        }
+    }
+}
+
+//Cosine k-NN of the tree against the exhaustive scan, with zero rows among the points and the queries. Ties may come in another order, so scores are compared.
+static size_t countCosineMismatches() {
+    
+    vector< vector<FeatureType> > featuresVector;
+    vector<NodeCategory> categoriesVector;
+    
+    for (size_t pointIndex = 0; pointIndex < ValidationPointsNumber; ++pointIndex) {
+        
+        vector<FeatureType> features = randomFeatures(LoadDimensionNumber);
+        
+        if (pointIndex % ValidationZeroPeriod == 0) {
+            features.assign(LoadDimensionNumber, 0);
+        }
+        
+        featuresVector.push_back(features);
+        categoriesVector.push_back(pointIndex);
+    }
+    
+    KdTree tree;
+    tree.setSearchMode(CosineSearch);
+    tree.build(featuresVector, categoriesVector);
+    
+    BruteForceSearcher searcher;
+    searcher.setSearchMode(CosineSearch);
+    searcher.build(featuresVector, categoriesVector);
+    
+    size_t mismatchesNumber = 0;
+    
+    for (size_t queryIndex = 0; queryIndex < ValidationQueriesNumber; ++queryIndex) {
+        
+        vector<FeatureType> features = randomFeatures(LoadDimensionNumber);
+        
+        //Centred so that some points are anti-correlated and rank below the zero points.
+        for (DimensionNumber dimensionIndex = 0; dimensionIndex < LoadDimensionNumber; ++dimensionIndex) {
+            features[dimensionIndex] -= 0.5;
+        }
+        
+        if (queryIndex % ValidationZeroPeriod == 0) {
+            features.assign(LoadDimensionNumber, 0);
+        }
+        
+        vector<KdTreeNode> treeResult = tree.nearestKNode(features, 10);
+        vector<KdTreeNode> searcherResult = searcher.nearestKNode(features, 10);
+        
+        if (treeResult.size() != searcherResult.size()) {
+            ++mismatchesNumber;
+            continue;
+        }
+        
+        for (size_t resultIndex = 0; resultIndex < treeResult.size(); ++resultIndex) {
+            
+            if (fabs(treeResult[resultIndex].getScore() - searcherResult[resultIndex].getScore()) > 1e-9) {
+                ++mismatchesNumber;
+            }
+        }
+    }
+    
+    return mismatchesNumber;
+}
+
 int main (int argc, char* argv[]) {
     
     vector< vector<FeatureType> > featuresVector;
@@ -45,7 +177,13 @@ int main (int argc, char* argv[]) {
     FeatureType arrayTest[] = {2, 4.5};
     vector<FeatureType> vectorTest(arrayTest, arrayTest + 2);
     
-    vector<KdTreeNode> kNearestNodes = tree.nearestKNode(vectorTest, 5);
+    vector<KdTreeNode> kNearestNodes;
+    
+    {
+        QueryExecutor executor(tree, 1);
+        
+        kNearestNodes = executor.submit(vectorTest, 5).get();
+    }
     
     vector<KdTreeNode>::const_iterator treeNodeIterator;
     
@@ -64,5 +202,55 @@ int main (int argc, char* argv[]) {
         cout << endl;
     }
     
+    cout << "cosine search against brute force, zero vectors included: " << countCosineMismatches() << " mismatched scores" << endl;
+    
+    //Load: several clients submit single queries at once, the executor answers them in batches.
+    vector< vector<FeatureType> > loadFeaturesVector;
+    vector<NodeCategory> loadCategoriesVector;
+    
+    for (size_t pointIndex = 0; pointIndex < LoadPointsNumber; ++pointIndex) {
+        loadFeaturesVector.push_back(randomFeatures(LoadDimensionNumber));
+        loadCategoriesVector.push_back(pointIndex);
+    }
+    
+    KdTree loadTree;
+    loadTree.build(loadFeaturesVector, loadCategoriesVector);
+    
+    vector< vector< vector<FeatureType> > > clientQueries(ClientsNumber);
+    
+    for (size_t clientIndex = 0; clientIndex < ClientsNumber; ++clientIndex) {
+        
+        for (size_t queryIndex = 0; queryIndex < ClientQueriesNumber; ++queryIndex) {
+            clientQueries[clientIndex].push_back(randomFeatures(LoadDimensionNumber));
+        }
+    }
+    
+    atomic<size_t> answersNumber(0);
+    size_t batchesNumber = 0;
+    
+    chrono::steady_clock::time_point start = chrono::steady_clock::now();
+    
+    {
+        QueryExecutor executor(loadTree);
+        
+        vector<thread> clients;
+        
+        for (size_t clientIndex = 0; clientIndex < ClientsNumber; ++clientIndex) {
+            clients.push_back(thread(clientTask, &executor, &clientQueries[clientIndex], &answersNumber));
+        }
+        
+        vector<thread>::iterator clientIterator;
+        
+        for (clientIterator = clients.begin(); clientIterator != clients.end(); ++clientIterator) {
+            (*clientIterator).join();
+        }
+        
+        batchesNumber = executor.getBatchesNumber();
+    }
+    
+    double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+    
+    cout << answersNumber.load() << " answers in " << batchesNumber << " batches, " << answersNumber.load() / seconds << " queries per second" << endl;
+    
     return 0;
 }
\ No newline at end of file